@@ -0,0 +1,136 @@
+/** @file       load.c
+ *  @brief      Benchmark for loading TOML documents.
+ *
+ *  @author     t-kenji <protect.2501@gmail.com>
+ *  @date       2018-12-01 create new.
+ *  @copyright  Copyright © 2018 t-kenji
+ *
+ *  This code is licensed under the MIT License.
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include "ctomat.h"
+
+static uint32_t seed = 2501;
+
+static uint32_t rand_next(void)
+{
+    seed = seed * 1103515245 + 12345;
+    return (seed >> 16) & 0x7FFF;
+}
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + (ts.tv_nsec / 1e9);
+}
+
+/**
+ *  generates a synthetic document of about @c size bytes.
+ *  statements are few but long (100KB on average), so that tokenizing
+ *  dominates the load rather than building nodes.
+ */
+static char *generate(size_t size, size_t *length)
+{
+    char *buf = malloc(size + (256 * 1024));
+    size_t pos = 0;
+
+    for (int i = 0; pos < size; ++i) {
+        size_t value_length = 1000 + ((rand_next() * 6) % 200000);
+        switch (i % 3) {
+        case 0:
+            pos += sprintf(buf + pos, "# comment for key%d\nkey%d = \"", i, i);
+            break;
+        case 1:
+            pos += sprintf(buf + pos, "key%d = '", i);
+            break;
+        default:
+            pos += sprintf(buf + pos, "group%d.key%d = \"", i % 100, i);
+            break;
+        }
+        for (size_t j = 0; j < value_length; ++j) {
+            buf[pos++] = 'a' + (rand_next() % 26);
+        }
+        pos += sprintf(buf + pos, "%s # trailing\n", ((i % 3) == 1) ? "'" : "\"");
+    }
+    buf[pos] = '\0';
+    *length = pos;
+
+    return buf;
+}
+
+static int count_string(void *ctx, toml_view_t value, bool literal)
+{
+    *(size_t *)ctx += value.length;
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    size_t size = ((argc > 1) ? strtoul(argv[1], NULL, 10) : 100) * 1024 * 1024;
+    int iterations = (argc > 2) ? atoi(argv[2]) : 5;
+    size_t length;
+    char *buf = generate(size, &length);
+    double best = 0;
+
+    for (int i = 0; i < iterations; ++i) {
+        double start = now();
+        toml_t doc = toml_load_from_memory(buf, length);
+        double elapsed = now() - start;
+        if (doc == NULL) {
+            fprintf(stderr, "load failed\n");
+            return 1;
+        }
+        toml_delete(doc, true);
+        if ((best == 0) || (elapsed < best)) {
+            best = elapsed;
+        }
+    }
+    printf("toml_load_from_memory: %.1f MB in %.3f s (%.1f MB/s)\n",
+           length / 1048576.0, best, (length / 1048576.0) / best);
+
+    best = 0;
+    for (int i = 0; i < iterations; ++i) {
+        double start = now();
+        toml_t doc = toml_load_from_memory_parallel(buf, length, 0);
+        double elapsed = now() - start;
+        if (doc == NULL) {
+            fprintf(stderr, "load failed\n");
+            return 1;
+        }
+        toml_delete(doc, true);
+        if ((best == 0) || (elapsed < best)) {
+            best = elapsed;
+        }
+    }
+    printf("toml_load_from_memory_parallel: %.1f MB in %.3f s (%.1f MB/s)\n",
+           length / 1048576.0, best, (length / 1048576.0) / best);
+
+    struct toml_callbacks callbacks = {.string = count_string};
+    best = 0;
+    for (int i = 0; i < iterations; ++i) {
+        size_t total = 0;
+        double start = now();
+        int ret = toml_parse_events(buf, length, &callbacks, &total);
+        double elapsed = now() - start;
+        if (ret != 0) {
+            fprintf(stderr, "parse failed\n");
+            return 1;
+        }
+        if ((best == 0) || (elapsed < best)) {
+            best = elapsed;
+        }
+    }
+    printf("toml_parse_events: %.1f MB in %.3f s (%.1f MB/s)\n",
+           length / 1048576.0, best, (length / 1048576.0) / best);
+
+    free(buf);
+
+    return 0;
+}
@@ -18,6 +18,7 @@ ENABLE_SANITIZER ?= 1
 DISABLE_CCACHE ?= 0
 
 # compile & link options.
+OPTIMIZE ?= g
 EXTRA_CPPFLAGS ?=
 EXTRA_CFLAGS ?=
 EXTRA_CXXFLAGS ?=
@@ -18,20 +18,123 @@ extern "C" {
 #include <stdbool.h>
 #include <stdint.h>
 #include <inttypes.h>
+#include <sys/types.h>
 
 typedef struct toml *toml_t;
+typedef struct toml_parser *toml_parser_t;
+typedef struct toml_path *toml_path_t;
+
+/**
+ *  A view into the input; not NUL-terminated.
+ */
+typedef struct toml_view {
+    const char *ptr;
+    size_t length;
+} toml_view_t;
+
+/**
+ *  Kinds of date-time values.
+ */
+enum toml_datetime_kind {
+    TOML_OFFSET_DATETIME,
+    TOML_LOCAL_DATETIME,
+    TOML_LOCAL_DATE,
+    TOML_LOCAL_TIME,
+};
+
+/**
+ *  A date-time value in seconds since 1970-01-01T00:00:00Z.
+ *
+ *  Offset date-times count in UTC and keep the offset they were written
+ *  with; local date-times and dates count as if they were in UTC; local
+ *  times count from midnight. A leap second counts as the second before
+ *  it, with @c leap set.
+ */
+typedef struct toml_datetime {
+    int64_t seconds;
+    uint32_t nanoseconds;
+    int16_t offset;     /**< minutes east of UTC. */
+    uint8_t kind;       /**< one of enum toml_datetime_kind. */
+    uint8_t leap;       /**< 1 if written as second 60. */
+} toml_datetime_t;
+
+/**
+ *  Receivers of toml_parse_events(); any of them may be NULL.
+ *  Returning non-zero stops the parse.
+ *
+ *  Keys and strings are reported as written between their quotes,
+ *  escape sequences included; multi-line strings leave out the newline
+ *  that may follow their opening quotes.
+ */
+struct toml_callbacks {
+    /** a table header opened the table at @c path. */
+    int (*table)(void *ctx, const toml_view_t *path, size_t depth);
+    /** an array of tables header appended a table to the array at @c path. */
+    int (*array_table)(void *ctx, const toml_view_t *path, size_t depth);
+    /** the next value is assigned to @c path, relative to the current table. */
+    int (*key)(void *ctx, const toml_view_t *path, size_t depth);
+    int (*string)(void *ctx, toml_view_t value, bool literal);
+    int (*integer)(void *ctx, int64_t value);
+    int (*floating)(void *ctx, double value);
+    int (*boolean)(void *ctx, bool value);
+    int (*datetime)(void *ctx, const toml_datetime_t *value);
+    /** an array begins; its elements follow until array_end. */
+    int (*array_begin)(void *ctx);
+    int (*array_end)(void *ctx);
+    /** an inline table begins; its keys, relative to it, and values
+     *  follow until inline_table_end. */
+    int (*inline_table_begin)(void *ctx);
+    int (*inline_table_end)(void *ctx);
+    /** a scalar value as written, quotes included; replaces the typed
+     *  receivers and their checks when set. */
+    int (*raw)(void *ctx, toml_view_t value);
+};
+
+/**
+ *  Flags for toml_load_ex() and toml_load_from_memory_ex().
+ */
+enum toml_load_flags {
+    /** record where values are and classify, decode each on first access. */
+    TOML_LOAD_LAZY = 0x01,
+    /** map <file>.ctomatc if compiled from the same text, or parse and
+     *  compile it; a cached document is saved afresh, not as written. */
+    TOML_LOAD_CACHE = 0x02,
+};
 
 toml_t toml_create(void);
 int toml_delete(toml_t object, bool forced);
 
 toml_t toml_object_get(toml_t object, const char *key);
+toml_path_t toml_path_compile(const char *path);
+void toml_path_release(toml_path_t path);
+toml_t toml_path_get(toml_t object, toml_path_t path);
+size_t toml_array_length(toml_t array);
+toml_t toml_array_get(toml_t array, size_t index);
+const int64_t *toml_array_int64(toml_t array, size_t *length);
+const double *toml_array_double(toml_t array, size_t *length);
+const toml_view_t *toml_array_string(toml_t array, size_t *length);
+const bool *toml_array_bool(toml_t array, size_t *length);
+const toml_datetime_t *toml_array_datetime(toml_t array, size_t *length);
 const char *toml_string_value(toml_t string);
 int toml_string_set(toml_t string, const char *value);
+int toml_integer_value(toml_t integer, int64_t *value);
+int toml_float_value(toml_t number, double *value);
+int toml_boolean_value(toml_t boolean, bool *value);
+int toml_datetime_value(toml_t datetime, toml_datetime_t *value);
 
 toml_t toml_load(const char *pathname);
+toml_t toml_load_ex(const char *pathname, int flags);
 toml_t toml_load_from_memory(const char *buf, size_t length);
+toml_t toml_load_from_memory_ex(const char *buf, size_t length, int flags);
+toml_t toml_load_from_memory_parallel(const char *buf, size_t length, int nthreads);
+int toml_parse_events(const char *buf, size_t length, const struct toml_callbacks *callbacks, void *ctx);
+toml_parser_t toml_parser_create(void);
+int toml_parser_feed(toml_parser_t parser, const char *chunk, size_t length);
+toml_t toml_parser_finish(toml_parser_t parser);
 int toml_save(toml_t object, const char *pathname);
-int toml_save_to_memory(toml_t object, char *buf, size_t length);
+ssize_t toml_save_to_memory(toml_t object, char *buf, size_t length);
+int toml_compile(toml_t object, const char *pathname);
+toml_t toml_load_compiled(const char *pathname);
 
 #ifdef __cplusplus
 }
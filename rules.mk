@@ -3,7 +3,7 @@
 INCS := -I. -I$(TOP_DIR)/include
 
 OPT_WARN := -Wall -Werror
-OPT_OPTIM := -Og
+OPT_OPTIM := -O$(OPTIMIZE)
 OPT_DEBUG := -g
 ifeq ($(ENABLE_SANITIZER),1)
   OPT_DEBUG += -fsanitize=address -fsanitize=leak -fomit-frame-pointer
@@ -16,7 +16,7 @@ CPPFLAGS = -DNODEBUG=$(NODEBUG) $(EXTRA_CPPFLAGS)
 CFLAGS = -std=c11 $(OPTS) $(INCS) $(EXTRA_CFLAGS)
 CXXFLAGS = -std=c++11 $(OPTS) $(INCS) $(EXTRA_CXXFLAGS)
 LDFLAGS = -L$(TOP_DIR)/src $(EXTRA_LDFLAGS)
-LIBS = -l$(NAME)
+LIBS = -l$(NAME) -lpthread -lm
 ifeq ($(ENABLE_SANITIZER),1)
   LIBS += -lasan
 endif
@@ -42,9 +42,9 @@ DEPS := $(OBJS:.o=.d)
 %.o: %.cpp
 	$(QCXX)$(CXX) $(CPPFLAGS) $(CXXFLAGS) -c -o $@ $<
 
-.PHONY: all $(TARGET) $(EXAMPLE) $(TEST) clean
+.PHONY: all $(TARGET) $(EXAMPLE) $(TEST) $(BENCH) clean
 
-all: $(LIBRARY) $(EXAMPLE) $(TEST)
+all: $(LIBRARY) $(EXAMPLE) $(TEST) $(BENCH)
 
 $(LIBRARY): $(OBJS)
 	$(QAR)$(AR) $@ $^
@@ -55,7 +55,10 @@ $(EXAMPLE): $(OBJS)
 $(TEST): $(OBJS)
 	$(QCXX)$(CXX) $(LDFLAGS) -o $@ $^ $(LIBS)
 
+$(BENCH): $(OBJS)
+	$(QCC)$(CC) $(LDFLAGS) -o $@ $^ $(LIBS)
+
 clean:
-	rm -rf $(LIBRARY) $(EXAMPLE) $(TEST) $(OBJS) $(DEPS)
+	rm -rf $(LIBRARY) $(EXAMPLE) $(TEST) $(BENCH) $(OBJS) $(DEPS)
 
 -include $(DEPS)
@@ -33,15 +33,25 @@ struct pool_node {
         .next = NULL,         \
     }
 
+/**
+ *  メモリプール拡張領域構造体.
+ */
+struct pool_extent {
+    struct pool_extent *next; /**< 次の拡張領域へのポインタ. */
+    size_t capacity;          /**< 拡張領域の容量. (要素数) */
+    char mem[];               /**< 拡張領域. */
+};
+
 /**
  *  メモリプール構造体.
  */
 struct pool {
-    void *mem;              /**< メモリプールで使用するメモリ領域. */
-    size_t data_bytes;      /**< データ部のサイズ. */
-    size_t capacity;        /**< メモリプールの容量. (要素数) */
-    size_t freeable;        /**< 取得可能なメモリ要素数. */
-    struct pool_node *root; /**< 取得可能なノードのリスト. */
+    void *mem;                   /**< メモリプールで使用するメモリ領域. */
+    size_t data_bytes;           /**< データ部のサイズ. */
+    size_t capacity;             /**< メモリプールの容量. (要素数) */
+    size_t freeable;             /**< 取得可能なメモリ要素数. */
+    struct pool_node *root;      /**< 取得可能なノードのリスト. */
+    struct pool_extent *extents; /**< 拡張したメモリ領域のリスト. */
 };
 
 /**
@@ -54,6 +64,7 @@ struct pool {
         .capacity = (c),          \
         .freeable = 0,            \
         .root = NULL,             \
+        .extents = NULL,          \
     }
 
 #define max(a, b) (((a) > (b)) ? (a) : (b))
@@ -96,6 +107,19 @@ static inline void internal_pool_setup(struct pool *self,
     }
 }
 
+static inline void internal_pool_extend(struct pool *self,
+                                        struct pool_extent *extent)
+{
+    size_t node_bytes = max(self->data_bytes, sizeof(struct pool_node));
+    uintptr_t head = (uintptr_t)extent->mem;
+
+    for (size_t i = 0; i < extent->capacity; ++i) {
+        struct pool_node *node = (struct pool_node *)(head + (node_bytes * i));
+        internal_pool_push(self, node);
+    }
+    self->capacity += extent->capacity;
+}
+
 /**
  *  @details    指定の容量を備えた, POOL:: オブジェクトを確保および
  *              初期化する.
@@ -142,6 +166,12 @@ void pool_release(POOL pool)
     struct pool *self = (struct pool *)pool;
 
     if (self != NULL) {
+        struct pool_extent *extent = self->extents;
+        while (extent != NULL) {
+            struct pool_extent *next = extent->next;
+            free(extent);
+            extent = next;
+        }
         free(self->mem);
         free(self);
     }
@@ -167,7 +197,51 @@ int pool_clear(POOL pool)
         return -1;
     }
 
-    internal_pool_setup(self, self->mem, self->data_bytes, self->capacity);
+    struct pool_extent *extents = self->extents;
+    size_t capacity = self->capacity;
+    for (struct pool_extent *extent = extents; extent != NULL; extent = extent->next) {
+        capacity -= extent->capacity;
+    }
+    internal_pool_setup(self, self->mem, self->data_bytes, capacity);
+    self->extents = extents;
+    for (struct pool_extent *extent = extents; extent != NULL; extent = extent->next) {
+        internal_pool_extend(self, extent);
+    }
+
+    return 0;
+}
+
+/**
+ *  @details    @c pool の容量を @c capacity 要素分拡張する.
+ *              取得済みのメモリ要素は移動しない.
+ *
+ *  @pre        @c pool は pool_init() の戻り値である必要がある.
+ *  @param      [in,out]    pool        プールオブジェクト.
+ *  @param      [in]        capacity    追加する容量. (要素数)
+ *  @return     成功時は 0 が返る.
+ *              失敗時は -1 が返り, errno が適切に設定される.
+ *  @warning    本関数はスレッドセーフではない.
+ */
+int pool_expand(POOL pool, size_t capacity)
+{
+    struct pool *self = (struct pool *)pool;
+    struct pool_extent *extent;
+    size_t node_bytes;
+
+    if ((self == NULL) || (capacity == 0)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    node_bytes = max(self->data_bytes, sizeof(struct pool_node));
+    extent = calloc(1, sizeof(*extent) + (node_bytes * capacity));
+    if (extent == NULL) {
+        return -1;
+    }
+    extent->capacity = capacity;
+    extent->next = self->extents;
+    self->extents = extent;
+    internal_pool_extend(self, extent);
 
     return 0;
 }
@@ -279,7 +353,17 @@ bool pool_contains(POOL pool, void *ptr)
         return -1;
     }
 
-    void *mem_end = self->mem + (self->data_bytes * self->capacity);
+    size_t node_bytes = max(self->data_bytes, sizeof(struct pool_node));
+    size_t capacity = self->capacity;
+    for (struct pool_extent *extent = self->extents; extent != NULL; extent = extent->next) {
+        void *ext_end = extent->mem + (node_bytes * extent->capacity);
+        if (((void *)extent->mem <= ptr) && (ptr < ext_end)) {
+            return true;
+        }
+        capacity -= extent->capacity;
+    }
+
+    void *mem_end = self->mem + (node_bytes * capacity);
     return (self->mem <= ptr) && (ptr < mem_end);
 }
 
@@ -1176,6 +1260,7 @@ enum ntree_trav_action {
  */
 struct ntree_node {
     struct ntree_node *first_child;  /**< 最初の子要素へのポインタ. */
+    struct ntree_node *last_child;   /**< 最後の子要素へのポインタ. */
     struct ntree_node *next_sibling; /**< 次の兄弟要素へのポインタ. */
     struct ntree_node *parent;       /**< 親要素へのポインタ. */
     enum ntree_trav_action action;
@@ -1189,6 +1274,7 @@ struct ntree_node {
 #define NTREE_NODE_INITIALIZER  \
     (struct ntree_node){        \
         .first_child = NULL,    \
+        .last_child = NULL,     \
         .next_sibling = NULL,   \
         .parent = NULL,         \
         .action = ACT_INACTIVE, \
@@ -1365,14 +1451,11 @@ static struct ntree_node *internal_ntree_insert(struct ntree *self,
     if ((node->parent != NULL)
         && (memcmp(parent, node->parent->data, self->data_bytes) == 0)) {
 
-        struct ntree_node *sibling = node;
-        while (sibling->next_sibling != NULL) {
-            sibling = sibling->next_sibling;
-        }
-        sibling = sibling->next_sibling = pool_alloc(self->pool);
+        struct ntree_node *sibling = pool_alloc(self->pool);
         if (sibling == NULL) {
             return NULL;
         }
+        node->parent->last_child = node->parent->last_child->next_sibling = sibling;
         *sibling = NTREE_NODE_INITIALIZER;
         sibling->parent = node->parent;
         sibling->age = node->parent->age + 1;
@@ -1471,6 +1554,28 @@ int ntree_clear(NTREE tree)
     return 0;
 }
 
+/**
+ *  @details    @c tree の容量を @c capacity 要素分拡張する.
+ *              追加済みの要素は移動しない.
+ *
+ *  @param      [in,out]    tree        ツリーオブジェクト.
+ *  @param      [in]        capacity    追加する容量.
+ *  @return     成功時は, 0 が返る.
+ *              失敗時は, -1 が返り, errno が適切に設定される.
+ *  @warning    スレッドセーフではない.
+ */
+int ntree_expand(NTREE tree, size_t capacity)
+{
+    struct ntree *self = (struct ntree *)tree;
+
+    if (self == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    return pool_expand(self->pool, capacity);
+}
+
 NTREE_NODE ntree_insert(NTREE tree, void *data)
 {
     return ntree_insert_at(tree, NULL, data);
@@ -1509,14 +1614,14 @@ NTREE_NODE ntree_insert_at(NTREE tree, NTREE_NODE parent, void *data)
         added = sibling->next_sibling = pool_alloc(self->pool);
         age = 1;
     } else {
-        if (node->first_child == NULL) {
-            added = node->first_child = pool_alloc(self->pool);
-        } else {
-            struct ntree_node *child = node->first_child;
-            while (child->next_sibling != NULL) {
-                child = child->next_sibling;
+        added = pool_alloc(self->pool);
+        if (added != NULL) {
+            if (node->first_child == NULL) {
+                node->first_child = added;
+            } else {
+                node->last_child->next_sibling = added;
             }
-            added = child->next_sibling = pool_alloc(self->pool);
+            node->last_child = added;
         }
         age = node->age + 1;
     }
@@ -1608,12 +1713,18 @@ int ntree_remove(NTREE tree, NTREE_NODE node)
         struct ntree_node *parent = current->parent;
         if ((parent != NULL) && (parent->first_child == current)) {
             parent->first_child = current->next_sibling;
+            if (parent->last_child == current) {
+                parent->last_child = NULL;
+            }
         } else {
             struct ntree_node *old_sib = (parent != NULL) ? parent->first_child : self->root;
             while (old_sib->next_sibling != current) {
                 old_sib = old_sib->next_sibling;
             }
             old_sib->next_sibling = current->next_sibling;
+            if ((parent != NULL) && (parent->last_child == current)) {
+                parent->last_child = old_sib;
+            }
         }
     }
     current->parent = current->next_sibling = NULL;
@@ -1650,6 +1761,209 @@ void *ntree_data(NTREE_NODE node)
     return (self != NULL) ? self->data : NULL;
 }
 
+/**
+ *  @details    @c node の親要素を返す.
+ *
+ *  @param      [in]    node    ツリーノード.
+ *  @return     親要素が返る. ルート階層の要素は NULL が返る.
+ */
+NTREE_NODE ntree_parent(NTREE_NODE node)
+{
+    struct ntree_node *self = (struct ntree_node *)node;
+
+    return (self != NULL) ? (NTREE_NODE)self->parent : NULL;
+}
+
+/**
+ *  @details    @c node の最後の子要素を返す.
+ *              子要素の数によらず定数時間で返る.
+ *
+ *  @param      [in]    node    ツリーノード.
+ *  @return     最後の子要素が返る. 子要素が無い場合は NULL が返る.
+ */
+NTREE_NODE ntree_last_child(NTREE_NODE node)
+{
+    struct ntree_node *self = (struct ntree_node *)node;
+
+    return (self != NULL) ? (NTREE_NODE)self->last_child : NULL;
+}
+
+/**
+ *  @details    @c node を子孫ごと @c parent の最後の子要素に移す.
+ *              @c node は他のツリーの要素でもよいが, そのツリーは
+ *              @c node より先に解放しないこと.
+ *
+ *  @param      [in,out]    parent  移動先の親要素.
+ *  @param      [in,out]    node    移動する要素. ルート階層の要素は不可.
+ *  @return     成功時は 0 が返る.
+ *              失敗時は -1 が返り, errno が適切に設定される.
+ *  @warning    スレッドセーフではない.
+ */
+int ntree_move(NTREE_NODE parent, NTREE_NODE node)
+{
+    struct ntree_node *self = (struct ntree_node *)node;
+    struct ntree_node *to = (struct ntree_node *)parent;
+
+    if ((self == NULL) || (to == NULL) || (self->parent == NULL)) {
+        errno = EINVAL;
+        return -1;
+    }
+    for (struct ntree_node *ancestor = to; ancestor != NULL; ancestor = ancestor->parent) {
+        if (ancestor == self) {
+            errno = EINVAL;
+            return -1;
+        }
+    }
+
+    struct ntree_node *from = self->parent;
+    if (from->first_child == self) {
+        from->first_child = self->next_sibling;
+        if (from->last_child == self) {
+            from->last_child = NULL;
+        }
+    } else {
+        struct ntree_node *sibling = from->first_child;
+        while (sibling->next_sibling != self) {
+            sibling = sibling->next_sibling;
+        }
+        sibling->next_sibling = self->next_sibling;
+        if (from->last_child == self) {
+            from->last_child = sibling;
+        }
+    }
+
+    self->next_sibling = NULL;
+    self->parent = to;
+    if (to->first_child == NULL) {
+        to->first_child = self;
+    } else {
+        to->last_child->next_sibling = self;
+    }
+    to->last_child = self;
+
+    /* 深さが変わる場合のみ子孫の世代を振り直す. */
+    int delta = (to->age + 1) - self->age;
+    struct ntree_node *current = (delta != 0) ? self : NULL;
+    while (current != NULL) {
+        current->age += delta;
+        if (current->first_child != NULL) {
+            current = current->first_child;
+            continue;
+        }
+        while ((current != self) && (current->next_sibling == NULL)) {
+            current = current->parent;
+        }
+        current = (current != self) ? current->next_sibling : NULL;
+    }
+
+    return 0;
+}
+
+/**
+ *  @details    @c from のすべての子要素を子孫ごと @c parent の最後の
+ *              子要素として移す. 順序は保たれる.
+ *              @c from は他のツリーの要素でもよいが, そのツリーは
+ *              移した要素より先に解放しないこと.
+ *
+ *  @param      [in,out]    parent  移動先の親要素.
+ *  @param      [in,out]    from    移動元の親要素.
+ *  @return     成功時は 0 が返る.
+ *              失敗時は -1 が返り, errno が適切に設定される.
+ *  @warning    スレッドセーフではない.
+ */
+int ntree_move_children(NTREE_NODE parent, NTREE_NODE from)
+{
+    struct ntree_node *to = (struct ntree_node *)parent;
+    struct ntree_node *self = (struct ntree_node *)from;
+
+    if ((to == NULL) || (self == NULL) || (to == self)) {
+        errno = EINVAL;
+        return -1;
+    }
+    for (struct ntree_node *ancestor = to; ancestor != NULL; ancestor = ancestor->parent) {
+        if (ancestor->parent == self) {
+            errno = EINVAL;
+            return -1;
+        }
+    }
+    if (self->first_child == NULL) {
+        return 0;
+    }
+
+    struct ntree_node *first = self->first_child;
+    if (to->first_child == NULL) {
+        to->first_child = first;
+    } else {
+        to->last_child->next_sibling = first;
+    }
+    to->last_child = self->last_child;
+    self->first_child = self->last_child = NULL;
+
+    int delta = to->age - self->age;
+    for (struct ntree_node *child = first; child != NULL; child = child->next_sibling) {
+        child->parent = to;
+        /* 深さが変わる場合のみ子孫の世代を振り直す. */
+        struct ntree_node *current = (delta != 0) ? child : NULL;
+        while (current != NULL) {
+            current->age += delta;
+            if (current->first_child != NULL) {
+                current = current->first_child;
+                continue;
+            }
+            while ((current != child) && (current->next_sibling == NULL)) {
+                current = current->parent;
+            }
+            current = (current != child) ? current->next_sibling : NULL;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ *  @details    @c parent の子要素を @c children の順に並べ替える.
+ *
+ *  @param      [in,out]    parent      ツリーノード.
+ *  @param      [in]        children    @c parent のすべての子要素.
+ *  @param      [in]        count       @c children の要素数.
+ *  @return     成功時は 0 が返る.
+ *              失敗時は -1 が返り, errno が適切に設定される.
+ *  @warning    スレッドセーフではない.
+ */
+int ntree_reorder(NTREE_NODE parent, NTREE_NODE *children, size_t count)
+{
+    struct ntree_node *self = (struct ntree_node *)parent;
+    size_t actual = 0;
+
+    if ((self == NULL) || ((children == NULL) && (count > 0))) {
+        errno = EINVAL;
+        return -1;
+    }
+    for (struct ntree_node *child = self->first_child; child != NULL; child = child->next_sibling) {
+        ++actual;
+    }
+    if (actual != count) {
+        errno = EINVAL;
+        return -1;
+    }
+    for (size_t i = 0; i < count; ++i) {
+        if (((struct ntree_node *)children[i])->parent != self) {
+            errno = EINVAL;
+            return -1;
+        }
+    }
+
+    struct ntree_node **link = &self->first_child;
+    for (size_t i = 0; i < count; ++i) {
+        *link = (struct ntree_node *)children[i];
+        link = &(*link)->next_sibling;
+    }
+    *link = NULL;
+    self->last_child = (count > 0) ? (struct ntree_node *)children[count - 1] : NULL;
+
+    return 0;
+}
+
 /**
  *  @details    @c tree に追加されている要素の数を返す.
  *
@@ -64,6 +64,11 @@ void *pool_alloc(POOL pool);
  */
 void pool_free(POOL pool, void *ptr);
 
+/**
+ *  メモリプールの容量を拡張する.
+ */
+int pool_expand(POOL pool, size_t capacity);
+
 /**
  *  メモリプールのデータ部サイズを取得する.
  */
@@ -457,6 +462,11 @@ void ntree_release(NTREE tree);
  */
 int ntree_clear(NTREE tree);
 
+/**
+ *  N-ary ツリーの容量を拡張する.
+ */
+int ntree_expand(NTREE tree, size_t capacity);
+
 /**
  *  N-ary 要素をツリーに挿入する.
  */
@@ -468,6 +478,31 @@ int ntree_remove(NTREE tree, NTREE_NODE node);
 
 void *ntree_data(NTREE_NODE node);
 
+/**
+ *  N-ary ツリーノードの親要素を取得する.
+ */
+NTREE_NODE ntree_parent(NTREE_NODE node);
+
+/**
+ *  N-ary ツリーノードの最後の子要素を取得する.
+ */
+NTREE_NODE ntree_last_child(NTREE_NODE node);
+
+/**
+ *  N-ary ツリーノードを子孫ごと他の親要素の下に移す.
+ */
+int ntree_move(NTREE_NODE parent, NTREE_NODE node);
+
+/**
+ *  N-ary ツリーノードの子要素をすべて他の親要素の下に移す.
+ */
+int ntree_move_children(NTREE_NODE parent, NTREE_NODE from);
+
+/**
+ *  N-ary ツリーノードの子要素を並べ替える.
+ */
+int ntree_reorder(NTREE_NODE parent, NTREE_NODE *children, size_t count);
+
 /**
  *  N-ary ツリーの要素の数を取得する.
  */
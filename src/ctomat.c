@@ -7,6 +7,7 @@
  *
  *  This code is licensed under the MIT License.
  */
+#define _POSIX_C_SOURCE 200809L
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
@@ -15,10 +16,20 @@
 #include <unistd.h>
 #include <string.h>
 #include <errno.h>
+#include <math.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
 
 #include "debug.h"
 #include "collections.h"
 #include "utils.h"
+#include "lexer.h"
+#include "number.h"
+#include "datetime.h"
+#include "escape.h"
 #include "ctomat.h"
 
 enum toml_value_type {
@@ -29,183 +40,492 @@ enum toml_value_type {
     VAL_TYPE_INTEGER,
     VAL_TYPE_FLOAT,
     VAL_TYPE_BOOLEAN,
+    VAL_TYPE_DATETIME,
+    VAL_TYPE_ARRAY,
+    VAL_TYPE_LAZY, /**< not classified yet; the view covers the value as written. */
 };
 
+#define SMALL_STRING_BYTES (16)
+
+/**
+ *  How a table came to be, which decides how it may be extended.
+ */
+enum toml_table_flags {
+    TABLE_IMPLICIT = 0x01, /**< created on the way to a header. */
+    TABLE_HEADER = 0x02,   /**< defined by a header. */
+    TABLE_DOTTED = 0x04,   /**< defined by dotted keys. */
+    TABLE_ARRAY = 0x08,    /**< array of tables, appended to by headers. */
+    TABLE_INLINE = 0x10,   /**< inline table, complete as written. */
+};
+
+/**
+ *  Strings are views into the document source (or into memory owned by
+ *  the document), so they are not NUL-terminated unless @c terminated.
+ *  Short strings are terminated in @c small, inside the node. Tables and
+ *  arrays of a compiled image use that space for their image node until
+ *  all of their children have nodes.
+ *
+ *  Arrays whose elements are all scalars of one type keep them packed in
+ *  @c array_elements, as int64_t, double, bool, toml_view_t or
+ *  toml_datetime_t;
+ *  other arrays keep them in child nodes.
+ */
 struct toml_value {
     enum toml_value_type type;
+    bool terminated;
+    uint8_t table_flags;
+    uint8_t array_type; /**< type of the packed elements, VAL_TYPE_NONE if in nodes. */
+    bool dirty;         /**< changed since loaded; see toml_mark_dirty(). */
     union {
-        char string_value[256];
+        struct {
+            const char *string_value;
+            size_t string_length;
+        };
         int64_t integer_value;
+        double float_value;
+        bool boolean_value;
+        toml_datetime_t datetime_value;
+        struct toml_index *index; /**< children of an object, once indexed. */
+        struct {
+            const void *array_elements;
+            size_t array_length;
+        };
+    };
+    union {
+        char small[SMALL_STRING_BYTES];
+        const struct image_node *image; /**< children not all made yet; see image_complete(). */
     };
 };
 
 #define TOML_VALUE_INITIALIZER \
     (struct toml_value){       \
         .type = VAL_TYPE_NONE, \
-        .string_value = {0},   \
+        .terminated = false,   \
+        .table_flags = 0,      \
+        .array_type = 0,       \
+        .dirty = false,        \
+        .string_value = NULL,  \
+        .string_length = 0,    \
     }
 
 struct toml_key {
-    char name[256];
+    const char *name;
+    size_t name_length;
     struct toml_value value;
 };
 
 #define TOML_KEY_INITIALIZER             \
     (struct toml_key){                   \
-        .name = {0},                     \
+        .name = NULL,                    \
+        .name_length = 0,                \
         .value = TOML_VALUE_INITIALIZER, \
     }
 
-struct toml {
-    NTREE global;
+/**
+ *  Memory owned by the document, released with it.
+ */
+struct toml_block {
+    struct toml_block *next;
+    char data[];
+};
+
+struct toml_document {
+    NTREE tree;
     struct toml *root;
+    const char *source;        /**< text the nodes refer to. */
+    size_t source_length;
+    bool mapped;               /**< @c source is a file mapping. */
+    int flags;                 /**< TOML_LOAD_* flags. */
+    struct toml_block *blocks;
+    char *arena;               /**< free space of the current arena block. */
+    size_t arena_left;
+    struct toml_tables *tables; /**< tables opened by headers, by full path. */
+    char *scratch;             /**< packed elements of the array being built. */
+    size_t scratch_length;
+    size_t scratch_capacity;
+    struct toml **dirty;       /**< values changed since loaded. */
+    size_t dirty_length;
+    size_t dirty_capacity;
+    const char *image;         /**< mapping of a compiled image the nodes refer to. */
+    size_t image_length;
+    struct toml **image_nodes; /**< nodes made so far for the image nodes, by index. */
+    NTREE *grafts;             /**< trees of a parallel load whose nodes were moved into @c tree. */
+    size_t graft_count;
+};
+
+#define TOML_DOCUMENT_INITIALIZER \
+    (struct toml_document){       \
+        .tree = NULL,             \
+        .root = NULL,             \
+        .source = NULL,           \
+        .source_length = 0,       \
+        .mapped = false,          \
+        .flags = 0,               \
+        .blocks = NULL,           \
+        .arena = NULL,            \
+        .arena_left = 0,          \
+        .tables = NULL,           \
+        .scratch = NULL,          \
+        .scratch_length = 0,      \
+        .scratch_capacity = 0,    \
+        .dirty = NULL,            \
+        .dirty_length = 0,        \
+        .dirty_capacity = 0,      \
+        .image = NULL,            \
+        .image_length = 0,        \
+        .image_nodes = NULL,      \
+        .grafts = NULL,           \
+        .graft_count = 0,         \
+    }
+
+struct toml {
+    struct toml_document *doc;
+    NTREE_NODE node;
     struct toml_key key;
     _Atomic size_t ref_count;
 };
 
 #define TOML_INITIALIZER             \
     (struct toml){                   \
-        .global = NULL,              \
-        .root = NULL,                \
+        .doc = NULL,                 \
+        .node = NULL,                \
         .key = TOML_KEY_INITIALIZER, \
         .ref_count = 1,              \
     }
 
-#define min(a, b) (((a) < (b)) ? (a) : (b))
+#define NODES_INITIAL_CAPACITY (16)
+#define ARENA_BLOCK_BYTES (4096)
+#define INDEX_THRESHOLD (8)
+#define INDEX_MIN_CAPACITY (32)
+#define PARALLEL_SEGMENT_MIN (256 * 1024)
+#define PARALLEL_SEGMENTS_MAX (64)
+#define KEY_DEPTH_MAX (64)
+#define VALUE_DEPTH_MAX (32)
 
-static void strip(char *buf)
-{
-    char *head = buf;
-    char *tail;
-    char *cur;
+/**
+ *  Position of a parse, carried from one parse_document() call to the next.
+ */
+struct parse_state {
+    size_t line;
+    size_t consumed; /**< bytes of complete statements parsed. */
+    bool partial;    /**< more input may follow. */
+    bool quiet;      /**< leave error reports to a serial retry. */
+    size_t stopped;  /**< where the incomplete statement ran out of input. */
+    size_t nesting;  /**< arrays and inline tables open at @c stopped. */
+};
 
-    while ((*head == ' ') || (*head == '\t')) {
-        ++head;
+#define PARSE_STATE_INITIALIZER \
+    (struct parse_state){       \
+        .line = 1,              \
+        .consumed = 0,          \
+        .partial = false,       \
+        .quiet = false,         \
+        .stopped = 0,           \
+        .nesting = 0,           \
     }
-    cur = tail = head;
-    while (*cur != '\0') {
-        if ((*cur != ' ') && (*cur != '\t') && (*cur != '\r') && (*cur != '\n')) {
-            tail = cur + 1;
-        }
-        ++cur;
+
+/**
+ *  An array or inline table being built.
+ */
+struct tree_frame {
+    struct toml *node;
+    struct toml *table; /**< current table outside of it. */
+    bool packed;        /**< the elements so far are in the scratch buffer. */
+};
+
+/**
+ *  Building the tree is one more consumer of the parse events;
+ *  see tree_callbacks.
+ */
+struct tree_builder {
+    struct toml *obj;
+    struct toml *object; /**< node of the last key. */
+    struct toml *table;  /**< table opened by the last header, or inline table. */
+    size_t depth;        /**< arrays and inline tables open. */
+    struct tree_frame frames[VALUE_DEPTH_MAX];
+};
+
+#define TREE_BUILDER_INITIALIZER(root) \
+    (struct tree_builder){             \
+        .obj = (root),                 \
+        .object = NULL,                \
+        .table = (root),               \
+        .depth = 0,                    \
     }
-    for (cur = head; cur < tail; ++cur, ++buf) {
-        *buf = *cur;
+
+static char *toml_block_alloc(struct toml_document *doc, size_t size)
+{
+    struct toml_block *block = malloc(sizeof(*block) + size);
+    if (block == NULL) {
+        return NULL;
     }
-    *buf = '\0';
+    block->next = doc->blocks;
+    doc->blocks = block;
+
+    return block->data;
 }
 
-static void dequote(char *buf)
+/**
+ *  Bump-allocates @c size bytes from the document arena.
+ *  Large requests get a block of their own.
+ */
+static char *toml_arena_alloc(struct toml_document *doc, size_t size)
 {
-    char *head = buf;
-    char *tail = buf + strlen(buf);
-    char *cur;
-
-    size_t quotes = 0;
-    while ((*head == '"') || (*head == '\'')) {
-        ++head;
-        ++quotes;
-    }
-    if (*head == '\0') {
-        if (quotes == 2) {
-            head = buf + 1;
-            tail -= 1;
-        } else if (quotes == 6) {
-            head = buf + 3;
-            tail -= 3;
-        } else {
-            return;
+    if (size > doc->arena_left) {
+        if (size > (ARENA_BLOCK_BYTES / 4)) {
+            return toml_block_alloc(doc, size);
         }
-    } else {
-        if ((quotes != 1) && (quotes != 3)) {
-            return;
+        char *block = toml_block_alloc(doc, ARENA_BLOCK_BYTES);
+        if (block == NULL) {
+            return NULL;
         }
-        tail -= quotes;
+        doc->arena = block;
+        doc->arena_left = ARENA_BLOCK_BYTES;
     }
 
-    for (cur = head; cur < tail; ++cur, ++buf) {
-        *buf = *cur;
+    char *allocated = doc->arena;
+    doc->arena += size;
+    doc->arena_left -= size;
+
+    return allocated;
+}
+
+/**
+ *  Allocates @c size bytes from the document arena, aligned for any
+ *  element of a packed array.
+ */
+static void *toml_arena_alloc_aligned(struct toml_document *doc, size_t size)
+{
+    size_t padding = (-(uintptr_t)doc->arena) & (sizeof(int64_t) - 1);
+
+    if ((padding > 0) && ((padding + size) <= doc->arena_left)) {
+        doc->arena += padding;
+        doc->arena_left -= padding;
+    } else if (padding > 0) {
+        /* a fresh block is aligned. */
+        doc->arena_left = 0;
     }
-    *buf = '\0';
+
+    return toml_arena_alloc(doc, size);
 }
 
-static void remove_comment(char *buf)
+static char *toml_strndup(struct toml_document *doc, const char *str, size_t length)
 {
-    char *comment = strchr(buf, '#');
-    if (comment != NULL) {
-        *comment = '\0';
+    char *copied = toml_arena_alloc(doc, length + 1);
+    if (copied == NULL) {
+        return NULL;
     }
+    memcpy(copied, str, length);
+    copied[length] = '\0';
+
+    return copied;
 }
 
-static char *get_expr(char *buf, char *expr)
+/**
+ *  Open-addressing hash index of the children of an object,
+ *  with linear probing.
+ */
+struct toml_index_slot {
+    uint32_t hash;
+    struct toml *child;
+};
+
+struct toml_index {
+    size_t capacity; /**< power of two. */
+    size_t count;
+    struct toml_index_slot slots[];
+};
+
+static uint32_t key_hash(const char *name, size_t length)
 {
-    char *cur = buf;
+    uint32_t hash = 2166136261u;
 
-    while ((*cur != '\n') && (*cur != '\0')) {
-        *expr++ = *cur++;
+    for (size_t i = 0; i < length; ++i) {
+        hash ^= (uint8_t)name[i];
+        hash *= 16777619u;
     }
-    if (*cur != '\0') {
-        ++cur;
+
+    return hash;
+}
+
+static struct toml *index_find(const struct toml_index *index, const char *name, size_t length, uint32_t hash)
+{
+    size_t mask = index->capacity - 1;
+
+    for (size_t i = hash & mask; index->slots[i].child != NULL; i = (i + 1) & mask) {
+        struct toml *child = index->slots[i].child;
+        if ((index->slots[i].hash == hash)
+            && (child->key.name_length == length)
+            && (memcmp(child->key.name, name, length) == 0)) {
+
+            return child;
+        }
     }
-    *expr = '\0';
 
-    return cur;
+    return NULL;
 }
 
-static int parse_sweeped_expr(char *buf, char *lv, size_t lv_len, char *rv, size_t rv_len)
+/**
+ *  Adds @c child unless a sibling of the same name is there already,
+ *  so that lookups find the first one as a scan would.
+ */
+static void index_put(struct toml_index *index, struct toml *child, uint32_t hash)
 {
-    char *operator = strchr(buf, '=');
-    size_t expr_len = strlen(buf);
-    size_t count;
+    size_t mask = index->capacity - 1;
+    size_t i;
 
-    if (operator == NULL) {
-        errno = EINVAL;
+    for (i = hash & mask; index->slots[i].child != NULL; i = (i + 1) & mask) {
+        struct toml *other = index->slots[i].child;
+        if ((index->slots[i].hash == hash)
+            && (other->key.name_length == child->key.name_length)
+            && (memcmp(other->key.name, child->key.name, child->key.name_length) == 0)) {
+
+            return;
+        }
+    }
+    index->slots[i].hash = hash;
+    index->slots[i].child = child;
+    ++index->count;
+}
+
+/**
+ *  Indexes the children of @c object in a table of @c capacity slots,
+ *  or of a size fitting the children if @c capacity is 0.
+ *  Old tables are left to the document, which releases them together.
+ */
+static int index_build(struct toml_document *doc, struct toml *object, size_t capacity)
+{
+    struct toml_index *index;
+
+    if (capacity == 0) {
+        size_t count = 0;
+        for (ITER iter = ntree_children_iter(object->node); !iter_is_end(iter); iter = iter_next(iter)) {
+            ++count;
+        }
+        capacity = INDEX_MIN_CAPACITY;
+        while (capacity < (count * 2)) {
+            capacity *= 2;
+        }
+    }
+
+    size_t bytes = sizeof(*index) + (capacity * sizeof(index->slots[0]));
+
+    index = (struct toml_index *)toml_block_alloc(doc, bytes);
+    if (index == NULL) {
         return -1;
     }
+    memset(index, 0, bytes);
+    index->capacity = capacity;
+    for (ITER iter = ntree_children_iter(object->node); !iter_is_end(iter); iter = iter_next(iter)) {
+        struct toml *child = (struct toml *)iter_data(iter);
+        index_put(index, child, key_hash(child->key.name, child->key.name_length));
+    }
+    object->key.value.index = index;
+
+    return 0;
+}
 
-    count = min(operator - buf, lv_len - 1);
-    strncpy(lv, buf, count);
-    lv[count] = '\0';
-    count = min(expr_len - (operator - buf) - 1, rv_len - 1);
-    strncpy(rv, operator + 1, count);
-    rv[count] = '\0';
+/**
+ *  Adds @c child, just linked as the last child of @c parent, to the
+ *  index of @c parent if it has one.
+ */
+static int index_add(struct toml_document *doc, struct toml *parent, struct toml *child)
+{
+    struct toml_index *index = parent->key.value.index;
+
+    if ((parent->key.value.type != VAL_TYPE_OBJECT) || (index == NULL)) {
+        return 0;
+    }
+    if (((index->count + 1) * 2) > index->capacity) {
+        return index_build(doc, parent, index->capacity * 2);
+    }
+    index_put(index, child, key_hash(child->key.name, child->key.name_length));
 
     return 0;
 }
 
+/**
+ *  Inserts @c object as the last child of @c parent,
+ *  growing the node tree when it is full.
+ */
+static struct toml *toml_insert(struct toml_document *doc, struct toml *parent, struct toml *object)
+{
+    NTREE_NODE parent_node = (parent != NULL) ? parent->node : NULL;
+    NTREE_NODE node;
+
+    object->doc = doc;
+    node = ntree_insert_at(doc->tree, parent_node, object);
+    if ((node == NULL) && (errno == ENOMEM)) {
+        if (ntree_expand(doc->tree, ntree_count(doc->tree)) != 0) {
+            return NULL;
+        }
+        node = ntree_insert_at(doc->tree, parent_node, object);
+    }
+    if (node == NULL) {
+        return NULL;
+    }
+
+    struct toml *added = (struct toml *)ntree_data(node);
+    added->node = node;
+    if ((parent != NULL) && (index_add(doc, parent, added) != 0)) {
+        return NULL;
+    }
+
+    return added;
+}
+
 static struct toml *toml_alloc(void)
 {
-    NTREE global = ntree_init(sizeof(struct toml), 10);
-    if (global == NULL) {
+    struct toml_document *doc = malloc(sizeof(*doc));
+    if (doc == NULL) {
         return NULL;
     }
-    struct toml *root = (struct toml *)ntree_insert(global, NULL, &TOML_INITIALIZER);
+    *doc = TOML_DOCUMENT_INITIALIZER;
 
-    root->global = global;
-    root->root   = root;
+    doc->tree = ntree_init(sizeof(struct toml), NODES_INITIAL_CAPACITY);
+    if (doc->tree == NULL) {
+        free(doc);
+        return NULL;
+    }
 
-    return root;
+    struct toml root = TOML_INITIALIZER;
+    root.key.value.type = VAL_TYPE_OBJECT;
+    doc->root = toml_insert(doc, NULL, &root);
+    if (doc->root == NULL) {
+        ntree_release(doc->tree);
+        free(doc);
+        return NULL;
+    }
+
+    return doc->root;
 }
 
 static void toml_free(struct toml *obj)
 {
-    for (ITER iter = ntree_iter_all(obj->global); iter != NULL; iter = iter_next(iter)) {
-        struct toml_key *key = &((struct toml *)iter_data(iter))->key;
-        int age = ntree_iter_age(iter);
-        switch (key->value.type) {
-        case VAL_TYPE_OBJECT:
-            DEBUG("[%d]%s: is object", age, key->name);
-            break;
-        case VAL_TYPE_BASIC_STRING:
-        case VAL_TYPE_LITERAL_STRING:
-            DEBUG("[%d]%s: '%s'", age, key->name, key->value.string_value);
-            break;
-        default:
-            ERROR("[%d]%s: unknown value", age, key->name);
-            break;
-        }
+    struct toml_document *doc = obj->doc;
+
+    ntree_release(doc->tree);
+    for (size_t i = 0; i < doc->graft_count; ++i) {
+        ntree_release(doc->grafts[i]);
+    }
+    free(doc->grafts);
+    free(doc->scratch);
+    free(doc->dirty);
+    while (doc->blocks != NULL) {
+        struct toml_block *next = doc->blocks->next;
+        free(doc->blocks);
+        doc->blocks = next;
+    }
+    if (doc->mapped) {
+        munmap((void *)doc->source, doc->source_length);
+    } else {
+        free((void *)doc->source);
     }
-    ntree_release(obj->global);
+    if (doc->image != NULL) {
+        munmap((void *)doc->image, doc->image_length);
+    }
+    free(doc->image_nodes);
+    free(doc);
 }
 
 toml_t toml_create(void)
@@ -224,199 +544,269 @@ int toml_delete(toml_t object, bool forced)
     return 0;
 }
 
-toml_t toml_object_get(toml_t object, const char *key)
+static struct toml *image_find(struct toml *object, const char *name, size_t length, uint32_t hash);
+static struct toml *image_child(struct toml *parent, uint64_t position);
+
+/**
+ *  Finds the child of @c object named @c name; @c hash is its key_hash().
+ */
+static struct toml *object_find(struct toml *object, const char *name, size_t length, uint32_t hash)
 {
-    for (ITER iter = ntree_iter_children(object->global); iter != NULL; iter = iter_next(iter)) {
-        struct toml_key *iter_key = &((struct toml *)iter_data(iter))->key;
-        DEBUG("key: %s <> %s", iter_key->name, key);
+    if (object->key.value.type != VAL_TYPE_OBJECT) {
+        errno = ENOENT;
+        return NULL;
+    }
+
+    struct toml_value *value = &object->key.value;
+    if (value->image != NULL) {
+        return image_find(object, name, length, hash);
+    }
+    if (value->index == NULL) {
+        struct toml *found = NULL;
+        size_t scanned = 0;
+        for (ITER iter = ntree_children_iter(object->node); !iter_is_end(iter); iter = iter_next(iter)) {
+            struct toml *child = (struct toml *)iter_data(iter);
+            ++scanned;
+            if ((child->key.name_length == length) && (memcmp(child->key.name, name, length) == 0)) {
+                found = child;
+                iter_release(iter);
+                break;
+            }
+        }
+        /* index larger tables for the next lookups. */
+        if (scanned > INDEX_THRESHOLD) {
+            index_build(object->doc, object, 0);
+        }
+        if (found != NULL) {
+            return found;
+        }
+    } else {
+        struct toml *child = index_find(value->index, name, length, hash);
+        if (child != NULL) {
+            return child;
+        }
     }
 
+    errno = ENOENT;
     return NULL;
 }
 
-const char *toml_string_value(toml_t string)
+toml_t toml_object_get(toml_t object, const char *key)
 {
-    return NULL;
+    size_t length;
+
+    if ((object == NULL) || (key == NULL)) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    length = strlen(key);
+
+    return object_find(object, key, length, key_hash(key, length));
 }
 
-int toml_string_set(toml_t string, const char *value)
+static bool is_key_token(const struct token *token)
 {
-    return -1;
+    return (token->type == TOKEN_BARE_KEY)
+           || (token->type == TOKEN_BASIC_STRING)
+           || (token->type == TOKEN_LITERAL_STRING);
 }
 
-toml_t toml_load(const char *pathname)
-{
-    toml_t obj = toml_alloc();
-    printf("%s:%d:%s Hello,World ref: %zu\n", __FILE__, __LINE__, __func__, obj->ref_count);
+/**
+ *  A dotted key split into segments, with their hashes.
+ *  The names live in the same allocation, after the segments.
+ */
+struct toml_path_segment {
+    const char *name;
+    size_t length;
+    uint32_t hash;
+};
 
-    return obj;
-}
+struct toml_path {
+    size_t depth;
+    struct toml_path_segment segments[];
+};
 
-static bool is_bare_key(char *key)
+toml_path_t toml_path_compile(const char *path)
 {
-    if (key[0] == '\0') {
-        return false;
+    struct token keys[KEY_DEPTH_MAX];
+    struct lexer lexer;
+    struct token token;
+    size_t depth = 0;
+
+    if (path == NULL) {
+        errno = EINVAL;
+        return NULL;
     }
 
-    for (int i = 1; key[i] != '\0'; ++i) {
-        char c = key[i];
-        if (((c < 'A') || ('Z' < c))
-            && ((c < 'a') || ('z' < c))
-            && ((c < '0') || ('9' < c))
-            && (c != '_') && (c != '-')) {
+    /* the same grammar as the keys of a document. */
+    size_t path_length = strlen(path);
+    lexer_init(&lexer, path, path_length);
+    lexer.quiet = true;
+    for (;;) {
+        lexer_next(&lexer, &token);
+        if (!is_key_token(&token) || (depth == KEY_DEPTH_MAX)) {
+            errno = EINVAL;
+            return NULL;
+        }
+        keys[depth++] = token;
+        lexer_next(&lexer, &token);
+        if (token.type == TOKEN_EOF) {
+            break;
+        }
+        if (token.type != TOKEN_DOT) {
+            errno = EINVAL;
+            return NULL;
+        }
+    }
 
-            return false;
+    struct toml_path *compiled = malloc(sizeof(*compiled)
+                                        + (depth * sizeof(compiled->segments[0]))
+                                        + path_length + 1);
+    if (compiled == NULL) {
+        return NULL;
+    }
+    char *names = (char *)&compiled->segments[depth];
+    memcpy(names, path, path_length + 1);
+    compiled->depth = depth;
+    for (size_t i = 0; i < depth; ++i) {
+        struct toml_path_segment *segment = &compiled->segments[i];
+        segment->name = names + (keys[i].head - path);
+        segment->length = keys[i].length;
+        /* decoded in place, as no escape sequence is shorter than its text. */
+        if ((keys[i].type == TOKEN_BASIC_STRING) && (memchr(keys[i].head, '\\', keys[i].length) != NULL)
+            && (escape_decode(keys[i].head, keys[i].length, (char *)segment->name, &segment->length) != 0)) {
+            free(compiled);
+            errno = EINVAL;
+            return NULL;
         }
+        segment->hash = key_hash(segment->name, segment->length);
     }
 
-    return true;
+    return compiled;
 }
 
-/**
- *  @warning    not support yet.
- */
-static bool is_quoted_key(char *key)
+void toml_path_release(toml_path_t path)
 {
-    return false;
+    free(path);
 }
 
-static bool is_dotted_key(char *key)
+toml_t toml_path_get(toml_t object, toml_path_t path)
 {
-    char temp[256];
-    char *head = key;
-    char *tail = strchr(head, '.');
-
-    if (tail == NULL) {
-        return false;
+    if ((object == NULL) || (path == NULL)) {
+        errno = EINVAL;
+        return NULL;
     }
-    do {
-        strncpy(temp, head, tail - head);
-        temp[tail - head] = '\0';
-        if (!is_bare_key(temp)) {
-            return false;
-        }
-        head = tail + 1;
-        tail = strchr(head, '.');
-    } while (tail != NULL);
 
-    strncpy(temp, head, sizeof(temp));
-    if (!is_bare_key(temp)) {
-        return false;
+    for (size_t i = 0; (object != NULL) && (i < path->depth); ++i) {
+        const struct toml_path_segment *segment = &path->segments[i];
+        object = object_find(object, segment->name, segment->length, segment->hash);
     }
 
-    return true;
+    return object;
 }
 
-static struct toml *parse_key(struct toml *obj, char *lval)
+size_t toml_array_length(toml_t array)
 {
-    if (is_bare_key(lval) || is_quoted_key(lval)) {
-        DEBUG("%s: valid bare-key or quoted-key", lval);
-        struct toml object = TOML_INITIALIZER;
-        strncpy(object.key.name, lval, sizeof(object.key.name) - 1);
-        return (struct toml *)ntree_insert(obj->global, obj->root, &object);
-    } else if (is_dotted_key(lval)) {
-        DEBUG("%s: valid dotted-key", lval);
-        struct toml object;
-        struct toml *parent = obj->root;
-        char temp[256];
-        char *head = lval;
-        char *tail = strchr(head, '.');
-        do {
-            strncpy(temp, head, tail - head);
-            temp[tail - head] = '\0';
-            object = TOML_INITIALIZER;
-            strncpy(object.key.name, temp, sizeof(object.key.name) - 1);
-            object.key.value.type = VAL_TYPE_OBJECT;
-            parent = ntree_insert(obj->global, parent, &object);
-            head = tail + 1;
-            tail = strchr(head, '.');
-        } while (tail != NULL);
-
-        object = TOML_INITIALIZER;
-        strncpy(object.key.name, head, sizeof(object.key.name) - 1);
-        return (struct toml *)ntree_insert(obj->global, parent, &object);
-    } else {
-        DEBUG("%s: invalid key", lval);
-        return NULL;
+    if ((array == NULL) || (array->key.value.type != VAL_TYPE_ARRAY)) {
+        errno = EINVAL;
+        return 0;
     }
-}
-
-static bool is_basic_string_value(char *value)
-{
-    return string_match("\"+\"", value);
-}
 
-__attribute__((unused))
-static bool is_multiline_basic_string_value(char *value)
-{
-    return string_match("\"\"\"+\"\"\"", value);
+    return array->key.value.array_length;
 }
 
-static bool is_literal_string_value(char *value)
+/**
+ *  Size of an element of a packed array of @c type.
+ */
+static size_t packed_size(enum toml_value_type type)
 {
-    return string_match("'+'", value);
+    switch (type) {
+    case VAL_TYPE_INTEGER:
+        return sizeof(int64_t);
+    case VAL_TYPE_FLOAT:
+        return sizeof(double);
+    case VAL_TYPE_BOOLEAN:
+        return sizeof(bool);
+    case VAL_TYPE_BASIC_STRING:
+    case VAL_TYPE_LITERAL_STRING:
+        return sizeof(toml_view_t);
+    case VAL_TYPE_DATETIME:
+        return sizeof(toml_datetime_t);
+    default:
+        return 0;
+    }
 }
 
-__attribute__((unused))
-static bool is_multiline_literal_string_value(char *value)
+/**
+ *  Where the scalar @c value is in a packed array; @c view holds a string.
+ */
+static const void *packed_element(const struct toml_value *value, toml_view_t *view)
 {
-    return string_match("'''+'''", value);
+    switch (value->type) {
+    case VAL_TYPE_INTEGER:
+        return &value->integer_value;
+    case VAL_TYPE_FLOAT:
+        return &value->float_value;
+    case VAL_TYPE_BOOLEAN:
+        return &value->boolean_value;
+    case VAL_TYPE_BASIC_STRING:
+    case VAL_TYPE_LITERAL_STRING:
+        *view = (toml_view_t){.ptr = value->string_value, .length = value->string_length};
+        return view;
+    case VAL_TYPE_DATETIME:
+        return &value->datetime_value;
+    default:
+        return NULL;
+    }
 }
 
-__attribute__((unused))
-static bool is_string_value(char *value)
+/**
+ *  Reads the packed @c element of @c type into @c value.
+ */
+static void packed_value(enum toml_value_type type, const char *element, struct toml_value *value)
 {
-    return is_basic_string_value(value)
-           || is_multiline_basic_string_value(value)
-           || is_literal_string_value(value)
-           || is_multiline_literal_string_value(value);
-}
+    size_t size = packed_size(type);
 
-static int parse_value(struct toml_key *key, char *rval)
-{
-    if (is_basic_string_value(rval)) {
-        key->value.type = VAL_TYPE_BASIC_STRING;
-        dequote(rval);
-        strncpy(key->value.string_value, rval, sizeof(key->value.string_value) - 1);
-        return 0;
-    } else if (is_literal_string_value(rval)) {
-        key->value.type = VAL_TYPE_LITERAL_STRING;
-        dequote(rval);
-        strncpy(key->value.string_value, rval, sizeof(key->value.string_value) - 1);
-        return 0;
-    } else {
-        ERROR("%s: unknown or unsuppoted value", rval);
-        return -1;
+    *value = TOML_VALUE_INITIALIZER;
+    value->type = type;
+    switch (type) {
+    case VAL_TYPE_INTEGER:
+        memcpy(&value->integer_value, element, size);
+        break;
+    case VAL_TYPE_FLOAT:
+        memcpy(&value->float_value, element, size);
+        break;
+    case VAL_TYPE_BOOLEAN:
+        memcpy(&value->boolean_value, element, size);
+        break;
+    case VAL_TYPE_BASIC_STRING:
+    case VAL_TYPE_LITERAL_STRING: {
+        toml_view_t view;
+        memcpy(&view, element, size);
+        value->string_value = view.ptr;
+        value->string_length = view.length;
+        break;
+    }
+    default:
+        memcpy(&value->datetime_value, element, size);
+        break;
     }
 }
 
-static int parse_expr(struct toml *obj, char *expr)
+/**
+ *  Moves @c count packed elements of @c type at @c elements to child
+ *  nodes of @c array.
+ */
+static int packed_unpack(struct toml *array, enum toml_value_type type, const char *elements, size_t count)
 {
-    char lval[256];
-    char rval[256];
-    int ret;
+    size_t size = packed_size(type);
 
-    remove_comment(expr);
-    strip(expr);
-    if (expr[0] != '\0') {
-        ret = parse_sweeped_expr(expr, lval, sizeof(lval), rval, sizeof(rval));
-        if (ret != 0) {
-            ERROR("error: '%s'", expr);
-            return -1;
-        }
+    for (size_t i = 0; i < count; ++i) {
+        struct toml object = TOML_INITIALIZER;
 
-        strip(lval);
-        strip(rval);
-        DEBUG("lval: '%s', rval: '%s'", lval, rval);
-        struct toml *object = parse_key(obj, lval);
-        if (object == NULL) {
-            ERROR("%s: invalid key", lval);
-            return -1;
-        }
-        ret = parse_value(&object->key, rval);
-        if (ret != 0) {
-            ntree_remove(obj->global, object);
-            ERROR("error: '%s'", rval);
+        packed_value(type, elements + (i * size), &object.key.value);
+        if (toml_insert(array->doc, array, &object) == NULL) {
             return -1;
         }
     }
@@ -424,69 +814,3791 @@ static int parse_expr(struct toml *obj, char *expr)
     return 0;
 }
 
-toml_t toml_load_from_memory(const char *buf, size_t length)
+toml_t toml_array_get(toml_t array, size_t index)
 {
-    toml_t obj = toml_alloc();
-    char expr[256];
+    if ((array == NULL) || (array->key.value.type != VAL_TYPE_ARRAY)) {
+        errno = EINVAL;
+        return NULL;
+    }
 
-    for (char *cur = get_expr((char *)buf, expr);
-         *cur != '\0';
-         cur = get_expr(cur, expr)) {
+    /* packed elements get nodes on the first access by index. */
+    struct toml_value *value = &array->key.value;
+    if (value->image != NULL) {
+        if (index >= value->array_length) {
+            errno = ENOENT;
+            return NULL;
+        }
+        return image_child(array, index);
+    }
+    if ((value->array_type != VAL_TYPE_NONE) && (ntree_last_child(array->node) == NULL)
+        && (packed_unpack(array, value->array_type, value->array_elements, value->array_length) != 0)) {
 
-        parse_expr(obj, expr);
+        return NULL;
     }
-    parse_expr(obj, expr);
 
-    return obj;
-}
+    for (ITER iter = ntree_children_iter(array->node); !iter_is_end(iter); iter = iter_next(iter)) {
+        if (index-- == 0) {
+            struct toml *element = (struct toml *)iter_data(iter);
+            iter_release(iter);
+            return element;
+        }
+    }
 
-int toml_save(toml_t object, const char *pathname)
-{
-    return 0;
+    errno = ENOENT;
+    return NULL;
 }
 
-int toml_save_to_memory(toml_t object, char *buf, size_t length)
+/**
+ *  The packed elements of @c array if they are of @c type, or of any
+ *  type if there are none.
+ */
+static const void *array_packed(toml_t array, enum toml_value_type type, size_t *length)
 {
-    size_t remain = length;
-    char line[256];
-    buf[0] = '\0';
+    /* elements of empty arrays are never read. */
+    static const toml_datetime_t no_elements[1];
 
-    for (ITER iter = ntree_iter_all(object->global); iter != NULL; iter = iter_next(iter)) {
-        struct toml_key *key = &((struct toml *)iter_data(iter))->key;
-        int age = ntree_iter_age(iter);
-        switch (key->value.type) {
-        case VAL_TYPE_OBJECT:
-            ERROR("%s: object is not supported", key->name);
-            break;
-        case VAL_TYPE_BASIC_STRING:
-            DEBUG("[%d]%s: '%s'", age, key->name, key->value.string_value);
-            strncpy(line, key->name, sizeof(line));
-            strncat(line, " = \"", sizeof(line) - strlen(line));
-            strncat(line, key->value.string_value, sizeof(line) - strlen(line));
-            strncat(line, "\"\n", sizeof(line) - strlen(line));
-            if (remain < strlen(line)) {
-                ERROR("%s: out of memory", key->name);
-                break;
-            }
-            strncat(buf, line, length - strlen(buf));
-            break;
-        case VAL_TYPE_LITERAL_STRING:
-            DEBUG("[%d]%s: '%s'", age, key->name, key->value.string_value);
-            strncpy(line, key->name, sizeof(line));
-            strncat(line, " = '", sizeof(line) - strlen(line));
-            strncat(line, key->value.string_value, sizeof(line) - strlen(line));
-            strncat(line, "'\n", sizeof(line) - strlen(line));
-            if (remain < strlen(line)) {
-                ERROR("%s: out of memory", key->name);
-                break;
-            }
-            strncat(buf, line, length - strlen(buf));
+    if ((array == NULL) || (length == NULL) || (array->key.value.type != VAL_TYPE_ARRAY)) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    struct toml_value *value = &array->key.value;
+    if (value->array_length == 0) {
+        *length = 0;
+        return no_elements;
+    }
+    if ((value->array_type != type)
+        && !((type == VAL_TYPE_BASIC_STRING) && (value->array_type == VAL_TYPE_LITERAL_STRING))) {
+
+        errno = EINVAL;
+        return NULL;
+    }
+    *length = value->array_length;
+
+    return value->array_elements;
+}
+
+const int64_t *toml_array_int64(toml_t array, size_t *length)
+{
+    return (const int64_t *)array_packed(array, VAL_TYPE_INTEGER, length);
+}
+
+const double *toml_array_double(toml_t array, size_t *length)
+{
+    return (const double *)array_packed(array, VAL_TYPE_FLOAT, length);
+}
+
+const bool *toml_array_bool(toml_t array, size_t *length)
+{
+    return (const bool *)array_packed(array, VAL_TYPE_BOOLEAN, length);
+}
+
+/**
+ *  The strings have their escape sequences decoded, but are not
+ *  NUL-terminated.
+ */
+const toml_view_t *toml_array_string(toml_t array, size_t *length)
+{
+    return (const toml_view_t *)array_packed(array, VAL_TYPE_BASIC_STRING, length);
+}
+
+const toml_datetime_t *toml_array_datetime(toml_t array, size_t *length)
+{
+    return (const toml_datetime_t *)array_packed(array, VAL_TYPE_DATETIME, length);
+}
+
+static enum toml_value_type toml_type_of(struct toml *object);
+
+static bool is_string_type(enum toml_value_type type)
+{
+    return (type == VAL_TYPE_BASIC_STRING) || (type == VAL_TYPE_LITERAL_STRING);
+}
+
+/**
+ *  Stores a NUL-terminated copy of @c str as the string of @c value,
+ *  in the node itself when it is short enough.
+ */
+static int toml_value_store(struct toml_document *doc, struct toml_value *value,
+                            const char *str, size_t length)
+{
+    char *copied;
+
+    if (length < SMALL_STRING_BYTES) {
+        copied = value->small;
+        memmove(copied, str, length);
+        copied[length] = '\0';
+    } else {
+        copied = toml_strndup(doc, str, length);
+        if (copied == NULL) {
+            return -1;
+        }
+    }
+    value->string_value = copied;
+    value->string_length = length;
+    value->terminated = true;
+
+    return 0;
+}
+
+const char *toml_string_value(toml_t string)
+{
+    if ((string == NULL) || !is_string_type(toml_type_of(string))) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    struct toml_value *value = &string->key.value;
+    if (!value->terminated
+        && (toml_value_store(string->doc, value, value->string_value, value->string_length) != 0)) {
+
+        return NULL;
+    }
+
+    return value->string_value;
+}
+
+/**
+ *  Records that the value of @c object no longer matches the source, so
+ *  that saving rewrites it; see save_source().
+ */
+static int toml_mark_dirty(struct toml *object)
+{
+    struct toml_document *doc = object->doc;
+
+    if (object->key.value.dirty) {
+        return 0;
+    }
+    if (doc->dirty_length == doc->dirty_capacity) {
+        size_t capacity = (doc->dirty_capacity > 0) ? (doc->dirty_capacity * 2) : NODES_INITIAL_CAPACITY;
+        struct toml **dirty = realloc(doc->dirty, capacity * sizeof(*dirty));
+        if (dirty == NULL) {
+            return -1;
+        }
+        doc->dirty = dirty;
+        doc->dirty_capacity = capacity;
+    }
+    doc->dirty[doc->dirty_length++] = object;
+    object->key.value.dirty = true;
+
+    return 0;
+}
+
+/**
+ *  Writes the string of the unpacked element @c string through to its
+ *  slot in the packed array, so that toml_array_string() sees it too.
+ *  Packed views are always in memory owned by the document.
+ */
+static void packed_string_update(struct toml *string)
+{
+    NTREE_NODE parent = ntree_parent(string->node);
+    struct toml *array = (parent != NULL) ? (struct toml *)ntree_data(parent) : NULL;
+
+    if ((array == NULL) || (array->key.value.type != VAL_TYPE_ARRAY)
+        || !is_string_type(array->key.value.array_type)) {
+
+        return;
+    }
+
+    toml_view_t *views = (toml_view_t *)array->key.value.array_elements;
+    size_t i = 0;
+    for (ITER iter = ntree_children_iter(array->node); !iter_is_end(iter); iter = iter_next(iter), ++i) {
+        if (iter_data(iter) == string) {
+            views[i] = (toml_view_t){.ptr = string->key.value.string_value,
+                                     .length = string->key.value.string_length};
+            iter_release(iter);
             break;
-        default:
-            ERROR("[%d]%s: unknown value", age, key->name);
+        }
+    }
+}
+
+int toml_string_set(toml_t string, const char *value)
+{
+    if ((string == NULL) || (value == NULL) || !is_string_type(toml_type_of(string))) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (toml_mark_dirty(string) != 0) {
+        return -1;
+    }
+    if (toml_value_store(string->doc, &string->key.value, value, strlen(value)) != 0) {
+        return -1;
+    }
+    packed_string_update(string);
+
+    return 0;
+}
+
+int toml_integer_value(toml_t integer, int64_t *value)
+{
+    if ((integer == NULL) || (value == NULL) || (toml_type_of(integer) != VAL_TYPE_INTEGER)) {
+        errno = EINVAL;
+        return -1;
+    }
+    *value = integer->key.value.integer_value;
+
+    return 0;
+}
+
+int toml_float_value(toml_t number, double *value)
+{
+    if ((number == NULL) || (value == NULL) || (toml_type_of(number) != VAL_TYPE_FLOAT)) {
+        errno = EINVAL;
+        return -1;
+    }
+    *value = number->key.value.float_value;
+
+    return 0;
+}
+
+int toml_boolean_value(toml_t boolean, bool *value)
+{
+    if ((boolean == NULL) || (value == NULL) || (toml_type_of(boolean) != VAL_TYPE_BOOLEAN)) {
+        errno = EINVAL;
+        return -1;
+    }
+    *value = boolean->key.value.boolean_value;
+
+    return 0;
+}
+
+int toml_datetime_value(toml_t datetime, toml_datetime_t *value)
+{
+    if ((datetime == NULL) || (value == NULL) || (toml_type_of(datetime) != VAL_TYPE_DATETIME)) {
+        errno = EINVAL;
+        return -1;
+    }
+    *value = datetime->key.value.datetime_value;
+
+    return 0;
+}
+
+static int parse_tree(struct tree_builder *builder, const char *buf, size_t length, struct parse_state *state);
+static toml_t cache_load(const char *pathname, const char *source, const struct stat *st);
+static void cache_store(toml_t object, const char *pathname, const char *source, const struct stat *st);
+
+toml_t toml_load_ex(const char *pathname, int flags)
+{
+    struct stat st;
+    const char *source = NULL;
+    int fd;
+
+    fd = open(pathname, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        return NULL;
+    }
+    if (fstat(fd, &st) == -1) {
+        close(fd);
+        return NULL;
+    }
+    if (st.st_size > 0) {
+        source = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (source == MAP_FAILED) {
+            close(fd);
+            return NULL;
+        }
+        posix_madvise((void *)source, st.st_size, POSIX_MADV_SEQUENTIAL);
+    }
+    close(fd);
+
+    if (flags & TOML_LOAD_CACHE) {
+        toml_t cached = cache_load(pathname, source, &st);
+        if (cached != NULL) {
+            if (source != NULL) {
+                munmap((void *)source, st.st_size);
+            }
+            return cached;
+        }
+    }
+
+    toml_t obj = toml_alloc();
+    if (obj == NULL) {
+        if (source != NULL) {
+            munmap((void *)source, st.st_size);
+        }
+        return NULL;
+    }
+    obj->doc->source = source;
+    obj->doc->source_length = st.st_size;
+    obj->doc->mapped = (source != NULL);
+    obj->doc->flags = flags;
+
+    struct tree_builder builder = TREE_BUILDER_INITIALIZER(obj);
+    struct parse_state state = PARSE_STATE_INITIALIZER;
+    if (parse_tree(&builder, source, st.st_size, &state) != 0) {
+        toml_free(obj);
+        errno = EINVAL;
+        return NULL;
+    }
+    if (flags & TOML_LOAD_CACHE) {
+        cache_store(obj, pathname, source, &st);
+    }
+
+    return obj;
+}
+
+static bool is_end_of_expr(const struct token *token)
+{
+    return (token->type == TOKEN_NEWLINE)
+           || (token->type == TOKEN_COMMENT)
+           || (token->type == TOKEN_EOF);
+}
+
+/**
+ *  A value decoded from its token, ready to be reported.
+ */
+struct scalar {
+    enum toml_value_type type;
+    union {
+        toml_view_t string;
+        int64_t integer;
+        double floating;
+        bool boolean;
+        toml_datetime_t datetime;
+    };
+};
+
+/**
+ *  Kinds of bare values, told apart by their first byte.
+ */
+enum value_class {
+    VALUE_INVALID,
+    VALUE_DIGIT,   /**< integer, float, date or time. */
+    VALUE_SIGN,    /**< signed integer or float. */
+    VALUE_SPECIAL, /**< inf or nan. */
+    VALUE_BOOLEAN,
+};
+
+static const uint8_t value_class[256] = {
+    ['0' ... '9'] = VALUE_DIGIT,
+    ['+'] = VALUE_SIGN,
+    ['-'] = VALUE_SIGN,
+    ['i'] = VALUE_SPECIAL,
+    ['n'] = VALUE_SPECIAL,
+    ['t'] = VALUE_BOOLEAN,
+    ['f'] = VALUE_BOOLEAN,
+};
+
+/**
+ *  Decodes the value at @c token. A bare value goes by its first byte
+ *  to the parsers of the kinds it may be, in the order they are tried.
+ *
+ *  @return 0 on success, -1 with errno set if it is not a valid value.
+ */
+static int scalar_decode(const struct token *token, struct scalar *scalar)
+{
+    switch (token->type) {
+    case TOKEN_BASIC_STRING:
+    case TOKEN_LITERAL_STRING:
+        scalar->type = (token->type == TOKEN_LITERAL_STRING) ? VAL_TYPE_LITERAL_STRING : VAL_TYPE_BASIC_STRING;
+        scalar->string = (toml_view_t){.ptr = token->head, .length = token->length};
+        return 0;
+    case TOKEN_VALUE:
+        break;
+    default:
+        errno = EINVAL;
+        return -1;
+    }
+
+    switch (value_class[(uint8_t)*token->head]) {
+    case VALUE_DIGIT:
+        if (datetime_like(token->head, token->length)) {
+            if (datetime_parse(token->head, token->length, &scalar->datetime) != 0) {
+                return -1;
+            }
+            scalar->type = VAL_TYPE_DATETIME;
+            return 0;
+        }
+        /* fall through */
+    case VALUE_SIGN:
+        if (number_parse_integer(token->head, token->length, &scalar->integer) == 0) {
+            scalar->type = VAL_TYPE_INTEGER;
+            return 0;
+        }
+        if (errno != EINVAL) {
+            return -1;
+        }
+        /* fall through */
+    case VALUE_SPECIAL:
+        if (number_parse_float(token->head, token->length, &scalar->floating) != 0) {
+            return -1;
+        }
+        scalar->type = VAL_TYPE_FLOAT;
+        return 0;
+    case VALUE_BOOLEAN:
+        if ((token->length == 4) && (memcmp(token->head, "true", 4) == 0)) {
+            scalar->boolean = true;
+        } else if ((token->length == 5) && (memcmp(token->head, "false", 5) == 0)) {
+            scalar->boolean = false;
+        } else {
+            errno = EINVAL;
+            return -1;
+        }
+        scalar->type = VAL_TYPE_BOOLEAN;
+        return 0;
+    default:
+        errno = EINVAL;
+        return -1;
+    }
+}
+
+/**
+ *  The value as written, quotes included.
+ */
+static toml_view_t token_span(const struct token *token)
+{
+    return (toml_view_t){
+        .ptr = token->head - token->opening,
+        .length = token->opening + token->length + token->closing,
+    };
+}
+
+static int emit_scalar(const struct toml_callbacks *callbacks, void *ctx, const struct scalar *scalar)
+{
+    switch (scalar->type) {
+    case VAL_TYPE_BASIC_STRING:
+    case VAL_TYPE_LITERAL_STRING:
+        if (callbacks->string == NULL) {
+            return 0;
+        }
+        return callbacks->string(ctx, scalar->string, (scalar->type == VAL_TYPE_LITERAL_STRING));
+    case VAL_TYPE_INTEGER:
+        if (callbacks->integer == NULL) {
+            return 0;
+        }
+        return callbacks->integer(ctx, scalar->integer);
+    case VAL_TYPE_FLOAT:
+        if (callbacks->floating == NULL) {
+            return 0;
+        }
+        return callbacks->floating(ctx, scalar->floating);
+    case VAL_TYPE_BOOLEAN:
+        if (callbacks->boolean == NULL) {
+            return 0;
+        }
+        return callbacks->boolean(ctx, scalar->boolean);
+    case VAL_TYPE_DATETIME:
+        if (callbacks->datetime == NULL) {
+            return 0;
+        }
+        return callbacks->datetime(ctx, &scalar->datetime);
+    default:
+        return -1;
+    }
+}
+
+/**
+ *  Reads the dotted key starting at @c token into @c keys, leaving
+ *  @c token at the token after it.
+ *
+ *  @return 0 on success, 1 if the input ended first, -1 on error.
+ */
+static int parse_keys(struct lexer *lexer, struct token *token, toml_view_t *keys, size_t *depth)
+{
+    for (;;) {
+        if (*depth == KEY_DEPTH_MAX) {
+            LEXER_ERROR(lexer, "too deep key");
+            errno = EINVAL;
+            return -1;
+        }
+        keys[(*depth)++] = (toml_view_t){.ptr = token->head, .length = token->length};
+        lexer_next(lexer, token);
+        if (token->type != TOKEN_DOT) {
             break;
         }
+        lexer_next(lexer, token);
+        if (token->type == TOKEN_INCOMPLETE) {
+            return 1;
+        }
+        if (!is_key_token(token)) {
+            LEXER_ERROR(lexer, "invalid key");
+            errno = EINVAL;
+            return -1;
+        }
+    }
+
+    return (token->type == TOKEN_INCOMPLETE) ? 1 : 0;
+}
+
+static int emit_event(int (*event)(void *ctx), void *ctx)
+{
+    if ((event != NULL) && (event(ctx) != 0)) {
+        errno = ECANCELED;
+        return -1;
+    }
+
+    return 0;
+}
+
+static int parse_value(const struct toml_callbacks *callbacks, void *ctx,
+                       struct lexer *lexer, struct token *token, size_t depth);
+
+/**
+ *  Reads the next token inside an array, where newlines and comments
+ *  may appear between the elements.
+ *
+ *  @return 0 on success, 1 if the input ended first, -1 on error.
+ */
+static int array_next(struct lexer *lexer, struct token *token)
+{
+    do {
+        lexer->mode = LEXER_VALUE;
+        lexer_next(lexer, token);
+    } while ((token->type == TOKEN_NEWLINE) || (token->type == TOKEN_COMMENT));
+
+    if (token->type == TOKEN_INCOMPLETE) {
+        return 1;
+    }
+    if (token->type == TOKEN_EOF) {
+        LEXER_ERROR(lexer, "expected ']'");
+        errno = EINVAL;
+        return -1;
     }
 
     return 0;
 }
+
+/**
+ *  Parses the array whose '[' is at @c token; a comma may follow the
+ *  last element.
+ *
+ *  @return 0 on success, 1 if the input ended first, -1 on error.
+ */
+static int parse_array(const struct toml_callbacks *callbacks, void *ctx,
+                       struct lexer *lexer, struct token *token, size_t depth)
+{
+    int ret;
+
+    if (emit_event(callbacks->array_begin, ctx) != 0) {
+        return -1;
+    }
+    for (;;) {
+        ret = array_next(lexer, token);
+        if (ret != 0) {
+            return ret;
+        }
+        if (token->type == TOKEN_ARRAY_CLOSE) {
+            break;
+        }
+        ret = parse_value(callbacks, ctx, lexer, token, depth + 1);
+        if (ret != 0) {
+            return ret;
+        }
+        ret = array_next(lexer, token);
+        if (ret != 0) {
+            return ret;
+        }
+        if (token->type == TOKEN_ARRAY_CLOSE) {
+            break;
+        }
+        if (token->type != TOKEN_COMMA) {
+            LEXER_ERROR(lexer, "expected ',' or ']'");
+            errno = EINVAL;
+            return -1;
+        }
+    }
+
+    return emit_event(callbacks->array_end, ctx);
+}
+
+/**
+ *  Parses the inline table whose '{' is at @c token. Inline tables are
+ *  written on one line, without a comma after the last key/value.
+ *
+ *  @return 0 on success, 1 if the input ended first, -1 on error.
+ */
+static int parse_inline_table(const struct toml_callbacks *callbacks, void *ctx,
+                              struct lexer *lexer, struct token *token, size_t depth)
+{
+    toml_view_t keys[KEY_DEPTH_MAX];
+    struct token value;
+    int ret;
+
+    if (emit_event(callbacks->inline_table_begin, ctx) != 0) {
+        return -1;
+    }
+    lexer_next(lexer, token);
+    if (token->type != TOKEN_INLINE_TABLE_CLOSE) {
+        for (;;) {
+            size_t key_depth = 0;
+
+            if (token->type == TOKEN_INCOMPLETE) {
+                return 1;
+            }
+            if (!is_key_token(token)) {
+                LEXER_ERROR(lexer, "invalid key");
+                errno = EINVAL;
+                return -1;
+            }
+            ret = parse_keys(lexer, token, keys, &key_depth);
+            if (ret != 0) {
+                return ret;
+            }
+            if (token->type != TOKEN_EQUAL) {
+                LEXER_ERROR(lexer, "expected '='");
+                errno = EINVAL;
+                return -1;
+            }
+            if ((callbacks->key != NULL) && (callbacks->key(ctx, keys, key_depth) != 0)) {
+                errno = ECANCELED;
+                return -1;
+            }
+            lexer_next(lexer, &value);
+            ret = parse_value(callbacks, ctx, lexer, &value, depth + 1);
+            if (ret != 0) {
+                return ret;
+            }
+
+            lexer->mode = LEXER_KEY;
+            lexer_next(lexer, token);
+            if (token->type == TOKEN_INCOMPLETE) {
+                return 1;
+            }
+            if (token->type == TOKEN_INLINE_TABLE_CLOSE) {
+                break;
+            }
+            if (token->type != TOKEN_COMMA) {
+                LEXER_ERROR(lexer, "expected ',' or '}'");
+                errno = EINVAL;
+                return -1;
+            }
+            lexer_next(lexer, token);
+        }
+    }
+
+    return emit_event(callbacks->inline_table_end, ctx);
+}
+
+/**
+ *  Parses and reports the value at @c token, nested @c depth deep in
+ *  arrays and inline tables.
+ *
+ *  @return 0 on success, 1 if the input ended first, -1 on error.
+ */
+static int parse_value(const struct toml_callbacks *callbacks, void *ctx,
+                       struct lexer *lexer, struct token *token, size_t depth)
+{
+    struct scalar scalar;
+    int ret;
+
+    switch (token->type) {
+    case TOKEN_INCOMPLETE:
+        return 1;
+    case TOKEN_ARRAY_OPEN:
+    case TOKEN_INLINE_TABLE_OPEN:
+        if (depth == VALUE_DEPTH_MAX) {
+            LEXER_ERROR(lexer, "too deep value");
+            errno = EINVAL;
+            return -1;
+        }
+        if (token->type == TOKEN_ARRAY_OPEN) {
+            return parse_array(callbacks, ctx, lexer, token, depth);
+        }
+        return parse_inline_table(callbacks, ctx, lexer, token, depth);
+    default:
+        break;
+    }
+
+    if (callbacks->raw != NULL) {
+        ret = callbacks->raw(ctx, token_span(token));
+    } else if (scalar_decode(token, &scalar) == 0) {
+        ret = emit_scalar(callbacks, ctx, &scalar);
+    } else {
+        LEXER_ERROR(lexer, "%.*s: %s", (int)token->length, token->head,
+                    (errno == ERANGE) ? "out of range" : "unknown or unsuppoted value");
+        errno = EINVAL;
+        return -1;
+    }
+    if (ret != 0) {
+        errno = ECANCELED;
+        return -1;
+    }
+
+    return 0;
+}
+
+static int skip_raw(void *ctx, toml_view_t value)
+{
+    (void)ctx;
+    (void)value;
+
+    return 0;
+}
+
+/**
+ *  Reads values through without decoding or reporting them.
+ */
+static const struct toml_callbacks skip_callbacks = {
+    .raw = skip_raw,
+};
+
+/**
+ *  Parses a key/value statement whose value is an array or inline table,
+ *  reporting events as the value is read. With partial input the whole
+ *  statement is read through first, so that one cut off by the end of
+ *  the input reports nothing.
+ *
+ *  @return 0 on success, 1 if the input ended first, -1 on error.
+ */
+static int parse_expr_nested(const struct toml_callbacks *callbacks, void *ctx,
+                             struct lexer *lexer, struct token *token,
+                             const toml_view_t *keys, size_t depth, struct token *value)
+{
+    int ret;
+
+    if (lexer->partial) {
+        const char *cur = lexer->cur;
+        size_t line = lexer->line;
+        enum lexer_mode mode = lexer->mode;
+        struct token first = *value;
+
+        ret = parse_value(&skip_callbacks, NULL, lexer, &first, 0);
+        if (ret == 0) {
+            lexer_next(lexer, token);
+            ret = (token->type == TOKEN_INCOMPLETE) ? 1 : 0;
+        }
+        if (ret != 0) {
+            return ret;
+        }
+        lexer->cur = cur;
+        lexer->line = line;
+        lexer->mode = mode;
+    }
+
+    if ((callbacks->key != NULL) && (callbacks->key(ctx, keys, depth) != 0)) {
+        errno = ECANCELED;
+        return -1;
+    }
+    ret = parse_value(callbacks, ctx, lexer, value, 0);
+    if (ret != 0) {
+        return ret;
+    }
+    lexer_next(lexer, token);
+    if (!is_end_of_expr(token)) {
+        LEXER_ERROR(lexer, "expected newline");
+        errno = EINVAL;
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ *  Parses a key/value statement starting at @c token.
+ *  The whole statement is read before any event is reported, so that a
+ *  statement cut off by the end of partial input can be retried later.
+ *
+ *  @return 0 on success, 1 if the input ended first, -1 on error.
+ */
+static int parse_expr(const struct toml_callbacks *callbacks, void *ctx,
+                      struct lexer *lexer, struct token *token)
+{
+    toml_view_t keys[KEY_DEPTH_MAX];
+    struct token value;
+    struct scalar scalar = {.type = VAL_TYPE_NONE};
+    size_t depth = 0;
+    int ret;
+
+    ret = parse_keys(lexer, token, keys, &depth);
+    if (ret != 0) {
+        return ret;
+    }
+    if (token->type != TOKEN_EQUAL) {
+        LEXER_ERROR(lexer, "expected '='");
+        errno = EINVAL;
+        return -1;
+    }
+
+    lexer_next(lexer, &value);
+    if (value.type == TOKEN_INCOMPLETE) {
+        return 1;
+    }
+    if ((value.type == TOKEN_ARRAY_OPEN) || (value.type == TOKEN_INLINE_TABLE_OPEN)) {
+        return parse_expr_nested(callbacks, ctx, lexer, token, keys, depth, &value);
+    }
+    if ((callbacks->raw == NULL) && (scalar_decode(&value, &scalar) != 0)) {
+        LEXER_ERROR(lexer, "%.*s: %s", (int)value.length, value.head,
+                    (errno == ERANGE) ? "out of range" : "unknown or unsuppoted value");
+        errno = EINVAL;
+        return -1;
+    }
+    lexer_next(lexer, token);
+    if (token->type == TOKEN_INCOMPLETE) {
+        return 1;
+    }
+    if (!is_end_of_expr(token)) {
+        LEXER_ERROR(lexer, "expected newline");
+        errno = EINVAL;
+        return -1;
+    }
+
+    if ((callbacks->key != NULL) && (callbacks->key(ctx, keys, depth) != 0)) {
+        errno = ECANCELED;
+        return -1;
+    }
+    ret = (callbacks->raw != NULL) ? callbacks->raw(ctx, token_span(&value)) : emit_scalar(callbacks, ctx, &scalar);
+    if (ret != 0) {
+
+        errno = ECANCELED;
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ *  Parses a [table] or [[array of tables]] header starting at @c token.
+ *
+ *  @return 0 on success, 1 if the input ended first, -1 on error.
+ */
+static int parse_table(const struct toml_callbacks *callbacks, void *ctx,
+                       struct lexer *lexer, struct token *token)
+{
+    bool array = (token->type == TOKEN_ARRAY_TABLE_OPEN);
+    toml_view_t keys[KEY_DEPTH_MAX];
+    size_t depth = 0;
+    int ret;
+
+    lexer_next(lexer, token);
+    if (token->type == TOKEN_INCOMPLETE) {
+        return 1;
+    }
+    if (!is_key_token(token)) {
+        LEXER_ERROR(lexer, "invalid key");
+        errno = EINVAL;
+        return -1;
+    }
+    ret = parse_keys(lexer, token, keys, &depth);
+    if (ret != 0) {
+        return ret;
+    }
+    if (token->type != (array ? TOKEN_ARRAY_TABLE_CLOSE : TOKEN_TABLE_CLOSE)) {
+        LEXER_ERROR(lexer, "expected '%s'", array ? "]]" : "]");
+        errno = EINVAL;
+        return -1;
+    }
+    lexer_next(lexer, token);
+    if (token->type == TOKEN_INCOMPLETE) {
+        return 1;
+    }
+    if (!is_end_of_expr(token)) {
+        LEXER_ERROR(lexer, "expected newline");
+        errno = EINVAL;
+        return -1;
+    }
+
+    int (*header)(void *, const toml_view_t *, size_t) = array ? callbacks->array_table : callbacks->table;
+    if ((header != NULL) && (header(ctx, keys, depth) != 0)) {
+        errno = ECANCELED;
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ *  Parses the statements in @c buf, reporting them to @c callbacks.
+ *
+ *  With @c state->partial, more input may follow @c buf: parsing stops
+ *  before a statement that runs past the end, and @c state->consumed
+ *  tells where it starts.
+ */
+static int parse_document(const struct toml_callbacks *callbacks, void *ctx,
+                          const char *buf, size_t length, struct parse_state *state)
+{
+    struct lexer lexer;
+    struct token token;
+
+    lexer_init(&lexer, buf, length);
+    lexer.line = state->line;
+    lexer.partial = state->partial;
+    lexer.quiet = state->quiet;
+    for (;;) {
+        const char *mark = lexer.cur;
+        size_t mark_line = lexer.line;
+        int ret = 0;
+
+        lexer_next(&lexer, &token);
+        if (is_key_token(&token)) {
+            ret = parse_expr(callbacks, ctx, &lexer, &token);
+        } else if ((token.type == TOKEN_TABLE_OPEN) || (token.type == TOKEN_ARRAY_TABLE_OPEN)) {
+            ret = parse_table(callbacks, ctx, &lexer, &token);
+        }
+        if (ret < 0) {
+            return -1;
+        }
+        if ((ret > 0) || (token.type == TOKEN_INCOMPLETE)) {
+            state->consumed = mark - buf;
+            state->line = mark_line;
+            state->stopped = lexer.cur - buf;
+            state->nesting = lexer.nesting;
+            return 0;
+        }
+        switch (token.type) {
+        case TOKEN_EOF:
+            state->consumed = length;
+            state->line = lexer.line;
+            return 0;
+        case TOKEN_NEWLINE:
+        case TOKEN_COMMENT:
+            break;
+        default:
+            LEXER_ERROR(&lexer, "syntax error");
+            errno = EINVAL;
+            return -1;
+        }
+    }
+}
+
+int toml_parse_events(const char *buf, size_t length, const struct toml_callbacks *callbacks, void *ctx)
+{
+    struct parse_state state = PARSE_STATE_INITIALIZER;
+
+    if (((buf == NULL) && (length > 0)) || (callbacks == NULL)) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (length > 0) {
+        const char *nul = memchr(buf, '\0', length);
+        if (nul != NULL) {
+            length = nul - buf;
+        }
+    }
+
+    return parse_document(callbacks, ctx, buf, length, &state);
+}
+
+/**
+ *  Index of the tables opened by headers, from their full path to their
+ *  node, so that reopening a table costs one probe however deep it is.
+ *  Tables inside arrays of tables are left out: their path names the
+ *  last element only until the array grows.
+ */
+struct toml_table_slot {
+    uint32_t hash;
+    uint32_t depth;
+    struct toml *table;
+};
+
+struct toml_tables {
+    size_t capacity; /**< power of two. */
+    size_t count;
+    struct toml_table_slot slots[];
+};
+
+static uint32_t path_hash_step(uint32_t hash, toml_view_t segment)
+{
+    for (size_t i = 0; i < segment.length; ++i) {
+        hash ^= (uint8_t)segment.ptr[i];
+        hash *= 16777619u;
+    }
+    /* mark the boundary, so that a.b differs from "a.b". */
+    hash ^= (uint32_t)segment.length;
+    hash *= 16777619u;
+
+    return hash;
+}
+
+static uint32_t path_hash(const toml_view_t *path, size_t depth)
+{
+    uint32_t hash = 2166136261u;
+
+    for (size_t i = 0; i < depth; ++i) {
+        hash = path_hash_step(hash, path[i]);
+    }
+
+    return hash;
+}
+
+/**
+ *  Tells whether @c table is at @c path, walking up to the root.
+ */
+static bool table_path_is(struct toml *table, const toml_view_t *path, size_t depth)
+{
+    struct toml *node = table;
+
+    for (size_t i = depth; i > 0; --i) {
+        if ((node == NULL)
+            || (node->key.name_length != path[i - 1].length)
+            || (memcmp(node->key.name, path[i - 1].ptr, path[i - 1].length) != 0)) {
+
+            return false;
+        }
+        node = (struct toml *)ntree_data(ntree_parent(node->node));
+    }
+
+    return node == table->doc->root;
+}
+
+static struct toml *tables_find(struct toml_document *doc, const toml_view_t *path, size_t depth, uint32_t hash)
+{
+    struct toml_tables *tables = doc->tables;
+
+    if (tables == NULL) {
+        return NULL;
+    }
+
+    size_t mask = tables->capacity - 1;
+    for (size_t i = hash & mask; tables->slots[i].table != NULL; i = (i + 1) & mask) {
+        const struct toml_table_slot *slot = &tables->slots[i];
+        if ((slot->hash == hash) && (slot->depth == depth) && table_path_is(slot->table, path, depth)) {
+            return slot->table;
+        }
+    }
+
+    return NULL;
+}
+
+static void tables_insert(struct toml_tables *tables, const struct toml_table_slot *slot)
+{
+    size_t mask = tables->capacity - 1;
+    size_t i;
+
+    for (i = slot->hash & mask; tables->slots[i].table != NULL; i = (i + 1) & mask) {
+        /* probe. */
+    }
+    tables->slots[i] = *slot;
+    ++tables->count;
+}
+
+/**
+ *  Adds @c table, growing the index when it is half full.
+ *  Old tables are left to the document, which releases them together.
+ */
+static int tables_put(struct toml_document *doc, struct toml *table, size_t depth, uint32_t hash)
+{
+    struct toml_tables *tables = doc->tables;
+
+    if ((tables == NULL) || (((tables->count + 1) * 2) > tables->capacity)) {
+        size_t capacity = (tables != NULL) ? (tables->capacity * 2) : INDEX_MIN_CAPACITY;
+        size_t bytes = sizeof(*tables) + (capacity * sizeof(tables->slots[0]));
+        struct toml_tables *grown = (struct toml_tables *)toml_block_alloc(doc, bytes);
+        if (grown == NULL) {
+            return -1;
+        }
+        memset(grown, 0, bytes);
+        grown->capacity = capacity;
+        for (size_t i = 0; (tables != NULL) && (i < tables->capacity); ++i) {
+            if (tables->slots[i].table != NULL) {
+                tables_insert(grown, &tables->slots[i]);
+            }
+        }
+        doc->tables = tables = grown;
+    }
+    tables_insert(tables, &(struct toml_table_slot){.hash = hash, .depth = depth, .table = table});
+
+    return 0;
+}
+
+/**
+ *  Decodes the escape sequences of the quoted keys of @c path into the
+ *  document, so that keys are stored and compared by the names they
+ *  stand for. Bare keys cannot contain a backslash, so a key that does
+ *  is right after its opening quote.
+ */
+static int key_path_decode(struct toml_document *doc, const toml_view_t *path, size_t depth, toml_view_t *names)
+{
+    for (size_t i = 0; i < depth; ++i) {
+        names[i] = path[i];
+        if ((memchr(path[i].ptr, '\\', path[i].length) == NULL) || (path[i].ptr[-1] != '"')) {
+            continue;
+        }
+        char *decoded = toml_arena_alloc(doc, path[i].length + 1);
+        if (decoded == NULL) {
+            return -1;
+        }
+        if (escape_decode(path[i].ptr, path[i].length, decoded, &names[i].length) != 0) {
+            ERROR("%.*s: invalid escape sequence", (int)path[i].length, path[i].ptr);
+            return -1;
+        }
+        decoded[names[i].length] = '\0';
+        names[i].ptr = decoded;
+    }
+
+    return 0;
+}
+
+/**
+ *  The table a header path goes through at @c node: the node itself, or
+ *  the last element of an array of tables.
+ *
+ *  @return table, or NULL if @c node is not a table.
+ */
+static struct toml *table_enter(struct toml *node, bool *indexable)
+{
+    struct toml_value *value = &node->key.value;
+
+    if (value->type == VAL_TYPE_OBJECT) {
+        /* inline tables cannot be extended. */
+        return ((value->table_flags & TABLE_INLINE) == 0) ? node : NULL;
+    }
+    if ((value->type == VAL_TYPE_ARRAY) && ((value->table_flags & TABLE_ARRAY) != 0)) {
+        *indexable = false;
+        return (struct toml *)ntree_data(ntree_last_child(node->node));
+    }
+
+    return NULL;
+}
+
+/**
+ *  Opens the table at @c path for the keys that follow, or appends a
+ *  table to the array of tables there. Tables on the way are created
+ *  as needed.
+ */
+static int tree_header(struct tree_builder *builder, const toml_view_t *path, size_t depth, bool array)
+{
+    struct toml_document *doc = builder->obj->doc;
+    toml_view_t names[KEY_DEPTH_MAX];
+
+    if (key_path_decode(doc, path, depth, names) != 0) {
+        return -1;
+    }
+    path = names;
+
+    const toml_view_t *last = &path[depth - 1];
+    uint32_t parent_hash = path_hash(path, depth - 1);
+    uint32_t hash = path_hash_step(parent_hash, *last);
+    bool indexable = true;
+    struct toml object;
+
+    struct toml *table = tables_find(doc, path, depth, hash);
+    bool indexed = (table != NULL);
+    if (!indexed) {
+        struct toml *parent = doc->root;
+        size_t i = 0;
+
+        /* the parent is often a table opened before. */
+        struct toml *found = (depth > 1) ? tables_find(doc, path, depth - 1, parent_hash) : NULL;
+        if (found != NULL) {
+            parent = table_enter(found, &indexable);
+            i = depth - 1;
+        }
+        for (; i < (depth - 1); ++i) {
+            struct toml *child = object_find(parent, path[i].ptr, path[i].length,
+                                             key_hash(path[i].ptr, path[i].length));
+            if (child == NULL) {
+                object = TOML_INITIALIZER;
+                object.key.name = path[i].ptr;
+                object.key.name_length = path[i].length;
+                object.key.value.type = VAL_TYPE_OBJECT;
+                object.key.value.table_flags = TABLE_IMPLICIT;
+                child = toml_insert(doc, parent, &object);
+                if (child == NULL) {
+                    return -1;
+                }
+            }
+            parent = table_enter(child, &indexable);
+            if (parent == NULL) {
+                ERROR("%.*s: not a table", (int)path[i].length, path[i].ptr);
+                return -1;
+            }
+        }
+        table = object_find(parent, last->ptr, last->length, key_hash(last->ptr, last->length));
+        if (table == NULL) {
+            object = TOML_INITIALIZER;
+            object.key.name = last->ptr;
+            object.key.name_length = last->length;
+            if (array) {
+                object.key.value.type = VAL_TYPE_ARRAY;
+                object.key.value.table_flags = TABLE_ARRAY;
+            } else {
+                object.key.value.type = VAL_TYPE_OBJECT;
+                object.key.value.table_flags = TABLE_HEADER;
+            }
+            table = toml_insert(doc, parent, &object);
+            if (table == NULL) {
+                return -1;
+            }
+        } else if (!array && (table->key.value.type == VAL_TYPE_OBJECT)
+                   && (table->key.value.table_flags == TABLE_IMPLICIT)) {
+            table->key.value.table_flags = TABLE_HEADER;
+        } else if (!array || (table->key.value.type != VAL_TYPE_ARRAY)
+                   || ((table->key.value.table_flags & TABLE_ARRAY) == 0)) {
+            ERROR("%.*s: duplicate table", (int)last->length, last->ptr);
+            return -1;
+        }
+        if (indexable && (tables_put(doc, table, depth, hash) != 0)) {
+            return -1;
+        }
+    } else if (!array || (table->key.value.type != VAL_TYPE_ARRAY)) {
+        /* tables in the index were defined by a header already. */
+        ERROR("%.*s: duplicate table", (int)last->length, last->ptr);
+        return -1;
+    }
+
+    if (array) {
+        /* the element is the last child, appended in constant time. */
+        object = TOML_INITIALIZER;
+        object.key.value.type = VAL_TYPE_OBJECT;
+        object.key.value.table_flags = TABLE_HEADER;
+        struct toml *element = toml_insert(doc, table, &object);
+        if (element == NULL) {
+            return -1;
+        }
+        ++table->key.value.array_length;
+        table = element;
+    }
+    builder->table = table;
+
+    return 0;
+}
+
+static int tree_table(void *ctx, const toml_view_t *path, size_t depth)
+{
+    return tree_header((struct tree_builder *)ctx, path, depth, false);
+}
+
+static int tree_array_table(void *ctx, const toml_view_t *path, size_t depth)
+{
+    return tree_header((struct tree_builder *)ctx, path, depth, true);
+}
+
+/**
+ *  Finds or creates the tables along @c path, relative to the current
+ *  table, and adds its last key, so that dotted keys sharing a prefix
+ *  share its tables. Only tables defined by dotted keys can be extended
+ *  this way.
+ */
+static int tree_key(void *ctx, const toml_view_t *path, size_t depth)
+{
+    struct tree_builder *builder = (struct tree_builder *)ctx;
+    struct toml_document *doc = builder->obj->doc;
+    struct toml *parent = builder->table;
+    toml_view_t names[KEY_DEPTH_MAX];
+    struct toml object;
+
+    if (key_path_decode(doc, path, depth, names) != 0) {
+        return -1;
+    }
+    path = names;
+    for (size_t i = 0; i < depth; ++i) {
+        struct toml *child = object_find(parent, path[i].ptr, path[i].length,
+                                         key_hash(path[i].ptr, path[i].length));
+        if (child != NULL) {
+            if ((i == (depth - 1)) || (child->key.value.type != VAL_TYPE_OBJECT)
+                || (child->key.value.table_flags != TABLE_DOTTED)) {
+
+                ERROR("%.*s: duplicate key", (int)path[i].length, path[i].ptr);
+                return -1;
+            }
+            parent = child;
+            continue;
+        }
+
+        object = TOML_INITIALIZER;
+        object.key.name = path[i].ptr;
+        object.key.name_length = path[i].length;
+        if (i < (depth - 1)) {
+            object.key.value.type = VAL_TYPE_OBJECT;
+            object.key.value.table_flags = TABLE_DOTTED;
+        }
+        parent = toml_insert(doc, parent, &object);
+        if (parent == NULL) {
+            return -1;
+        }
+    }
+    builder->object = parent;
+
+    return 0;
+}
+
+static bool tree_in_array(const struct tree_builder *builder)
+{
+    return (builder->depth > 0) && (builder->frames[builder->depth - 1].node->key.value.type == VAL_TYPE_ARRAY);
+}
+
+/**
+ *  Moves the packed elements of the array of @c frame to nodes, once it
+ *  turns out not to be an array of one scalar type.
+ */
+static int tree_unpack(struct tree_builder *builder, struct tree_frame *frame)
+{
+    struct toml_document *doc = builder->obj->doc;
+    struct toml_value *array = &frame->node->key.value;
+
+    if (packed_unpack(frame->node, array->array_type, doc->scratch, array->array_length) != 0) {
+        return -1;
+    }
+    doc->scratch_length = 0;
+    array->array_type = VAL_TYPE_NONE;
+    frame->packed = false;
+
+    return 0;
+}
+
+/**
+ *  Adds a node for the next element of the array being built.
+ */
+static struct toml *tree_element(struct tree_builder *builder, const struct toml_value *value)
+{
+    struct tree_frame *frame = &builder->frames[builder->depth - 1];
+    struct toml object = TOML_INITIALIZER;
+
+    if (frame->packed && (tree_unpack(builder, frame) != 0)) {
+        return NULL;
+    }
+    object.key.value = *value;
+    struct toml *element = toml_insert(builder->obj->doc, frame->node, &object);
+    if (element == NULL) {
+        return NULL;
+    }
+    ++frame->node->key.value.array_length;
+
+    return element;
+}
+
+/**
+ *  The type a packed array of @c array_type takes when @c type joins it,
+ *  or VAL_TYPE_NONE if it cannot. Basic and literal strings are all
+ *  strings to the caller; a mix of them is kept as basic strings, which
+ *  can be written back whatever they hold.
+ */
+static enum toml_value_type packed_join(enum toml_value_type array_type, enum toml_value_type type)
+{
+    if (array_type == type) {
+        return type;
+    }
+    if (is_string_type(array_type) && is_string_type(type)) {
+        return VAL_TYPE_BASIC_STRING;
+    }
+
+    return VAL_TYPE_NONE;
+}
+
+/**
+ *  Stores a scalar as the value of the last key, or appends it to the
+ *  array being built. Array elements stay packed in the scratch buffer
+ *  as long as they are all of one type.
+ */
+static int tree_store(struct tree_builder *builder, const struct toml_value *value)
+{
+    if (!tree_in_array(builder)) {
+        builder->object->key.value = *value;
+        return 0;
+    }
+
+    struct toml_document *doc = builder->obj->doc;
+    struct tree_frame *frame = &builder->frames[builder->depth - 1];
+    struct toml_value *array = &frame->node->key.value;
+    enum toml_value_type type = (array->array_length == 0) ? value->type : packed_join(array->array_type, value->type);
+    if (frame->packed && (type != VAL_TYPE_NONE)) {
+        size_t size = packed_size(value->type);
+        toml_view_t view;
+
+        if ((doc->scratch_length + size) > doc->scratch_capacity) {
+            size_t capacity = (doc->scratch_capacity > 0) ? (doc->scratch_capacity * 2) : ARENA_BLOCK_BYTES;
+            char *scratch = realloc(doc->scratch, capacity);
+            if (scratch == NULL) {
+                return -1;
+            }
+            doc->scratch = scratch;
+            doc->scratch_capacity = capacity;
+        }
+        memcpy(doc->scratch + doc->scratch_length, packed_element(value, &view), size);
+        doc->scratch_length += size;
+        array->array_type = type;
+        ++array->array_length;
+        return 0;
+    }
+
+    return (tree_element(builder, value) != NULL) ? 0 : -1;
+}
+
+/**
+ *  Basic strings with escape sequences are decoded into the document;
+ *  other strings stay views into the source.
+ */
+static int tree_string(void *ctx, toml_view_t value, bool literal)
+{
+    struct tree_builder *builder = (struct tree_builder *)ctx;
+    struct toml_value v = TOML_VALUE_INITIALIZER;
+
+    v.type = literal ? VAL_TYPE_LITERAL_STRING : VAL_TYPE_BASIC_STRING;
+    v.string_value = value.ptr;
+    v.string_length = value.length;
+    if (!literal && (memchr(value.ptr, '\\', value.length) != NULL)) {
+        char *decoded = toml_arena_alloc(builder->obj->doc, value.length + 1);
+        if (decoded == NULL) {
+            return -1;
+        }
+        if (escape_decode(value.ptr, value.length, decoded, &v.string_length) != 0) {
+            ERROR("%.*s: invalid escape sequence", (int)value.length, value.ptr);
+            return -1;
+        }
+        decoded[v.string_length] = '\0';
+        v.string_value = decoded;
+        v.terminated = true;
+    }
+
+    return tree_store(builder, &v);
+}
+
+static int tree_integer(void *ctx, int64_t value)
+{
+    struct toml_value v = TOML_VALUE_INITIALIZER;
+
+    v.type = VAL_TYPE_INTEGER;
+    v.integer_value = value;
+
+    return tree_store((struct tree_builder *)ctx, &v);
+}
+
+static int tree_float(void *ctx, double value)
+{
+    struct toml_value v = TOML_VALUE_INITIALIZER;
+
+    v.type = VAL_TYPE_FLOAT;
+    v.float_value = value;
+
+    return tree_store((struct tree_builder *)ctx, &v);
+}
+
+static int tree_boolean(void *ctx, bool value)
+{
+    struct toml_value v = TOML_VALUE_INITIALIZER;
+
+    v.type = VAL_TYPE_BOOLEAN;
+    v.boolean_value = value;
+
+    return tree_store((struct tree_builder *)ctx, &v);
+}
+
+static int tree_datetime(void *ctx, const toml_datetime_t *value)
+{
+    struct toml_value v = TOML_VALUE_INITIALIZER;
+
+    v.type = VAL_TYPE_DATETIME;
+    v.datetime_value = *value;
+
+    return tree_store((struct tree_builder *)ctx, &v);
+}
+
+/**
+ *  Opens an array or inline table as the value of the last key, or as
+ *  the next element of the array being built.
+ */
+static int tree_open(struct tree_builder *builder, const struct toml_value *value)
+{
+    struct toml *node;
+
+    if (builder->depth == VALUE_DEPTH_MAX) {
+        ERROR("too deep value");
+        return -1;
+    }
+    if (tree_in_array(builder)) {
+        node = tree_element(builder, value);
+        if (node == NULL) {
+            return -1;
+        }
+    } else {
+        node = builder->object;
+        node->key.value = *value;
+    }
+    builder->frames[builder->depth++] = (struct tree_frame){
+        .node = node,
+        .table = builder->table,
+        .packed = (value->type == VAL_TYPE_ARRAY),
+    };
+    if (value->type == VAL_TYPE_OBJECT) {
+        builder->table = node;
+    }
+
+    return 0;
+}
+
+/**
+ *  Closes the innermost array or inline table. A packed array gets its
+ *  elements in a single allocation.
+ */
+static int tree_close(struct tree_builder *builder)
+{
+    struct toml_document *doc = builder->obj->doc;
+    struct tree_frame *frame = &builder->frames[--builder->depth];
+    struct toml_value *value = &frame->node->key.value;
+
+    if (frame->packed && (value->array_length > 0)) {
+        void *elements = toml_arena_alloc_aligned(doc, doc->scratch_length);
+        if (elements == NULL) {
+            return -1;
+        }
+        memcpy(elements, doc->scratch, doc->scratch_length);
+        value->array_elements = elements;
+        doc->scratch_length = 0;
+    }
+    builder->table = frame->table;
+    builder->object = frame->node;
+
+    return 0;
+}
+
+static int tree_array_begin(void *ctx)
+{
+    struct toml_value value = TOML_VALUE_INITIALIZER;
+
+    value.type = VAL_TYPE_ARRAY;
+
+    return tree_open((struct tree_builder *)ctx, &value);
+}
+
+static int tree_inline_table_begin(void *ctx)
+{
+    struct toml_value value = TOML_VALUE_INITIALIZER;
+
+    value.type = VAL_TYPE_OBJECT;
+    value.table_flags = TABLE_INLINE;
+
+    return tree_open((struct tree_builder *)ctx, &value);
+}
+
+static int tree_end(void *ctx)
+{
+    return tree_close((struct tree_builder *)ctx);
+}
+
+static const struct toml_callbacks tree_callbacks = {
+    .table = tree_table,
+    .array_table = tree_array_table,
+    .key = tree_key,
+    .string = tree_string,
+    .integer = tree_integer,
+    .floating = tree_float,
+    .boolean = tree_boolean,
+    .datetime = tree_datetime,
+    .array_begin = tree_array_begin,
+    .array_end = tree_end,
+    .inline_table_begin = tree_inline_table_begin,
+    .inline_table_end = tree_end,
+};
+
+/**
+ *  Decodes a value recorded as written; see tree_raw().
+ */
+static int view_decode(toml_view_t view, struct scalar *scalar)
+{
+    struct lexer lexer;
+    struct token token;
+
+    lexer_init(&lexer, view.ptr, view.length);
+    lexer.mode = LEXER_VALUE;
+    lexer.quiet = true;
+    lexer_next(&lexer, &token);
+
+    return scalar_decode(&token, scalar);
+}
+
+/**
+ *  Lazy loads only record where each value is; see toml_type_of().
+ *  Array elements are decoded at once, to be packed by type.
+ */
+static int tree_raw(void *ctx, toml_view_t value)
+{
+    struct tree_builder *builder = (struct tree_builder *)ctx;
+
+    if (tree_in_array(builder)) {
+        struct scalar scalar;
+
+        if (view_decode(value, &scalar) != 0) {
+            ERROR("%.*s: unknown or unsuppoted value", (int)value.length, value.ptr);
+            return -1;
+        }
+        return emit_scalar(&tree_callbacks, builder, &scalar);
+    }
+
+    struct toml_value *v = &builder->object->key.value;
+    v->type = VAL_TYPE_LAZY;
+    v->string_value = value.ptr;
+    v->string_length = value.length;
+
+    return 0;
+}
+
+static const struct toml_callbacks lazy_tree_callbacks = {
+    .table = tree_table,
+    .array_table = tree_array_table,
+    .key = tree_key,
+    .array_begin = tree_array_begin,
+    .array_end = tree_end,
+    .inline_table_begin = tree_inline_table_begin,
+    .inline_table_end = tree_end,
+    .raw = tree_raw,
+};
+
+/**
+ *  Parses @c buf into the tree of @c builder, which keeps the current
+ *  table from one call to the next.
+ */
+static int parse_tree(struct tree_builder *builder, const char *buf, size_t length, struct parse_state *state)
+{
+    const struct toml_callbacks *callbacks = &tree_callbacks;
+
+    if ((builder->obj->doc->flags & TOML_LOAD_LAZY) != 0) {
+        callbacks = &lazy_tree_callbacks;
+    }
+
+    return parse_document(callbacks, builder, buf, length, state);
+}
+
+/**
+ *  Type of @c object, classifying and decoding a lazily loaded value on
+ *  first access the same way an eager load would have. The result is
+ *  kept in the node.
+ *
+ *  @return type, or VAL_TYPE_NONE if the value is invalid.
+ */
+static enum toml_value_type toml_type_of(struct toml *object)
+{
+    struct toml_value *value = &object->key.value;
+
+    if (value->type == VAL_TYPE_LAZY) {
+        struct tree_builder builder = {
+            .obj = object,
+            .object = object,
+        };
+        toml_view_t view = {.ptr = value->string_value, .length = value->string_length};
+        struct scalar scalar;
+
+        if ((view_decode(view, &scalar) != 0) || (emit_scalar(&tree_callbacks, &builder, &scalar) != 0)) {
+            ERROR("%.*s: unknown or unsuppoted value", (int)value->string_length, value->string_value);
+            return VAL_TYPE_NONE;
+        }
+    }
+
+    return value->type;
+}
+
+/**
+ *  Loads @c pathname with the flags of toml_load_ex(). Setting
+ *  CTOMAT_CACHE in the environment adds TOML_LOAD_CACHE.
+ */
+toml_t toml_load(const char *pathname)
+{
+    return toml_load_ex(pathname, (getenv("CTOMAT_CACHE") != NULL) ? TOML_LOAD_CACHE : 0);
+}
+
+toml_t toml_load_from_memory_ex(const char *buf, size_t length, int flags)
+{
+    if (buf == NULL) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    const char *nul = memchr(buf, '\0', length);
+    if (nul != NULL) {
+        length = nul - buf;
+    }
+
+    toml_t obj = toml_alloc();
+    if (obj == NULL) {
+        return NULL;
+    }
+    if (length > 0) {
+        char *source = malloc(length);
+        if (source == NULL) {
+            toml_free(obj);
+            return NULL;
+        }
+        memcpy(source, buf, length);
+        obj->doc->source = source;
+        obj->doc->source_length = length;
+    }
+    obj->doc->flags = flags;
+
+    struct tree_builder builder = TREE_BUILDER_INITIALIZER(obj);
+    struct parse_state state = PARSE_STATE_INITIALIZER;
+    if (parse_tree(&builder, obj->doc->source, length, &state) != 0) {
+        toml_free(obj);
+        errno = EINVAL;
+        return NULL;
+    }
+
+    return obj;
+}
+
+toml_t toml_load_from_memory(const char *buf, size_t length)
+{
+    return toml_load_from_memory_ex(buf, length, 0);
+}
+
+/*
+ *  Parallel loading splits the input before lines that start with '[',
+ *  so that every segment but the first starts with a top-level header.
+ *  Each worker builds the tables of its segment under a root of its own,
+ *  in a document of its own, and the subtrees are then moved under the
+ *  root in document order. Only keys and tables that more than one
+ *  segment defines are looked at again: headers reopening a table from
+ *  an earlier segment, arrays of tables appended to, and duplicates.
+ *
+ *  A segment its worker cannot build alone, such as one that extends an
+ *  array of tables from an earlier segment before appending to it, is
+ *  parsed again in place. A split inside a multi-line string or array
+ *  leaves a segment that does not end where its last statement ends,
+ *  and a merge a header would not accept is given up on; both fall back
+ *  to a serial parse, which also gives the exact diagnostics.
+ */
+
+struct segment {
+    const char *input;          /**< bytes of the caller. */
+    char *text;                 /**< where they are copied in the document source. */
+    size_t length;
+    bool last;
+    struct toml_document *doc;  /**< document the nodes are moved into. */
+    struct toml *root;          /**< root the worker built the segment under. */
+    int result;
+    bool started;
+    pthread_t thread;
+};
+
+/**
+ *  Points the descendants of @c object to @c doc, which they move into.
+ */
+static void segment_rehome(struct toml *object, struct toml_document *doc)
+{
+    for (ITER iter = ntree_children_iter(object->node); !iter_is_end(iter); iter = iter_next(iter)) {
+        struct toml *child = (struct toml *)iter_data(iter);
+        child->doc = doc;
+        segment_rehome(child, doc);
+    }
+}
+
+/**
+ *  Copies and parses one segment into a document of its own. A segment
+ *  must end exactly where its last statement ends, or the split was
+ *  wrong and the result is void.
+ */
+static void *segment_parse(void *arg)
+{
+    struct segment *segment = (struct segment *)arg;
+    struct parse_state state = PARSE_STATE_INITIALIZER;
+
+    memcpy(segment->text, segment->input, segment->length);
+    segment->result = -1;
+    segment->root = toml_alloc();
+    if (segment->root == NULL) {
+        return NULL;
+    }
+    state.partial = !segment->last;
+    state.quiet = true;
+    struct tree_builder builder = TREE_BUILDER_INITIALIZER(segment->root);
+    segment->result = parse_document(&tree_callbacks, &builder, segment->text, segment->length, &state);
+    if ((segment->result == 0) && (state.consumed != segment->length)) {
+        segment->result = -1;
+    }
+    if (segment->result == 0) {
+        segment_rehome(segment->root, segment->doc);
+    }
+
+    return NULL;
+}
+
+/**
+ *  The children of @c object, to be freed, for moving them elsewhere.
+ *
+ *  @return children, or NULL with errno set if out of memory.
+ */
+static struct toml **segment_children(struct toml *object, size_t *count)
+{
+    size_t n = 0;
+    for (ITER iter = ntree_children_iter(object->node); !iter_is_end(iter); iter = iter_next(iter)) {
+        ++n;
+    }
+    struct toml **children = malloc((n > 0) ? (n * sizeof(*children)) : 1);
+    if (children == NULL) {
+        return NULL;
+    }
+    n = 0;
+    for (ITER iter = ntree_children_iter(object->node); !iter_is_end(iter); iter = iter_next(iter)) {
+        children[n++] = (struct toml *)iter_data(iter);
+    }
+    *count = n;
+
+    return children;
+}
+
+/**
+ *  Moves @c child, built by a worker, under @c parent of the document.
+ */
+static int segment_move(struct toml *parent, struct toml *child)
+{
+    if (ntree_move(parent->node, child->node) != 0) {
+        return -1;
+    }
+
+    return index_add(parent->doc, parent, child);
+}
+
+static int segment_merge(struct toml *table, struct toml *from);
+
+/**
+ *  Moves @c child of a table built by a worker into @c table, or merges
+ *  it with the child of the same name there the way tree_header() would
+ *  have opened it.
+ *
+ *  @return 0 on success, or -1 if the child is defined twice or cannot
+ *          be merged.
+ */
+static int segment_adopt(struct toml *table, struct toml *child)
+{
+    const struct toml_value *value = &child->key.value;
+    struct toml *found = object_find(table, child->key.name, child->key.name_length,
+                                     key_hash(child->key.name, child->key.name_length));
+    if (found == NULL) {
+        return segment_move(table, child);
+    }
+
+    struct toml_value *existing = &found->key.value;
+    if ((value->type == VAL_TYPE_OBJECT) && (value->table_flags == TABLE_IMPLICIT)) {
+        /* a table on the way to a header, which may be in an array of tables. */
+        bool indexable = true;
+        struct toml *entered = table_enter(found, &indexable);
+        return (entered != NULL) ? segment_merge(entered, child) : -1;
+    }
+    if ((value->type == VAL_TYPE_OBJECT) && (value->table_flags == TABLE_HEADER)
+        && (existing->type == VAL_TYPE_OBJECT) && (existing->table_flags == TABLE_IMPLICIT)) {
+
+        existing->table_flags = TABLE_HEADER;
+        return segment_merge(found, child);
+    }
+    if ((value->type == VAL_TYPE_ARRAY) && ((value->table_flags & TABLE_ARRAY) != 0)
+        && (existing->type == VAL_TYPE_ARRAY) && ((existing->table_flags & TABLE_ARRAY) != 0)) {
+
+        /* elements have no names to check. */
+        existing->array_length += value->array_length;
+        return ntree_move_children(found->node, child->node);
+    }
+
+    return -1;
+}
+
+/**
+ *  Moves the children of @c from into @c table.
+ */
+static int segment_merge(struct toml *table, struct toml *from)
+{
+    size_t count;
+    struct toml **children = segment_children(from, &count);
+    if (children == NULL) {
+        return -1;
+    }
+
+    int ret = 0;
+    for (size_t i = 0; (ret == 0) && (i < count); ++i) {
+        ret = segment_adopt(table, children[i]);
+    }
+    free(children);
+
+    return ret;
+}
+
+/**
+ *  Gives @c doc the nodes and memory of the worker document @c from,
+ *  whose nodes may have been moved into @c doc, and frees the rest.
+ *  @c doc->grafts has room for it.
+ */
+static void segment_release(struct toml_document *doc, struct toml_document *from)
+{
+    doc->grafts[doc->graft_count++] = from->tree;
+    if (from->blocks != NULL) {
+        struct toml_block *last = from->blocks;
+        while (last->next != NULL) {
+            last = last->next;
+        }
+        last->next = doc->blocks;
+        doc->blocks = from->blocks;
+    }
+    free(from->scratch);
+    free(from->dirty);
+    free(from);
+}
+
+/**
+ *  Start of the segment after the one at @c start: the first line after
+ *  @c target that opens an array of tables or a table of a single key,
+ *  else the first that starts with '[', or @c length if there is none.
+ *  A dotted header may name a table in the last element of an array of
+ *  tables opened before the split, which a worker cannot tell, so it is
+ *  avoided within a segment of @c span bytes.
+ */
+static size_t segment_split(const char *buf, size_t length, size_t start, size_t target, size_t span)
+{
+    size_t end = (target > start) ? target : start;
+    size_t limit = ((length - end) > span) ? (end + span) : length;
+    size_t dotted = length;
+
+    while (end < length) {
+        const char *newline = memchr(buf + end, '\n', length - end);
+        if (newline == NULL) {
+            break;
+        }
+        end = (size_t)(newline - buf) + 1;
+        if ((end == length) || (buf[end] != '[')) {
+            continue;
+        }
+        const char *eol = memchr(buf + end, '\n', length - end);
+        const char *close = memchr(buf + end, ']', ((eol != NULL) ? (size_t)(eol - buf) : length) - end);
+        if (((end + 1) < length) && ((buf[end + 1] == '[')
+                                     || ((close != NULL) && (memchr(buf + end, '.', close - (buf + end)) == NULL)))) {
+            return end;
+        }
+        if (dotted == length) {
+            dotted = end;
+        }
+        if ((end >= limit) && (dotted < length)) {
+            break;
+        }
+    }
+
+    return dotted;
+}
+
+toml_t toml_load_from_memory_parallel(const char *buf, size_t length, int nthreads)
+{
+    if (buf == NULL) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    const char *nul = memchr(buf, '\0', length);
+    if (nul != NULL) {
+        length = nul - buf;
+    }
+
+    if (nthreads <= 0) {
+        nthreads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    }
+    size_t count = length / PARALLEL_SEGMENT_MIN;
+    if (count > (size_t)nthreads) {
+        count = nthreads;
+    }
+    if (count > PARALLEL_SEGMENTS_MAX) {
+        count = PARALLEL_SEGMENTS_MAX;
+    }
+    if (count <= 1) {
+        return toml_load_from_memory(buf, length);
+    }
+
+    struct segment segments[PARALLEL_SEGMENTS_MAX];
+    size_t start = 0;
+    size_t split = 0;
+    while ((split < count) && (start < length)) {
+        size_t end = length;
+        if (split < (count - 1)) {
+            end = segment_split(buf, length, start, (length / count) * (split + 1), length / count);
+        }
+        segments[split] = (struct segment){
+            .input = buf + start,
+            .length = end - start,
+            .last = (end == length),
+        };
+        ++split;
+        start = end;
+    }
+    count = split;
+    /* without top-level headers to split at, there is one segment. */
+    if (count <= 1) {
+        return toml_load_from_memory(buf, length);
+    }
+
+    toml_t obj = toml_alloc();
+    char *source = malloc(length);
+    NTREE *grafts = calloc(count, sizeof(*grafts));
+    if ((obj == NULL) || (source == NULL) || (grafts == NULL)) {
+        free(grafts);
+        free(source);
+        if (obj != NULL) {
+            toml_free(obj);
+        }
+        return NULL;
+    }
+    obj->doc->source = source;
+    obj->doc->source_length = length;
+    obj->doc->grafts = grafts;
+    for (size_t i = 0; i < count; ++i) {
+        segments[i].text = source + (segments[i].input - buf);
+        segments[i].doc = obj->doc;
+    }
+
+    for (size_t i = 1; i < count; ++i) {
+        segments[i].started = (pthread_create(&segments[i].thread, NULL, segment_parse, &segments[i]) == 0);
+    }
+
+    /* the first segment goes straight into the tree. */
+    struct tree_builder builder = TREE_BUILDER_INITIALIZER(obj);
+    struct parse_state state = PARSE_STATE_INITIALIZER;
+    state.partial = !segments[0].last;
+    state.quiet = true;
+    memcpy(segments[0].text, segments[0].input, segments[0].length);
+    int ret = parse_document(&tree_callbacks, &builder, segments[0].text, segments[0].length, &state);
+    if (state.consumed != segments[0].length) {
+        ret = -1;
+    }
+
+    /* subtrees are moved in document order, so keys keep their order. */
+    for (size_t i = 1; i < count; ++i) {
+        if (segments[i].started) {
+            pthread_join(segments[i].thread, NULL);
+        } else {
+            segment_parse(&segments[i]);
+        }
+        if ((ret == 0) && (segments[i].result == 0)) {
+            ret = segment_merge(obj, segments[i].root);
+        } else if (ret == 0) {
+            /* a segment its worker could not build alone is parsed in place. */
+            state = PARSE_STATE_INITIALIZER;
+            state.partial = !segments[i].last;
+            state.quiet = true;
+            ret = parse_document(&tree_callbacks, &builder, segments[i].text, segments[i].length, &state);
+            if (state.consumed != segments[i].length) {
+                ret = -1;
+            }
+        }
+        if (segments[i].root != NULL) {
+            segment_release(obj->doc, segments[i].root->doc);
+        }
+    }
+
+    if (ret != 0) {
+        /* parse again serially, for exact diagnostics. */
+        toml_free(obj);
+        return toml_load_from_memory(buf, length);
+    }
+
+    return obj;
+}
+
+/**
+ *  Chunks are appended to a document-owned block and parsed in place, so
+ *  the nodes may refer to them. When the block fills up, only the
+ *  statement left incomplete moves to a larger one.
+ *
+ *  A statement left incomplete is not parsed again until the text after
+ *  it closes what it left open, or until it has doubled in size; the
+ *  text is skimmed once for that, so that a long array or multi-line
+ *  string fed in small chunks is parsed in linear time.
+ */
+enum parser_skim {
+    SKIM_CODE,
+    SKIM_COMMENT,
+    SKIM_BASIC_STRING,
+    SKIM_LITERAL_STRING,
+    SKIM_MULTILINE_BASIC_STRING,
+    SKIM_MULTILINE_LITERAL_STRING,
+};
+
+struct toml_parser {
+    struct toml *root;
+    struct tree_builder builder;
+    char *text;
+    size_t text_length;
+    size_t text_capacity;
+    size_t held;    /**< offset of the incomplete statement in @c text. */
+    size_t retry;   /**< length of the statement to parse it again at. */
+    size_t scanned; /**< end of the text skimmed. */
+    size_t nesting; /**< arrays and inline tables open at @c scanned. */
+    enum parser_skim skim;
+    struct parse_state state;
+    bool waiting;   /**< the statement at @c held was found incomplete. */
+    bool ready;     /**< the text skimmed may complete the statement. */
+    bool failed;
+};
+
+toml_parser_t toml_parser_create(void)
+{
+    struct toml_parser *parser = malloc(sizeof(*parser));
+    if (parser == NULL) {
+        return NULL;
+    }
+
+    parser->root = toml_alloc();
+    if (parser->root == NULL) {
+        free(parser);
+        return NULL;
+    }
+    parser->builder = TREE_BUILDER_INITIALIZER(parser->root);
+    parser->text = NULL;
+    parser->text_length = 0;
+    parser->text_capacity = 0;
+    parser->held = 0;
+    parser->retry = 0;
+    parser->scanned = 0;
+    parser->nesting = 0;
+    parser->skim = SKIM_CODE;
+    parser->state = PARSE_STATE_INITIALIZER;
+    parser->state.partial = true;
+    parser->waiting = false;
+    parser->ready = false;
+    parser->failed = false;
+
+    return parser;
+}
+
+/**
+ *  Appends @c length bytes to the text. A larger block takes over when
+ *  needed; the full one stays, as the nodes may refer to it.
+ */
+static int parser_append(struct toml_parser *parser, const char *chunk, size_t length)
+{
+    if (length > (parser->text_capacity - parser->text_length)) {
+        size_t held = parser->text_length - parser->held;
+        size_t capacity = (held + length) * 2;
+        if (capacity < ARENA_BLOCK_BYTES) {
+            capacity = ARENA_BLOCK_BYTES;
+        }
+        char *text = toml_block_alloc(parser->root->doc, capacity);
+        if (text == NULL) {
+            return -1;
+        }
+        if (held > 0) {
+            memcpy(text, parser->text + parser->held, held);
+        }
+        parser->scanned -= parser->held;
+        parser->text = text;
+        parser->text_length = held;
+        parser->text_capacity = capacity;
+        parser->held = 0;
+    }
+    memcpy(parser->text + parser->text_length, chunk, length);
+    parser->text_length += length;
+
+    return 0;
+}
+
+/**
+ *  Skims the text appended since the last call, from where the statement
+ *  held ran out of input, and tells whether it closes the strings,
+ *  arrays and inline tables left open there. A quote or backslash at the
+ *  end waits for the bytes after it.
+ */
+static bool parser_ready(struct toml_parser *parser)
+{
+    const char *text = parser->text;
+    size_t end = parser->text_length;
+    size_t i = parser->scanned;
+
+    if (!parser->waiting || ((end - parser->held) >= parser->retry)) {
+        return true;
+    }
+    while (!parser->ready && (i < end)) {
+        char c = text[i];
+        char quote;
+        size_t run = 1;
+
+        switch (parser->skim) {
+        case SKIM_CODE:
+            if ((c == '"') || (c == '\'')) {
+                if ((end - i) < 3) {
+                    goto wait;
+                }
+                if ((text[i + 1] == c) && (text[i + 2] == c)) {
+                    parser->skim = (c == '"') ? SKIM_MULTILINE_BASIC_STRING : SKIM_MULTILINE_LITERAL_STRING;
+                    run = 3;
+                } else {
+                    parser->skim = (c == '"') ? SKIM_BASIC_STRING : SKIM_LITERAL_STRING;
+                }
+            } else if (parser->nesting == 0) {
+                parser->ready = true;
+            } else if (c == '#') {
+                parser->skim = SKIM_COMMENT;
+            } else if ((c == '[') || (c == '{')) {
+                ++parser->nesting;
+            } else if ((c == ']') || (c == '}')) {
+                --parser->nesting;
+            }
+            break;
+        case SKIM_COMMENT:
+            if (c == '\n') {
+                parser->skim = SKIM_CODE;
+            }
+            break;
+        case SKIM_BASIC_STRING:
+            if (c == '\\') {
+                if ((end - i) < 2) {
+                    goto wait;
+                }
+                run = 2;
+            } else if ((c == '"') || (c == '\n')) {
+                parser->skim = SKIM_CODE;
+            }
+            break;
+        case SKIM_LITERAL_STRING:
+            if ((c == '\'') || (c == '\n')) {
+                parser->skim = SKIM_CODE;
+            }
+            break;
+        case SKIM_MULTILINE_BASIC_STRING:
+        case SKIM_MULTILINE_LITERAL_STRING:
+            quote = (parser->skim == SKIM_MULTILINE_BASIC_STRING) ? '"' : '\'';
+            if ((c == '\\') && (quote == '"')) {
+                if ((end - i) < 2) {
+                    goto wait;
+                }
+                run = 2;
+            } else if (c == quote) {
+                if ((end - i) < 3) {
+                    goto wait;
+                }
+                if ((text[i + 1] == c) && (text[i + 2] == c)) {
+                    parser->skim = SKIM_CODE;
+                    run = 3;
+                }
+            }
+            break;
+        }
+        i += run;
+    }
+wait:
+    parser->scanned = i;
+
+    return parser->ready;
+}
+
+int toml_parser_feed(toml_parser_t parser, const char *chunk, size_t length)
+{
+    if ((parser == NULL) || ((chunk == NULL) && (length > 0)) || parser->failed) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (length == 0) {
+        return 0;
+    }
+
+    if (parser_append(parser, chunk, length) != 0) {
+        return -1;
+    }
+    /* a statement can only end at a newline. */
+    if ((memchr(chunk, '\n', length) == NULL) || !parser_ready(parser)) {
+        return 0;
+    }
+
+    size_t start = parser->held;
+    size_t held = parser->text_length - start;
+    if (parse_tree(&parser->builder, parser->text + start, held, &parser->state) != 0) {
+        parser->failed = true;
+        errno = EINVAL;
+        return -1;
+    }
+    parser->held = start + parser->state.consumed;
+    held -= parser->state.consumed;
+    parser->waiting = (held > 0);
+    parser->retry = held * 2;
+    parser->scanned = start + parser->state.stopped;
+    parser->nesting = parser->state.nesting;
+    parser->skim = SKIM_CODE;
+    parser->ready = false;
+
+    return 0;
+}
+
+/**
+ *  Parses what is left and returns the document.
+ *  The parser is released in any case.
+ */
+toml_t toml_parser_finish(toml_parser_t parser)
+{
+    if (parser == NULL) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    struct toml *root = parser->root;
+    bool failed = parser->failed;
+    size_t held = parser->text_length - parser->held;
+    if (!failed && (held > 0)) {
+        parser->state.partial = false;
+        failed = (parse_tree(&parser->builder, parser->text + parser->held, held, &parser->state) != 0);
+    }
+    free(parser);
+
+    if (failed) {
+        toml_free(root);
+        errno = EINVAL;
+        return NULL;
+    }
+
+    return root;
+}
+
+/*
+ *  The serializer writes a table's own values before the headers of its
+ *  subtables, as TOML requires; arrays and inline tables are written
+ *  inline.
+ */
+
+#define WRITER_BUFFER_BYTES (64 * 1024)
+
+/**
+ *  Output cursor of the serializer. Writing to memory, bytes beyond
+ *  @c size are counted but not written, so that one pass tells the size
+ *  needed. Writing to @c fd, @c buf is flushed whenever it fills up.
+ */
+struct writer {
+    char *buf;
+    size_t size;
+    size_t length;  /**< bytes output so far. */
+    int fd;         /**< file to flush to, or -1. */
+    size_t flushed; /**< bytes already written to @c fd. */
+    int error;      /**< errno of the first failed write. */
+};
+
+/**
+ *  Writes the buffered bytes and then @c length bytes of @c str to the
+ *  file with one writev(), so that long strings are not copied.
+ */
+static void writer_flush(struct writer *writer, const char *str, size_t length)
+{
+    struct iovec iov[2] = {
+        {.iov_base = writer->buf, .iov_len = writer->length - writer->flushed},
+        {.iov_base = (void *)str, .iov_len = length},
+    };
+    struct iovec *cur = iov;
+    int count = 2;
+
+    while ((count > 0) && (writer->error == 0)) {
+        ssize_t written = writev(writer->fd, cur, count);
+        if (written == -1) {
+            if (errno != EINTR) {
+                writer->error = errno;
+            }
+            continue;
+        }
+        for (; (count > 0) && ((size_t)written >= cur->iov_len); ++cur, --count) {
+            written -= cur->iov_len;
+        }
+        if (count > 0) {
+            cur->iov_base = (char *)cur->iov_base + written;
+            cur->iov_len -= written;
+        }
+    }
+    writer->flushed = writer->length + length;
+}
+
+static void writer_write(struct writer *writer, const char *str, size_t length)
+{
+    if (writer->fd != -1) {
+        size_t pending = writer->length - writer->flushed;
+        if (length > (writer->size - pending)) {
+            writer_flush(writer, str, length);
+        } else {
+            memcpy(writer->buf + pending, str, length);
+        }
+    } else if (writer->length < writer->size) {
+        size_t room = writer->size - writer->length;
+        memcpy(writer->buf + writer->length, str, (length < room) ? length : room);
+    }
+    writer->length += length;
+}
+
+static void writer_puts(struct writer *writer, const char *str)
+{
+    writer_write(writer, str, strlen(str));
+}
+
+static void writer_putc(struct writer *writer, char c)
+{
+    writer_write(writer, &c, 1);
+}
+
+/**
+ *  Tells whether @c str can be written as a single-line literal string;
+ *  strings from multi-line literals are written as basic strings.
+ */
+static bool is_literal_safe(const char *str, size_t length)
+{
+    for (size_t i = 0; i < length; ++i) {
+        uint8_t c = (uint8_t)str[i];
+        if ((c == '\'') || ((c < 0x20) && (c != '\t')) || (c == 0x7F)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool is_bare_key(const char *name, size_t length)
+{
+    for (size_t i = 0; i < length; ++i) {
+        char c = name[i];
+        if (!(((c >= 'A') && (c <= 'Z')) || ((c >= 'a') && (c <= 'z')) || ((c >= '0') && (c <= '9'))
+              || (c == '_') || (c == '-'))) {
+            return false;
+        }
+    }
+    return length > 0;
+}
+
+static void save_basic_string(struct writer *writer, const char *str, size_t length)
+{
+    writer_putc(writer, '"');
+    if (writer->fd != -1) {
+        /* an escape is at most 6 bytes, so each piece fits in the buffer. */
+        const size_t piece = WRITER_BUFFER_BYTES / 6;
+        for (size_t n; length > 0; str += n, length -= n) {
+            n = (length < piece) ? length : piece;
+            if ((writer->size - (writer->length - writer->flushed)) < (n * 6)) {
+                writer_flush(writer, NULL, 0);
+            }
+            writer->length += escape_encode(str, n, writer->buf + (writer->length - writer->flushed), n * 6);
+        }
+    } else {
+        size_t room = (writer->length < writer->size) ? (writer->size - writer->length) : 0;
+        /* a size query has no buffer to point into. */
+        char *dst = (room > 0) ? (writer->buf + writer->length) : NULL;
+        writer->length += escape_encode(str, length, dst, room);
+    }
+    writer_putc(writer, '"');
+}
+
+/**
+ *  Keys are kept decoded, so a key that cannot be bare is written between
+ *  literal quotes when it can be, or escaped like a basic string.
+ */
+static void save_key(struct writer *writer, const struct toml_key *key)
+{
+    if (is_bare_key(key->name, key->name_length)) {
+        writer_write(writer, key->name, key->name_length);
+    } else if (is_literal_safe(key->name, key->name_length)) {
+        writer_putc(writer, '\'');
+        writer_write(writer, key->name, key->name_length);
+        writer_putc(writer, '\'');
+    } else {
+        save_basic_string(writer, key->name, key->name_length);
+    }
+}
+
+static struct toml *toml_parent(const struct toml *object)
+{
+    NTREE_NODE parent = ntree_parent(object->node);
+
+    return (parent != NULL) ? (struct toml *)ntree_data(parent) : NULL;
+}
+
+/**
+ *  Writes the dotted path of @c table relative to @c top; tables in an
+ *  array of tables take the name of the array.
+ */
+static void save_path(struct writer *writer, const struct toml *table, const struct toml *top)
+{
+    const struct toml *parent = toml_parent(table);
+
+    if ((parent != NULL) && (parent->key.value.type == VAL_TYPE_ARRAY)) {
+        save_path(writer, parent, top);
+        return;
+    }
+    if ((parent != NULL) && (parent != top)) {
+        save_path(writer, parent, top);
+        writer_putc(writer, '.');
+    }
+    save_key(writer, &table->key);
+}
+
+static int save_value(struct writer *writer, struct toml *object);
+
+static int save_scalar(struct writer *writer, const struct toml_value *value)
+{
+    /* large enough for number_format_*() as well. */
+    char text[DATETIME_TEXT_BYTES];
+
+    switch (value->type) {
+    case VAL_TYPE_LITERAL_STRING:
+        if (is_literal_safe(value->string_value, value->string_length)) {
+            writer_putc(writer, '\'');
+            writer_write(writer, value->string_value, value->string_length);
+            writer_putc(writer, '\'');
+            break;
+        }
+        /* fall through */
+    case VAL_TYPE_BASIC_STRING:
+        save_basic_string(writer, value->string_value, value->string_length);
+        break;
+    case VAL_TYPE_INTEGER:
+        writer_write(writer, text, number_format_integer(value->integer_value, text));
+        break;
+    case VAL_TYPE_FLOAT:
+        writer_write(writer, text, number_format_float(value->float_value, text));
+        break;
+    case VAL_TYPE_BOOLEAN:
+        writer_puts(writer, value->boolean_value ? "true" : "false");
+        break;
+    case VAL_TYPE_DATETIME:
+        writer_write(writer, text, datetime_format(&value->datetime_value, text));
+        break;
+    default:
+        errno = EINVAL;
+        return -1;
+    }
+
+    return 0;
+}
+
+static int save_array(struct writer *writer, struct toml *array)
+{
+    const struct toml_value *value = &array->key.value;
+    size_t i = 0;
+
+    writer_putc(writer, '[');
+    /* once unpacked by toml_array_get(), the nodes may have changed. */
+    if ((value->array_type != VAL_TYPE_NONE) && (ntree_last_child(array->node) == NULL)) {
+        size_t size = packed_size(value->array_type);
+
+        for (; i < value->array_length; ++i) {
+            struct toml_value element;
+
+            packed_value(value->array_type, (const char *)value->array_elements + (i * size), &element);
+            writer_puts(writer, (i > 0) ? ", " : "");
+            if (save_scalar(writer, &element) != 0) {
+                return -1;
+            }
+        }
+    } else {
+        for (ITER iter = ntree_children_iter(array->node); !iter_is_end(iter); iter = iter_next(iter), ++i) {
+            writer_puts(writer, (i > 0) ? ", " : "");
+            if (save_value(writer, (struct toml *)iter_data(iter)) != 0) {
+                return -1;
+            }
+        }
+    }
+    writer_putc(writer, ']');
+
+    return 0;
+}
+
+static int save_inline_table(struct writer *writer, struct toml *table)
+{
+    size_t i = 0;
+
+    writer_putc(writer, '{');
+    for (ITER iter = ntree_children_iter(table->node); !iter_is_end(iter); iter = iter_next(iter), ++i) {
+        struct toml *child = (struct toml *)iter_data(iter);
+
+        writer_puts(writer, (i > 0) ? ", " : " ");
+        save_key(writer, &child->key);
+        writer_puts(writer, " = ");
+        if (save_value(writer, child) != 0) {
+            return -1;
+        }
+    }
+    writer_puts(writer, (i > 0) ? " }" : "}");
+
+    return 0;
+}
+
+static int save_value(struct writer *writer, struct toml *object)
+{
+    switch (toml_type_of(object)) {
+    case VAL_TYPE_ARRAY:
+        return save_array(writer, object);
+    case VAL_TYPE_OBJECT:
+        return save_inline_table(writer, object);
+    default:
+        return save_scalar(writer, &object->key.value);
+    }
+}
+
+/**
+ *  Tables and arrays of tables are written as sections under headers;
+ *  everything else is a key/value line of its table.
+ */
+static bool is_section(const struct toml *object)
+{
+    const struct toml_value *value = &object->key.value;
+
+    return ((value->type == VAL_TYPE_OBJECT) && ((value->table_flags & TABLE_INLINE) == 0))
+           || ((value->type == VAL_TYPE_ARRAY) && ((value->table_flags & TABLE_ARRAY) != 0));
+}
+
+static int save_table(struct writer *writer, struct toml *table, const struct toml *top);
+
+static int save_header(struct writer *writer, struct toml *table, const struct toml *top, bool array)
+{
+    if (writer->length > 0) {
+        writer_putc(writer, '\n');
+    }
+    writer_puts(writer, array ? "[[" : "[");
+    save_path(writer, table, top);
+    writer_puts(writer, array ? "]]\n" : "]\n");
+
+    return save_table(writer, table, top);
+}
+
+static int save_table(struct writer *writer, struct toml *table, const struct toml *top)
+{
+    for (ITER iter = ntree_children_iter(table->node); !iter_is_end(iter); iter = iter_next(iter)) {
+        struct toml *child = (struct toml *)iter_data(iter);
+
+        if (is_section(child)) {
+            continue;
+        }
+        save_key(writer, &child->key);
+        writer_puts(writer, " = ");
+        if (save_value(writer, child) != 0) {
+            return -1;
+        }
+        writer_putc(writer, '\n');
+    }
+
+    for (ITER iter = ntree_children_iter(table->node); !iter_is_end(iter); iter = iter_next(iter)) {
+        struct toml *child = (struct toml *)iter_data(iter);
+        int ret = 0;
+
+        if (!is_section(child)) {
+            continue;
+        }
+        if (child->key.value.type == VAL_TYPE_ARRAY) {
+            for (ITER it = ntree_children_iter(child->node); (ret == 0) && !iter_is_end(it); it = iter_next(it)) {
+                ret = save_header(writer, (struct toml *)iter_data(it), top, true);
+            }
+        } else {
+            /* a table with only subtables needs no header of its own. */
+            bool values = false;
+            for (ITER it = ntree_children_iter(child->node); !iter_is_end(it); it = iter_next(it)) {
+                values = values || !is_section((struct toml *)iter_data(it));
+            }
+            if (values || (ntree_last_child(child->node) == NULL) || (child->key.value.table_flags & TABLE_HEADER)) {
+                ret = save_header(writer, child, top, false);
+            } else {
+                ret = save_table(writer, child, top);
+            }
+        }
+        if (ret != 0) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/*
+ *  A document that keeps its source is saved by copying the source and
+ *  rewriting only the values changed since, so comments and formatting
+ *  survive. Nodes keep no offsets: the key of a value points into the
+ *  source, and the value is found again after its '='.
+ */
+
+/**
+ *  A value of the source to be replaced with @c object.
+ */
+struct edit {
+    const char *head;
+    const char *tail;
+    struct toml *object;
+};
+
+static int edit_compare(const void *a, const void *b)
+{
+    const struct edit *x = (const struct edit *)a;
+    const struct edit *y = (const struct edit *)b;
+
+    return (x->head > y->head) - (x->head < y->head);
+}
+
+/**
+ *  Finds the source of the value of @c object from its key.
+ *
+ *  @return 0 on success, or -1 if the value is not in the source.
+ */
+static int source_span(const struct toml_document *doc, const struct toml *object, struct edit *edit)
+{
+    const char *end = doc->source + doc->source_length;
+    const char *cur = object->key.name;
+    struct lexer lexer;
+    struct token token;
+
+    if ((cur == NULL) || (cur < doc->source) || (cur >= end)) {
+        return -1;
+    }
+    cur += object->key.name_length;
+    if ((cur < end) && ((*cur == '"') || (*cur == '\''))) {
+        ++cur;
+    }
+    while ((cur < end) && ((*cur == ' ') || (*cur == '\t'))) {
+        ++cur;
+    }
+    if ((cur == end) || (*cur != '=')) {
+        return -1;
+    }
+
+    lexer_init(&lexer, cur + 1, end - (cur + 1));
+    lexer.mode = LEXER_VALUE;
+    lexer.quiet = true;
+    lexer_next(&lexer, &token);
+    edit->head = token.head - token.opening;
+    if (parse_value(&skip_callbacks, NULL, &lexer, &token, 0) != 0) {
+        return -1;
+    }
+    edit->tail = lexer.cur;
+    edit->object = (struct toml *)object;
+
+    return 0;
+}
+
+/**
+ *  Writes the source of @c doc with the changed values rewritten. An
+ *  element of an array has no key, so the whole array is rewritten.
+ *
+ *  @return 0 on success, 1 if a changed value is not in the source, or
+ *          -1 with errno set.
+ */
+static int save_source(struct writer *writer, struct toml_document *doc)
+{
+    const char *cur = doc->source;
+    struct edit *edits = NULL;
+
+    if (doc->dirty_length > 0) {
+        edits = malloc(doc->dirty_length * sizeof(*edits));
+        if (edits == NULL) {
+            return -1;
+        }
+    }
+    for (size_t i = 0; i < doc->dirty_length; ++i) {
+        struct toml *object = doc->dirty[i];
+        struct toml *parent;
+
+        while (((parent = toml_parent(object)) != NULL) && (parent->key.value.type == VAL_TYPE_ARRAY)) {
+            object = parent;
+        }
+        if (source_span(doc, object, &edits[i]) != 0) {
+            free(edits);
+            return 1;
+        }
+    }
+    if (edits != NULL) {
+        qsort(edits, doc->dirty_length, sizeof(*edits), edit_compare);
+    }
+
+    int ret = 0;
+    for (size_t i = 0; (ret == 0) && (i < doc->dirty_length); ++i) {
+        /* elements of one array share its edit. */
+        if (edits[i].head < cur) {
+            continue;
+        }
+        writer_write(writer, cur, edits[i].head - cur);
+        ret = save_value(writer, edits[i].object);
+        cur = edits[i].tail;
+    }
+    if (ret == 0) {
+        writer_write(writer, cur, (doc->source + doc->source_length) - cur);
+    }
+    free(edits);
+
+    return ret;
+}
+
+static int image_complete(struct toml *object);
+
+static int save_document(struct writer *writer, struct toml *object)
+{
+    if (image_complete(object) != 0) {
+        return -1;
+    }
+    if ((object == object->doc->root) && (object->doc->source != NULL)) {
+        int ret = save_source(writer, object->doc);
+        if (ret != 1) {
+            return ret;
+        }
+    }
+
+    return save_table(writer, object, object);
+}
+
+/**
+ *  Creates a file next to @c pathname, to be renamed over it by
+ *  temp_commit(). Its name is returned in @c temp.
+ *
+ *  @return file descriptor opened for reading and writing, or -1 with
+ *          errno set.
+ */
+static int temp_open(const char *pathname, char **temp)
+{
+    static unsigned int sequence = 0;
+    size_t size = strlen(pathname) + 32;
+    int fd;
+
+    *temp = malloc(size);
+    if (*temp == NULL) {
+        return -1;
+    }
+    /* unlike mkstemp(), a new file gets the permissions the umask allows. */
+    do {
+        snprintf(*temp, size, "%s.%d.%u.tmp", pathname, (int)getpid(),
+                 __atomic_fetch_add(&sequence, 1, __ATOMIC_RELAXED));
+        fd = open(*temp, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0666);
+    } while ((fd == -1) && (errno == EEXIST));
+    if (fd == -1) {
+        free(*temp);
+    }
+
+    return fd;
+}
+
+/**
+ *  Closes the file from temp_open(). If @c ret is 0, the file is synced
+ *  and renamed over @c pathname, whose permissions it takes; otherwise,
+ *  or if that fails, it is removed.
+ *
+ *  @return 0 on success, or -1 with errno set.
+ */
+static int temp_commit(int fd, char *temp, const char *pathname, int ret)
+{
+    struct stat st;
+
+    if ((ret == 0) && (stat(pathname, &st) == 0)) {
+        ret = fchmod(fd, st.st_mode & 07777);
+    }
+    if (ret == 0) {
+        ret = fdatasync(fd);
+    }
+    if ((close(fd) == -1) && (ret == 0)) {
+        ret = -1;
+    }
+    if (ret == 0) {
+        ret = rename(temp, pathname);
+    }
+    if (ret != 0) {
+        int error = errno;
+        unlink(temp);
+        errno = error;
+    }
+    free(temp);
+
+    return ret;
+}
+
+/**
+ *  Writes @c object as a TOML document to @c pathname through a buffer
+ *  of fixed size, like toml_save_to_memory(). The document is written
+ *  to a temporary file that is renamed over @c pathname, so readers see
+ *  either the old or the new file in whole; an existing file keeps its
+ *  permissions.
+ *
+ *  @return 0 on success, or -1 with errno set.
+ */
+int toml_save(toml_t object, const char *pathname)
+{
+    if ((object == NULL) || (pathname == NULL)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    char *buf = malloc(WRITER_BUFFER_BYTES);
+    if (buf == NULL) {
+        return -1;
+    }
+
+    char *temp;
+    struct writer writer = {
+        .buf = buf,
+        .size = WRITER_BUFFER_BYTES,
+        .length = 0,
+        .fd = temp_open(pathname, &temp),
+        .flushed = 0,
+        .error = 0,
+    };
+    if (writer.fd == -1) {
+        free(buf);
+        return -1;
+    }
+
+    int ret = save_document(&writer, object);
+    if (ret == 0) {
+        writer_flush(&writer, NULL, 0);
+        if (writer.error != 0) {
+            errno = writer.error;
+            ret = -1;
+        }
+    }
+    ret = temp_commit(writer.fd, temp, pathname, ret);
+    free(buf);
+
+    return ret;
+}
+
+/**
+ *  Writes @c object as a TOML document into @c buf, NUL-terminated like
+ *  snprintf(); @c buf may be NULL if @c length is 0. A loaded document
+ *  is written as loaded, but for the values changed since.
+ *
+ *  @return length of the whole document, which is @c length or more if
+ *          it was truncated, or -1 with errno set.
+ */
+ssize_t toml_save_to_memory(toml_t object, char *buf, size_t length)
+{
+    if ((object == NULL) || ((buf == NULL) && (length > 0))) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    struct writer writer = {
+        .buf = buf,
+        .size = (length > 0) ? (length - 1) : 0,
+        .length = 0,
+        .fd = -1,
+    };
+    if (save_document(&writer, object) != 0) {
+        return -1;
+    }
+    if (length > 0) {
+        buf[(writer.length < writer.size) ? writer.length : writer.size] = '\0';
+    }
+
+    return (ssize_t)writer.length;
+}
+
+/*
+ *  A compiled image is a document laid out flat, to be mapped instead of
+ *  parsed. Everything is addressed by offsets, in native byte order:
+ *
+ *      header | nodes | index slots | string pool | packed elements
+ *
+ *  The children of a node are consecutive and come after it, so a node
+ *  is found from its parent without reading the rest of the document.
+ *  Strings are NUL-terminated in the pool, and the strings and the
+ *  packed elements other than strings are used in place from the
+ *  mapping. A loaded image gets a node of the tree only for the values
+ *  reached through the API; see image_make().
+ */
+
+#define IMAGE_MAGIC "CTOMATC"
+#define IMAGE_VERSION (4)
+#define IMAGE_BYTE_ORDER (0x01020304)
+#define IMAGE_ALIGNMENT (8)
+#define IMAGE_CACHE_SUFFIX ".ctomatc"
+
+/**
+ *  The TOML file an image was compiled from, or zeros.
+ */
+struct image_source {
+    uint64_t size;
+    int64_t mtime;
+    int64_t mtime_nsec;
+    uint64_t hash; /**< hash64() of the text. */
+};
+
+struct image_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order; /**< IMAGE_BYTE_ORDER as written. */
+    uint64_t size;       /**< bytes of the whole image. */
+    struct image_source source;
+    uint64_t node_count;
+    uint64_t nodes;      /**< offsets of the sections. */
+    uint64_t slots;
+    uint64_t strings;
+    uint64_t elements;
+};
+
+/**
+ *  A node of the image. @c offset and @c length locate a string in the
+ *  pool, the packed elements of an array, or the index slots of a
+ *  table; an array keeps its length even if its elements are nodes.
+ */
+struct image_node {
+    uint8_t type;
+    uint8_t table_flags;
+    uint8_t array_type;
+    uint8_t reserved[5];
+    uint64_t parent;      /**< index of the parent node. */
+    uint64_t first_child; /**< index of the first of the consecutive children. */
+    uint64_t child_count;
+    uint64_t name;        /**< key, in the string pool. */
+    uint64_t name_length;
+    union {
+        struct {
+            uint64_t offset;
+            uint64_t length;
+        };
+        int64_t integer_value;
+        double float_value;
+        bool boolean_value;
+        toml_datetime_t datetime_value;
+    };
+};
+
+/**
+ *  A slot of a hash index; see struct toml_index_slot.
+ */
+struct image_slot {
+    uint32_t hash;
+    uint32_t child; /**< 1 + position among the children, or 0 if free. */
+};
+
+/**
+ *  A string element of a packed array.
+ */
+struct image_view {
+    uint64_t offset;
+    uint64_t length;
+};
+
+/**
+ *  Cursors into the sections of the image being written, or section
+ *  sizes while it is measured (@c image NULL).
+ */
+struct image_writer {
+    char *image;
+    struct image_header layout;
+    uint64_t node;
+    uint64_t slot;
+    uint64_t string;
+    uint64_t element;
+};
+
+static inline uint64_t image_align(uint64_t size)
+{
+    return (size + (IMAGE_ALIGNMENT - 1)) & ~(uint64_t)(IMAGE_ALIGNMENT - 1);
+}
+
+static uint64_t image_string(struct image_writer *writer, const char *str, size_t length)
+{
+    uint64_t offset = writer->string;
+
+    if (writer->image != NULL) {
+        char *pool = writer->image + writer->layout.strings;
+        /* elements of arrays have no name to copy from. */
+        if (length > 0) {
+            memcpy(pool + offset, str, length);
+        }
+        pool[offset + length] = '\0';
+    }
+    writer->string += length + 1;
+
+    return offset;
+}
+
+static size_t image_index_capacity(size_t count)
+{
+    size_t capacity = INDEX_MIN_CAPACITY;
+
+    while (capacity < (count * 2)) {
+        capacity *= 2;
+    }
+
+    return capacity;
+}
+
+/**
+ *  Lays out the index of the @c count children of @c object the way
+ *  index_put() would fill it.
+ */
+static void image_index(struct image_writer *writer, struct toml *object, size_t count, struct image_node *node)
+{
+    size_t capacity = image_index_capacity(count);
+
+    node->offset = writer->slot;
+    node->length = capacity;
+    if (writer->image != NULL) {
+        struct image_slot *slots = (struct image_slot *)(writer->image + writer->layout.slots) + writer->slot;
+        size_t mask = capacity - 1;
+        uint32_t position = 0;
+
+        memset(slots, 0, capacity * sizeof(*slots));
+        for (ITER iter = ntree_children_iter(object->node); !iter_is_end(iter); iter = iter_next(iter)) {
+            struct toml *child = (struct toml *)iter_data(iter);
+            uint32_t hash = key_hash(child->key.name, child->key.name_length);
+            size_t i;
+
+            for (i = hash & mask; slots[i].child != 0; i = (i + 1) & mask) {
+            }
+            slots[i].hash = hash;
+            slots[i].child = ++position;
+        }
+    }
+    writer->slot += capacity;
+}
+
+/**
+ *  Writes the packed elements of @c array.
+ */
+static void image_elements(struct image_writer *writer, const struct toml_value *value, struct image_node *node)
+{
+    size_t size = packed_size(value->array_type);
+    bool strings = is_string_type(value->array_type);
+    uint64_t bytes = (strings ? sizeof(struct image_view) : size) * value->array_length;
+
+    node->offset = writer->element;
+    if (writer->image != NULL) {
+        char *elements = writer->image + writer->layout.elements + writer->element;
+        if (strings) {
+            const toml_view_t *views = (const toml_view_t *)value->array_elements;
+            struct image_view *out = (struct image_view *)elements;
+            for (size_t i = 0; i < value->array_length; ++i) {
+                out[i].offset = image_string(writer, views[i].ptr, views[i].length);
+                out[i].length = views[i].length;
+            }
+        } else {
+            memcpy(elements, value->array_elements, bytes);
+        }
+    } else if (strings) {
+        const toml_view_t *views = (const toml_view_t *)value->array_elements;
+        for (size_t i = 0; i < value->array_length; ++i) {
+            image_string(writer, views[i].ptr, views[i].length);
+        }
+    }
+    writer->element += image_align(bytes);
+}
+
+/**
+ *  Writes @c object as node @c self and its descendants, the children of
+ *  each node taking the next free nodes from @c writer->node, or only
+ *  counts them while measuring.
+ *
+ *  @return 0 on success, or -1 with errno set to EINVAL if a lazy value
+ *          is invalid.
+ */
+static int image_node(struct image_writer *writer, struct toml *object, uint64_t self, uint64_t parent)
+{
+    struct image_node scratch;
+    struct image_node *node = &scratch;
+
+    if (writer->image != NULL) {
+        node = (struct image_node *)(writer->image + writer->layout.nodes) + self;
+    }
+    enum toml_value_type type = toml_type_of(object);
+    if (type == VAL_TYPE_NONE) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    const struct toml_value *value = &object->key.value;
+    memset(node, 0, sizeof(*node));
+    node->type = (uint8_t)type;
+    node->table_flags = value->table_flags;
+    node->parent = parent;
+    node->name = image_string(writer, (self > 0) ? object->key.name : "", (self > 0) ? object->key.name_length : 0);
+    node->name_length = (self > 0) ? object->key.name_length : 0;
+
+    switch (type) {
+    case VAL_TYPE_BASIC_STRING:
+    case VAL_TYPE_LITERAL_STRING:
+        node->offset = image_string(writer, value->string_value, value->string_length);
+        node->length = value->string_length;
+        return 0;
+    case VAL_TYPE_INTEGER:
+        node->integer_value = value->integer_value;
+        return 0;
+    case VAL_TYPE_FLOAT:
+        node->float_value = value->float_value;
+        return 0;
+    case VAL_TYPE_BOOLEAN:
+        node->boolean_value = value->boolean_value;
+        return 0;
+    case VAL_TYPE_DATETIME:
+        node->datetime_value = value->datetime_value;
+        return 0;
+    case VAL_TYPE_ARRAY:
+        node->length = value->array_length;
+        /* once unpacked by toml_array_get(), the nodes may have changed. */
+        if ((value->array_type != VAL_TYPE_NONE) && (ntree_last_child(object->node) == NULL)) {
+            node->array_type = value->array_type;
+            image_elements(writer, value, node);
+            return 0;
+        }
+        break;
+    default:
+        break;
+    }
+
+    size_t count = 0;
+    for (ITER iter = ntree_children_iter(object->node); !iter_is_end(iter); iter = iter_next(iter)) {
+        ++count;
+    }
+    if ((type == VAL_TYPE_OBJECT) && (count > INDEX_THRESHOLD)) {
+        image_index(writer, object, count, node);
+    }
+    node->first_child = writer->node;
+    node->child_count = count;
+    writer->node += count;
+
+    uint64_t child = node->first_child;
+    for (ITER iter = ntree_children_iter(object->node); !iter_is_end(iter); iter = iter_next(iter)) {
+        if (image_node(writer, (struct toml *)iter_data(iter), child++, self) != 0) {
+            iter_release(iter);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ *  Writes @c object as an image compiled from @c source, if not NULL.
+ */
+static int image_write(toml_t object, const char *pathname, const struct image_source *source)
+{
+    struct image_writer writer = {.node = 1};
+    if ((image_complete(object) != 0) || (image_node(&writer, object, 0, 0) != 0)) {
+        return -1;
+    }
+
+    struct image_header *layout = &writer.layout;
+    memcpy(layout->magic, IMAGE_MAGIC, sizeof(layout->magic));
+    layout->version = IMAGE_VERSION;
+    layout->byte_order = IMAGE_BYTE_ORDER;
+    if (source != NULL) {
+        layout->source = *source;
+    }
+    layout->node_count = writer.node;
+    layout->nodes = image_align(sizeof(*layout));
+    layout->slots = layout->nodes + (writer.node * sizeof(struct image_node));
+    layout->strings = layout->slots + (writer.slot * sizeof(struct image_slot));
+    layout->elements = image_align(layout->strings + writer.string);
+    layout->size = layout->elements + writer.element;
+
+    char *temp;
+    int fd = temp_open(pathname, &temp);
+    if (fd == -1) {
+        return -1;
+    }
+    int ret = ftruncate(fd, (off_t)layout->size);
+    if (ret == 0) {
+        writer.image = mmap(NULL, layout->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ret = (writer.image == MAP_FAILED) ? -1 : 0;
+    }
+    if (ret == 0) {
+        writer.node = 1;
+        writer.slot = 0;
+        writer.string = 0;
+        writer.element = 0;
+        ret = image_node(&writer, object, 0, 0);
+        if (ret == 0) {
+            memcpy(writer.image, layout, sizeof(*layout));
+        }
+        munmap(writer.image, layout->size);
+    }
+
+    return temp_commit(fd, temp, pathname, ret);
+}
+
+/**
+ *  Writes @c object as a compiled image to @c pathname, to be loaded by
+ *  toml_load_compiled(). Lazy values are decoded on the way. The file
+ *  replaces @c pathname as a whole, as with toml_save().
+ *
+ *  @return 0 on success, or -1 with errno set.
+ */
+int toml_compile(toml_t object, const char *pathname)
+{
+    if ((object == NULL) || (pathname == NULL) || (object->key.value.type != VAL_TYPE_OBJECT)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    return image_write(object, pathname, NULL);
+}
+
+/**
+ *  Checks that the header of @c image of @c size bytes describes it,
+ *  and that it was compiled from @c source, if not NULL. Only the header
+ *  is read: each node is checked against the sections when it is made.
+ */
+static bool image_is_valid(const char *image, size_t size, const struct image_source *source)
+{
+    const struct image_header *header = (const struct image_header *)image;
+
+    if ((size < sizeof(*header))
+        || (memcmp(header->magic, IMAGE_MAGIC, sizeof(header->magic)) != 0)
+        || (header->version != IMAGE_VERSION)
+        || (header->byte_order != IMAGE_BYTE_ORDER)
+        || (header->size != size)) {
+        return false;
+    }
+    if ((header->node_count == 0)
+        || (header->nodes < sizeof(*header))
+        || ((header->nodes % IMAGE_ALIGNMENT) != 0)
+        || (header->node_count > ((size - header->nodes) / sizeof(struct image_node)))
+        || (header->slots != (header->nodes + (header->node_count * sizeof(struct image_node))))
+        || (header->strings < header->slots)
+        || (((header->strings - header->slots) % sizeof(struct image_slot)) != 0)
+        || (header->elements < header->strings)
+        || ((header->elements % IMAGE_ALIGNMENT) != 0)
+        || (header->elements > size)) {
+        return false;
+    }
+
+    return (source == NULL) || (memcmp(&header->source, source, sizeof(*source)) == 0);
+}
+
+/**
+ *  Section of an image checked against its bounds.
+ */
+struct image_section {
+    const char *base;
+    uint64_t size;
+};
+
+static const char *image_at(const struct image_section *section, uint64_t offset, uint64_t length)
+{
+    return ((offset <= section->size) && (length <= (section->size - offset))) ? (section->base + offset) : NULL;
+}
+
+/**
+ *  The sections of an image checked by image_is_valid().
+ */
+struct image_map {
+    const struct image_node *nodes;
+    uint64_t node_count;
+    struct image_section slots;
+    struct image_section strings;
+    struct image_section elements;
+};
+
+static void image_sections(const struct toml_document *doc, struct image_map *map)
+{
+    const struct image_header *header = (const struct image_header *)doc->image;
+
+    map->nodes = (const struct image_node *)(doc->image + header->nodes);
+    map->node_count = header->node_count;
+    map->slots = (struct image_section){doc->image + header->slots, header->strings - header->slots};
+    map->strings = (struct image_section){doc->image + header->strings, header->elements - header->strings};
+    map->elements = (struct image_section){doc->image + header->elements, header->size - header->elements};
+}
+
+/**
+ *  Gives @c object the value of node @c index, referring to the mapping.
+ *  Tables and arrays of nodes keep their image node in @c image until
+ *  image_complete() makes all of their children.
+ *
+ *  @return 0 on success, or -1 if the node is out of the image.
+ */
+static int image_value(struct toml_document *doc, const struct image_map *map, uint64_t index, struct toml *object)
+{
+    const struct image_node *node = &map->nodes[index];
+    struct toml_value *value = &object->key.value;
+
+    object->key.name = image_at(&map->strings, node->name, node->name_length);
+    object->key.name_length = node->name_length;
+    if (object->key.name == NULL) {
+        return -1;
+    }
+    /* children come after their parent, so no node is its own descendant. */
+    if ((node->child_count > 0)
+        && (((node->type != VAL_TYPE_OBJECT) && (node->type != VAL_TYPE_ARRAY))
+            || (node->first_child <= index) || (node->first_child > map->node_count)
+            || (node->child_count > (map->node_count - node->first_child)))) {
+
+        return -1;
+    }
+    value->type = node->type;
+    value->table_flags = node->table_flags;
+    switch (node->type) {
+    case VAL_TYPE_OBJECT:
+        value->image = (node->child_count > 0) ? node : NULL;
+        return 0;
+    case VAL_TYPE_BASIC_STRING:
+    case VAL_TYPE_LITERAL_STRING:
+        /* the pool has a NUL after each string. */
+        value->string_value = image_at(&map->strings, node->offset, node->length + 1);
+        value->string_length = node->length;
+        value->terminated = true;
+        return (value->string_value != NULL) ? 0 : -1;
+    case VAL_TYPE_INTEGER:
+        value->integer_value = node->integer_value;
+        return 0;
+    case VAL_TYPE_FLOAT:
+        value->float_value = node->float_value;
+        return 0;
+    case VAL_TYPE_BOOLEAN:
+        value->boolean_value = node->boolean_value;
+        return 0;
+    case VAL_TYPE_DATETIME:
+        value->datetime_value = node->datetime_value;
+        return 0;
+    case VAL_TYPE_ARRAY:
+        break;
+    default:
+        return -1;
+    }
+
+    value->array_type = node->array_type;
+    value->array_length = node->length;
+    value->array_elements = NULL;
+    if (node->array_type == VAL_TYPE_NONE) {
+        value->image = (node->child_count > 0) ? node : NULL;
+        return (node->child_count == node->length) ? 0 : -1;
+    }
+    size_t size = packed_size(node->array_type);
+    if ((size == 0) || (node->child_count > 0)) {
+        return -1;
+    }
+    const struct image_section *elements = &map->elements;
+    if (!is_string_type(node->array_type)) {
+        if (node->length > (elements->size / size)) {
+            return -1;
+        }
+        value->array_elements = image_at(elements, node->offset, node->length * size);
+        return (value->array_elements != NULL) ? 0 : -1;
+    }
+
+    /* views hold pointers, so they are made again for the mapping. */
+    const struct image_view *in = NULL;
+    if (node->length <= (elements->size / sizeof(*in))) {
+        in = (const struct image_view *)image_at(elements, node->offset, node->length * sizeof(*in));
+    }
+    toml_view_t *views = (in != NULL) ? toml_arena_alloc_aligned(doc, node->length * sizeof(*views)) : NULL;
+    if (views == NULL) {
+        return -1;
+    }
+    for (size_t i = 0; i < node->length; ++i) {
+        views[i].ptr = image_at(&map->strings, in[i].offset, in[i].length + 1);
+        views[i].length = in[i].length;
+        if (views[i].ptr == NULL) {
+            return -1;
+        }
+    }
+    value->array_elements = views;
+
+    return 0;
+}
+
+/**
+ *  Makes the node of image node @c index, a child of @c parent, whose
+ *  children are still in the image. Each image node is made once, and
+ *  children made out of order are put back in order by image_complete().
+ *
+ *  @return node, or NULL with errno set to EINVAL if the image is
+ *          damaged.
+ */
+static struct toml *image_make(struct toml *parent, uint64_t index)
+{
+    struct toml_document *doc = parent->doc;
+    struct image_map map;
+
+    struct toml *made = doc->image_nodes[index];
+    if (made != NULL) {
+        if (ntree_parent(made->node) != parent->node) {
+            errno = EINVAL;
+            return NULL;
+        }
+        return made;
+    }
+    image_sections(doc, &map);
+
+    struct toml object = TOML_INITIALIZER;
+    if ((map.nodes[index].parent != (uint64_t)(parent->key.value.image - map.nodes))
+        || (image_value(doc, &map, index, &object) != 0)) {
+
+        errno = EINVAL;
+        return NULL;
+    }
+    doc->image_nodes[index] = toml_insert(doc, parent, &object);
+
+    return doc->image_nodes[index];
+}
+
+/**
+ *  The child at @c position of @c parent, whose children are still in
+ *  the image.
+ */
+static struct toml *image_child(struct toml *parent, uint64_t position)
+{
+    return image_make(parent, parent->key.value.image->first_child + position);
+}
+
+/**
+ *  The index slots laid out by image_index() for @c node, or NULL if
+ *  they are out of the image.
+ */
+static const struct image_slot *image_slots(const struct image_map *map, const struct image_node *node)
+{
+    size_t capacity = node->length;
+    const struct image_slot *slots = NULL;
+
+    if (((capacity & (capacity - 1)) == 0) && (capacity <= (map->slots.size / sizeof(*slots)))) {
+        slots = (const struct image_slot *)image_at(&map->slots, node->offset * sizeof(*slots),
+                                                    capacity * sizeof(*slots));
+    }
+
+    return slots;
+}
+
+static bool image_name_is(const struct image_map *map, const struct image_node *node, const char *name,
+                          size_t length)
+{
+    const char *key = image_at(&map->strings, node->name, length);
+
+    return (node->name_length == length) && (key != NULL) && (memcmp(key, name, length) == 0);
+}
+
+/**
+ *  Finds the child of @c object named @c name in the image, through its
+ *  index slots if it has some, and makes its node.
+ */
+static struct toml *image_find(struct toml *object, const char *name, size_t length, uint32_t hash)
+{
+    const struct image_node *node = object->key.value.image;
+    struct image_map map;
+
+    image_sections(object->doc, &map);
+    const struct image_node *children = &map.nodes[node->first_child];
+    if (node->length == 0) {
+        for (uint64_t i = 0; i < node->child_count; ++i) {
+            if (image_name_is(&map, &children[i], name, length)) {
+                return image_child(object, i);
+            }
+        }
+    } else {
+        const struct image_slot *slots = image_slots(&map, node);
+        if (slots == NULL) {
+            errno = EINVAL;
+            return NULL;
+        }
+        size_t mask = node->length - 1;
+        size_t i = hash & mask;
+        /* a damaged table may have no free slot to stop at. */
+        for (size_t probes = 0; (probes < node->length) && (slots[i].child != 0); ++probes, i = (i + 1) & mask) {
+            uint32_t position = slots[i].child - 1;
+            if ((slots[i].hash == hash) && (position < node->child_count)
+                && image_name_is(&map, &children[position], name, length)) {
+
+                return image_child(object, position);
+            }
+        }
+    }
+
+    errno = ENOENT;
+    return NULL;
+}
+
+/**
+ *  Gives @c object, whose children all have nodes, the index laid out by
+ *  image_index() for @c node.
+ */
+static int image_attach_index(struct toml *object, const struct image_node *node)
+{
+    struct toml_document *doc = object->doc;
+    struct image_map map;
+
+    image_sections(doc, &map);
+    const struct image_slot *in = image_slots(&map, node);
+    if (in == NULL) {
+        errno = EINVAL;
+        return -1;
+    }
+    size_t capacity = node->length;
+    struct toml_index *index = (struct toml_index *)toml_block_alloc(doc, sizeof(*index) + (capacity * sizeof(index->slots[0])));
+    if (index == NULL) {
+        return -1;
+    }
+
+    index->capacity = capacity;
+    index->count = 0;
+    for (size_t i = 0; i < capacity; ++i) {
+        index->slots[i].hash = in[i].hash;
+        index->slots[i].child = NULL;
+        if (in[i].child > node->child_count) {
+            errno = EINVAL;
+            return -1;
+        }
+        if (in[i].child > 0) {
+            index->slots[i].child = doc->image_nodes[node->first_child + in[i].child - 1];
+            ++index->count;
+        }
+    }
+    object->key.value.index = index;
+
+    return 0;
+}
+
+/**
+ *  Makes the nodes of all the descendants of @c object still in the
+ *  image, in document order, for the code that walks a whole subtree.
+ *
+ *  @return 0 on success, or -1 with errno set.
+ */
+static int image_complete(struct toml *object)
+{
+    struct toml_value *value = &object->key.value;
+
+    if ((object->doc->image == NULL)
+        || ((value->type != VAL_TYPE_OBJECT) && (value->type != VAL_TYPE_ARRAY))) {
+        return 0;
+    }
+
+    const struct image_node *node = value->image;
+    if (node != NULL) {
+        NTREE_NODE *order = malloc(node->child_count * sizeof(*order));
+        if (order == NULL) {
+            return -1;
+        }
+        int ret = 0;
+        for (uint64_t i = 0; (ret == 0) && (i < node->child_count); ++i) {
+            struct toml *child = image_child(object, i);
+            ret = (child != NULL) ? 0 : -1;
+            if (ret == 0) {
+                order[i] = child->node;
+            }
+        }
+        if (ret == 0) {
+            ret = ntree_reorder(object->node, order, node->child_count);
+        }
+        free(order);
+        if ((ret == 0) && (value->type == VAL_TYPE_OBJECT) && (node->length > 0)) {
+            ret = image_attach_index(object, node);
+        }
+        if (ret != 0) {
+            return -1;
+        }
+        value->image = NULL;
+    }
+
+    for (ITER iter = ntree_children_iter(object->node); !iter_is_end(iter); iter = iter_next(iter)) {
+        if (image_complete((struct toml *)iter_data(iter)) != 0) {
+            iter_release(iter);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ *  Gives the root of @c doc the root of its image. Other nodes are made
+ *  when they are reached; keys, strings and packed elements stay in the
+ *  mapping.
+ */
+static int image_load(struct toml_document *doc)
+{
+    struct image_map map;
+
+    image_sections(doc, &map);
+    if (map.nodes[0].type != VAL_TYPE_OBJECT) {
+        return -1;
+    }
+    doc->image_nodes = calloc(map.node_count, sizeof(*doc->image_nodes));
+    if (doc->image_nodes == NULL) {
+        return -1;
+    }
+    doc->image_nodes[0] = doc->root;
+
+    return image_value(doc, &map, 0, doc->root);
+}
+
+/**
+ *  Maps the image at @c pathname, compiled from @c source if not NULL.
+ */
+static toml_t image_open(const char *pathname, const struct image_source *source)
+{
+    struct stat st;
+    const char *image;
+    int fd;
+
+    fd = open(pathname, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        return NULL;
+    }
+    if (fstat(fd, &st) == -1) {
+        close(fd);
+        return NULL;
+    }
+    if ((size_t)st.st_size < sizeof(struct image_header)) {
+        close(fd);
+        errno = EINVAL;
+        return NULL;
+    }
+    image = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (image == MAP_FAILED) {
+        return NULL;
+    }
+    if (!image_is_valid(image, st.st_size, source)) {
+        munmap((void *)image, st.st_size);
+        errno = EINVAL;
+        return NULL;
+    }
+
+    toml_t obj = toml_alloc();
+    if (obj == NULL) {
+        munmap((void *)image, st.st_size);
+        return NULL;
+    }
+    obj->doc->image = image;
+    obj->doc->image_length = st.st_size;
+    if (image_load(obj->doc) != 0) {
+        toml_free(obj);
+        errno = EINVAL;
+        return NULL;
+    }
+
+    return obj;
+}
+
+/**
+ *  Loads a document compiled by toml_compile(). The image is mapped and
+ *  nothing is parsed: a value gets a node when it is first reached, and
+ *  keys and strings are read in place.
+ *
+ *  @return document, or NULL with errno set to EINVAL if the file is
+ *          not a valid image of this version.
+ */
+toml_t toml_load_compiled(const char *pathname)
+{
+    return image_open(pathname, NULL);
+}
+
+/*
+ *  With TOML_LOAD_CACHE, a file is compiled next to itself on first
+ *  load, and later loads map the image while the text is unchanged.
+ */
+
+/**
+ *  The pathname of the cache of @c pathname, to be freed.
+ */
+static char *cache_pathname(const char *pathname)
+{
+    size_t length = strlen(pathname);
+    char *cache = malloc(length + sizeof(IMAGE_CACHE_SUFFIX));
+
+    if (cache != NULL) {
+        memcpy(cache, pathname, length);
+        memcpy(cache + length, IMAGE_CACHE_SUFFIX, sizeof(IMAGE_CACHE_SUFFIX));
+    }
+
+    return cache;
+}
+
+static void cache_source(struct image_source *record, const char *source, const struct stat *st)
+{
+    memset(record, 0, sizeof(*record));
+    record->size = st->st_size;
+    record->mtime = st->st_mtim.tv_sec;
+    record->mtime_nsec = st->st_mtim.tv_nsec;
+    record->hash = hash64((source != NULL) ? source : "", st->st_size);
+}
+
+/**
+ *  Loads the cache of @c pathname if it was compiled from @c source,
+ *  the text of @c pathname as @c st describes it.
+ *
+ *  @return document, or NULL if the cache is missing or stale.
+ */
+static toml_t cache_load(const char *pathname, const char *source, const struct stat *st)
+{
+    struct image_source record;
+    char *cache = cache_pathname(pathname);
+
+    if (cache == NULL) {
+        return NULL;
+    }
+    cache_source(&record, source, st);
+    toml_t obj = image_open(cache, &record);
+    free(cache);
+
+    return obj;
+}
+
+/**
+ *  Replaces the cache of @c pathname with @c object, parsed from
+ *  @c source. The cache is only an optimization, so failures, such as a
+ *  read-only directory, are ignored.
+ */
+static void cache_store(toml_t object, const char *pathname, const char *source, const struct stat *st)
+{
+    struct image_source record;
+    char *cache = cache_pathname(pathname);
+    int saved = errno;
+
+    if (cache != NULL) {
+        cache_source(&record, source, st);
+        if (image_write(object, cache, &record) != 0) {
+            DEBUG("%s: cache not written: %s", cache, strerror(errno));
+        }
+        free(cache);
+    }
+    errno = saved;
+}
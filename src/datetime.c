@@ -0,0 +1,259 @@
+/** @file       datetime.c
+ *  @brief      Date-time decoder.
+ *
+ *  RFC 3339 date-times have a fixed layout, so the fields are read at
+ *  known positions and converted to days with the civil calendar
+ *  algorithms of Howard Hinnant.
+ *
+ *  @author     t-kenji <protect.2501@gmail.com>
+ *  @date       2018-12-07 create new.
+ *  @copyright  Copyright © 2018 t-kenji
+ *
+ *  This code is licensed under the MIT License.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
+#include <errno.h>
+
+#include "debug.h"
+#include "datetime.h"
+
+#define SECONDS_PER_DAY (86400)
+
+/**
+ *  value of two decimal digits, or -1.
+ */
+static inline int digits2(const char *str)
+{
+    unsigned int hi = (uint8_t)str[0] - '0';
+    unsigned int lo = (uint8_t)str[1] - '0';
+
+    return ((hi < 10) && (lo < 10)) ? (int)((hi * 10) + lo) : -1;
+}
+
+static inline bool is_leap_year(int year)
+{
+    return ((year % 4) == 0) && (((year % 100) != 0) || ((year % 400) == 0));
+}
+
+static int days_in_month(int year, int month)
+{
+    static const uint8_t days[] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+
+    return ((month == 2) && is_leap_year(year)) ? 29 : days[month - 1];
+}
+
+/**
+ *  days since 1970-01-01 of a proleptic Gregorian date.
+ */
+static int64_t days_from_civil(int64_t year, unsigned int month, unsigned int day)
+{
+    year -= (month <= 2);
+
+    int64_t era = ((year >= 0) ? year : (year - 399)) / 400;
+    unsigned int yoe = (unsigned int)(year - (era * 400));
+    unsigned int doy = ((153 * ((month > 2) ? (month - 3) : (month + 9))) + 2) / 5 + day - 1;
+    unsigned int doe = (yoe * 365) + (yoe / 4) - (yoe / 100) + doy;
+
+    return (era * 146097) + (int64_t)doe - 719468;
+}
+
+static void civil_from_days(int64_t days, int64_t *year, unsigned int *month, unsigned int *day)
+{
+    days += 719468;
+
+    int64_t era = ((days >= 0) ? days : (days - 146096)) / 146097;
+    unsigned int doe = (unsigned int)(days - (era * 146097));
+    unsigned int yoe = (doe - (doe / 1460) + (doe / 36524) - (doe / 146096)) / 365;
+    unsigned int doy = doe - ((365 * yoe) + (yoe / 4) - (yoe / 100));
+    unsigned int mp = ((5 * doy) + 2) / 153;
+
+    *day = doy - (((153 * mp) + 2) / 5) + 1;
+    *month = (mp < 10) ? (mp + 3) : (mp - 9);
+    *year = (int64_t)yoe + (era * 400) + (*month <= 2);
+}
+
+/**
+ *  YYYY-MM-DD
+ */
+static const char *parse_date(const char *cur, const char *end, int64_t *days)
+{
+    if (((end - cur) < 10) || (cur[4] != '-') || (cur[7] != '-')) {
+        return NULL;
+    }
+
+    int century = digits2(cur);
+    int year = digits2(cur + 2);
+    int month = digits2(cur + 5);
+    int day = digits2(cur + 8);
+    if ((century < 0) || (year < 0) || (month < 1) || (month > 12) || (day < 1)) {
+        return NULL;
+    }
+    year += century * 100;
+    if (day > days_in_month(year, month)) {
+        return NULL;
+    }
+    *days = days_from_civil(year, month, day);
+
+    return cur + 10;
+}
+
+/**
+ *  HH:MM:SS with an optional fraction. A leap second is counted as
+ *  second 59, with @c leap set, so that it is written back as 60.
+ */
+static const char *parse_time(const char *cur, const char *end, int64_t *seconds, uint32_t *nanoseconds,
+                              uint8_t *leap)
+{
+    if (((end - cur) < 8) || (cur[2] != ':') || (cur[5] != ':')) {
+        return NULL;
+    }
+
+    int hour = digits2(cur);
+    int minute = digits2(cur + 3);
+    int second = digits2(cur + 6);
+    /* a leap second may be 60. */
+    if ((hour < 0) || (hour > 23) || (minute < 0) || (minute > 59) || (second < 0) || (second > 60)) {
+        return NULL;
+    }
+    *leap = (second == 60);
+    *seconds = (hour * 3600) + (minute * 60) + second - *leap;
+    cur += 8;
+
+    *nanoseconds = 0;
+    if ((cur < end) && (*cur == '.')) {
+        const char *first = ++cur;
+        uint32_t scale = 100000000;
+
+        for (; (cur < end) && ((unsigned int)((uint8_t)*cur - '0') < 10); ++cur) {
+            *nanoseconds += ((uint8_t)*cur - '0') * scale;
+            scale /= 10;
+        }
+        if (cur == first) {
+            return NULL;
+        }
+    }
+
+    return cur;
+}
+
+/**
+ *  Z or +HH:MM, in minutes east of UTC.
+ */
+static const char *parse_offset(const char *cur, const char *end, int *minutes)
+{
+    if ((*cur == 'Z') || (*cur == 'z')) {
+        *minutes = 0;
+        return cur + 1;
+    }
+    if (((end - cur) < 6) || ((*cur != '+') && (*cur != '-')) || (cur[3] != ':')) {
+        return NULL;
+    }
+
+    int hour = digits2(cur + 1);
+    int minute = digits2(cur + 4);
+    if ((hour < 0) || (hour > 23) || (minute < 0) || (minute > 59)) {
+        return NULL;
+    }
+    *minutes = (hour * 60) + minute;
+    if (*cur == '-') {
+        *minutes = -*minutes;
+    }
+
+    return cur + 6;
+}
+
+int datetime_parse(const char *str, size_t length, toml_datetime_t *value)
+{
+    const char *end = str + length;
+    const char *cur;
+    int64_t days = 0;
+    int64_t seconds = 0;
+    uint32_t nanoseconds = 0;
+    uint8_t leap = 0;
+    int offset = 0;
+    enum toml_datetime_kind kind;
+
+    if ((length >= 3) && (str[2] == ':')) {
+        cur = parse_time(str, end, &seconds, &nanoseconds, &leap);
+        kind = TOML_LOCAL_TIME;
+    } else {
+        cur = parse_date(str, end, &days);
+        kind = TOML_LOCAL_DATE;
+        if ((cur != NULL) && (cur < end)) {
+            /* the delimiter may be a space, as RFC 3339 allows. */
+            if ((*cur == 'T') || (*cur == 't') || (*cur == ' ')) {
+                cur = parse_time(cur + 1, end, &seconds, &nanoseconds, &leap);
+                kind = TOML_LOCAL_DATETIME;
+            } else {
+                cur = NULL;
+            }
+        }
+        if ((cur != NULL) && (cur < end)) {
+            cur = parse_offset(cur, end, &offset);
+            kind = TOML_OFFSET_DATETIME;
+        }
+    }
+    if (cur != end) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    value->seconds = (days * SECONDS_PER_DAY) + seconds - (offset * 60);
+    value->nanoseconds = nanoseconds;
+    value->offset = (int16_t)offset;
+    value->kind = (uint8_t)kind;
+    value->leap = leap;
+
+    return 0;
+}
+
+size_t datetime_format(const toml_datetime_t *value, char *buf)
+{
+    int64_t seconds = value->seconds + (value->offset * 60);
+    int64_t days = seconds / SECONDS_PER_DAY;
+    int length = 0;
+
+    if ((seconds % SECONDS_PER_DAY) < 0) {
+        --days;
+    }
+    seconds -= days * SECONDS_PER_DAY;
+
+    if (value->kind != TOML_LOCAL_TIME) {
+        int64_t year;
+        unsigned int month;
+        unsigned int day;
+
+        civil_from_days(days, &year, &month, &day);
+        length += sprintf(buf + length, "%04" PRId64 "-%02u-%02u", year, month, day);
+    }
+    if (value->kind != TOML_LOCAL_DATE) {
+        if (value->kind != TOML_LOCAL_TIME) {
+            buf[length++] = 'T';
+        }
+        length += sprintf(buf + length, "%02d:%02d:%02d",
+                          (int)(seconds / 3600), (int)((seconds / 60) % 60), (int)(seconds % 60) + value->leap);
+        if (value->nanoseconds > 0) {
+            length += sprintf(buf + length, ".%09u", value->nanoseconds);
+            while (buf[length - 1] == '0') {
+                --length;
+            }
+        }
+    }
+    if (value->kind == TOML_OFFSET_DATETIME) {
+        if (value->offset == 0) {
+            buf[length++] = 'Z';
+        } else {
+            int offset = (value->offset < 0) ? -value->offset : value->offset;
+            length += sprintf(buf + length, "%c%02d:%02d", (value->offset < 0) ? '-' : '+',
+                              offset / 60, offset % 60);
+        }
+    }
+    buf[length] = '\0';
+
+    return length;
+}
@@ -0,0 +1,45 @@
+/** @file       datetime.h
+ *  @brief      Date-time decoder.
+ *
+ *  @author     t-kenji <protect.2501@gmail.com>
+ *  @date       2018-12-07 create new.
+ *  @copyright  Copyright © 2018 t-kenji
+ *
+ *  This code is licensed under the MIT License.
+ */
+#ifndef __CTOMAT_DATETIME_H__
+#define __CTOMAT_DATETIME_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ctomat.h"
+
+#define DATETIME_TEXT_BYTES (40) /**< longest text of datetime_format(), NUL included. */
+
+/**
+ *  Tells whether @c str has the shape of a date or a time, so that other
+ *  values can skip datetime_parse().
+ */
+static inline int datetime_like(const char *str, size_t length)
+{
+    return ((length >= 10) && (str[4] == '-')) || ((length >= 8) && (str[2] == ':'));
+}
+
+/**
+ *  Decodes a TOML offset date-time, local date-time, local date or local
+ *  time. Fractions of a second beyond nanoseconds are truncated.
+ *  @c str need not be NUL-terminated.
+ *
+ *  @return 0 on success, or -1 with errno set to EINVAL.
+ */
+int datetime_parse(const char *str, size_t length, toml_datetime_t *value);
+
+/**
+ *  Writes @c value as TOML into @c buf of at least DATETIME_TEXT_BYTES.
+ *
+ *  @return length of the text.
+ */
+size_t datetime_format(const toml_datetime_t *value, char *buf);
+
+#endif /* __CTOMAT_DATETIME_H__ */
@@ -0,0 +1,239 @@
+/** @file       escape.c
+ *  @brief      Escape sequences of basic strings.
+ *
+ *  Escapes are rare, so the decoder copies the runs between backslashes
+ *  in bulk with memchr() and memcpy(), which the C library vectorizes,
+ *  and decodes the sequences themselves one at a time.
+ *
+ *  @author     t-kenji <protect.2501@gmail.com>
+ *  @date       2018-12-08 create new.
+ *  @copyright  Copyright © 2018 t-kenji
+ *
+ *  This code is licensed under the MIT License.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+
+#include "debug.h"
+#include "escape.h"
+
+/**
+ *  value of a hexadecimal digit, or -1.
+ */
+static inline int hex_digit(char c)
+{
+    if ((unsigned int)((uint8_t)c - '0') < 10) {
+        return c - '0';
+    }
+    if ((unsigned int)(((uint8_t)c | 0x20) - 'a') < 6) {
+        return ((uint8_t)c | 0x20) - 'a' + 10;
+    }
+    return -1;
+}
+
+static size_t utf8_encode(uint32_t codepoint, char *buf)
+{
+    if (codepoint < 0x80) {
+        buf[0] = (char)codepoint;
+        return 1;
+    }
+    if (codepoint < 0x800) {
+        buf[0] = (char)(0xC0 | (codepoint >> 6));
+        buf[1] = (char)(0x80 | (codepoint & 0x3F));
+        return 2;
+    }
+    if (codepoint < 0x10000) {
+        buf[0] = (char)(0xE0 | (codepoint >> 12));
+        buf[1] = (char)(0x80 | ((codepoint >> 6) & 0x3F));
+        buf[2] = (char)(0x80 | (codepoint & 0x3F));
+        return 3;
+    }
+    buf[0] = (char)(0xF0 | (codepoint >> 18));
+    buf[1] = (char)(0x80 | ((codepoint >> 12) & 0x3F));
+    buf[2] = (char)(0x80 | ((codepoint >> 6) & 0x3F));
+    buf[3] = (char)(0x80 | (codepoint & 0x3F));
+    return 4;
+}
+
+int escape_scan(const char *str, const char *end, uint32_t *codepoint)
+{
+    int digits;
+
+    if ((end - str) < 2) {
+        return 0;
+    }
+    switch (str[1]) {
+    case 'b':
+        *codepoint = '\b';
+        return 2;
+    case 't':
+        *codepoint = '\t';
+        return 2;
+    case 'n':
+        *codepoint = '\n';
+        return 2;
+    case 'f':
+        *codepoint = '\f';
+        return 2;
+    case 'r':
+        *codepoint = '\r';
+        return 2;
+    case '"':
+        *codepoint = '"';
+        return 2;
+    case '\\':
+        *codepoint = '\\';
+        return 2;
+    case 'u':
+        digits = 4;
+        break;
+    case 'U':
+        digits = 8;
+        break;
+    default:
+        return -1;
+    }
+
+    uint32_t value = 0;
+    for (int i = 0; i < digits; ++i) {
+        if ((str + 2 + i) == end) {
+            return 0;
+        }
+        int digit = hex_digit(str[2 + i]);
+        if (digit < 0) {
+            return -1;
+        }
+        value = (value << 4) | (uint32_t)digit;
+    }
+    /* only Unicode scalar values may be escaped. */
+    if ((value > 0x10FFFF) || ((value >= 0xD800) && (value <= 0xDFFF))) {
+        return -1;
+    }
+    *codepoint = value;
+
+    return 2 + digits;
+}
+
+static inline bool is_blank(char c)
+{
+    return (c == ' ') || (c == '\t');
+}
+
+int escape_line_end(const char *str, const char *end)
+{
+    const char *cur = str + 1;
+
+    while ((cur < end) && is_blank(*cur)) {
+        ++cur;
+    }
+    if ((cur < end) && (*cur == '\r')) {
+        ++cur;
+        if ((cur < end) && (*cur != '\n')) {
+            return -1;
+        }
+    }
+    if (cur == end) {
+        return 0;
+    }
+    if (*cur != '\n') {
+        return -1;
+    }
+
+    for (++cur; cur < end; ++cur) {
+        if ((*cur == '\r') && ((cur + 1) < end) && (*(cur + 1) == '\n')) {
+            ++cur;
+        } else if (!is_blank(*cur) && (*cur != '\n')) {
+            break;
+        }
+    }
+
+    return (int)(cur - str);
+}
+
+int escape_decode(const char *str, size_t length, char *buf, size_t *decoded)
+{
+    const char *end = str + length;
+    char *out = buf;
+
+    while (str < end) {
+        const char *backslash = memchr(str, '\\', end - str);
+        if (backslash == NULL) {
+            backslash = end;
+        }
+        memcpy(out, str, backslash - str);
+        out += backslash - str;
+        if (backslash == end) {
+            break;
+        }
+
+        uint32_t codepoint;
+        int n = escape_scan(backslash, end, &codepoint);
+        if (n > 0) {
+            out += utf8_encode(codepoint, out);
+        } else if ((n = escape_line_end(backslash, end)) <= 0) {
+            errno = EINVAL;
+            return -1;
+        }
+        str = backslash + n;
+    }
+    *decoded = out - buf;
+
+    return 0;
+}
+
+size_t escape_encode(const char *str, size_t length, char *buf, size_t size)
+{
+    static const char hex[] = "0123456789ABCDEF";
+    size_t n = 0;
+
+    for (size_t i = 0; i < length; ++i) {
+        uint8_t c = (uint8_t)str[i];
+        char seq[6];
+        size_t len = 2;
+
+        seq[0] = '\\';
+        switch (c) {
+        case '\b':
+            seq[1] = 'b';
+            break;
+        case '\t':
+            seq[1] = 't';
+            break;
+        case '\n':
+            seq[1] = 'n';
+            break;
+        case '\f':
+            seq[1] = 'f';
+            break;
+        case '\r':
+            seq[1] = 'r';
+            break;
+        case '"':
+        case '\\':
+            seq[1] = (char)c;
+            break;
+        default:
+            if ((c < 0x20) || (c == 0x7F)) {
+                memcpy(seq + 1, "u00", 3);
+                seq[4] = hex[c >> 4];
+                seq[5] = hex[c & 0x0F];
+                len = 6;
+            } else {
+                seq[0] = (char)c;
+                len = 1;
+            }
+            break;
+        }
+        for (size_t j = 0; j < len; ++j, ++n) {
+            if (n < size) {
+                buf[n] = seq[j];
+            }
+        }
+    }
+
+    return n;
+}
@@ -0,0 +1,54 @@
+/** @file       escape.h
+ *  @brief      Escape sequences of basic strings.
+ *
+ *  @author     t-kenji <protect.2501@gmail.com>
+ *  @date       2018-12-08 create new.
+ *  @copyright  Copyright © 2018 t-kenji
+ *
+ *  This code is licensed under the MIT License.
+ */
+#ifndef __CTOMAT_ESCAPE_H__
+#define __CTOMAT_ESCAPE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ *  Reads the escape sequence at @c str, which starts with a backslash,
+ *  and the code point it stands for.
+ *
+ *  @return length of the sequence, 0 if @c end cuts it short,
+ *          or -1 if it is not a valid escape sequence.
+ */
+int escape_scan(const char *str, const char *end, uint32_t *codepoint);
+
+/**
+ *  Reads the line ending backslash at @c str, which a multi-line basic
+ *  string trims along with the blanks before the newline and all the
+ *  whitespace and newlines after it.
+ *
+ *  @return length of the trimmed text, 0 if @c end cuts it short,
+ *          or -1 if the backslash does not end the line.
+ */
+int escape_line_end(const char *str, const char *end);
+
+/**
+ *  Decodes the contents of a basic string into @c buf, which needs room
+ *  for @c length bytes since no escape sequence is shorter than its
+ *  UTF-8 encoding. Line ending backslashes are trimmed, as the lexer
+ *  only lets them through in multi-line strings.
+ *
+ *  @return 0 on success, or -1 with errno set to EINVAL.
+ */
+int escape_decode(const char *str, size_t length, char *buf, size_t *decoded);
+
+/**
+ *  Writes @c str as the contents of a basic string, escaping quotes,
+ *  backslashes and control characters. At most @c size bytes are written
+ *  and the result is not NUL-terminated.
+ *
+ *  @return length of the whole escaped text, which may exceed @c size.
+ */
+size_t escape_encode(const char *str, size_t length, char *buf, size_t size);
+
+#endif /* __CTOMAT_ESCAPE_H__ */
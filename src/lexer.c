@@ -0,0 +1,588 @@
+/** @file       lexer.c
+ *  @brief      Tokenizer for TOML documents.
+ *
+ *  The input is tokenized in a single forward pass. The first byte of a
+ *  token is looked up in a character class table, and the class together
+ *  with the current mode selects the action from a transition table.
+ *  String and comment bodies then jump between the structural bytes the
+ *  scanner marks. Bare keys and values are stepped over one byte at a
+ *  time: they are short, and a bitmap lookup per token costs more than
+ *  it saves.
+ *
+ *  @author     t-kenji <protect.2501@gmail.com>
+ *  @date       2018-12-01 create new.
+ *  @copyright  Copyright © 2018 t-kenji
+ *
+ *  This code is licensed under the MIT License.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "debug.h"
+#include "escape.h"
+#include "lexer.h"
+
+enum char_class {
+    CC_INVALID,
+    CC_SPACE,
+    CC_NEWLINE,
+    CC_CR,
+    CC_COMMENT,
+    CC_BARE,
+    CC_DOT,
+    CC_EQUAL,
+    CC_DQUOTE,
+    CC_SQUOTE,
+    CC_LBRACKET,
+    CC_RBRACKET,
+    CC_LBRACE,
+    CC_RBRACE,
+    CC_COMMA,
+    CC_OTHER,
+    CC_MAX,
+};
+
+#define CC_PRINTABLE_DEFAULTS    \
+    [0x20 ... 0x7E] = CC_OTHER,  \
+    [0x80 ... 0xFF] = CC_OTHER
+
+static const uint8_t char_class[256] = {
+    CC_PRINTABLE_DEFAULTS,
+    ['\t'] = CC_SPACE,
+    [' '] = CC_SPACE,
+    ['\n'] = CC_NEWLINE,
+    ['\r'] = CC_CR,
+    ['#'] = CC_COMMENT,
+    ['A' ... 'Z'] = CC_BARE,
+    ['a' ... 'z'] = CC_BARE,
+    ['0' ... '9'] = CC_BARE,
+    ['_'] = CC_BARE,
+    ['-'] = CC_BARE,
+    ['.'] = CC_DOT,
+    ['='] = CC_EQUAL,
+    ['"'] = CC_DQUOTE,
+    ['\''] = CC_SQUOTE,
+    ['['] = CC_LBRACKET,
+    [']'] = CC_RBRACKET,
+    ['{'] = CC_LBRACE,
+    ['}'] = CC_RBRACE,
+    [','] = CC_COMMA,
+};
+
+/**
+ *  bytes that end a run in the scanning loops.
+ */
+enum char_stop {
+    STOP_BASIC = 0x01,   /**< basic string: quote, backslash and controls. */
+    STOP_LITERAL = 0x02, /**< literal string: quote and controls. */
+    STOP_COMMENT = 0x04, /**< comment: newline and controls. */
+    STOP_VALUE = 0x08,   /**< bare value: whitespace, comment, separators and controls. */
+};
+
+#define STOP_CONTROL (STOP_BASIC | STOP_LITERAL | STOP_COMMENT | STOP_VALUE)
+
+static const uint8_t char_stop[256] = {
+    [0x00 ... 0x08] = STOP_CONTROL,
+    ['\t'] = STOP_VALUE,
+    [0x0A ... 0x1F] = STOP_CONTROL,
+    [' '] = STOP_VALUE,
+    ['"'] = STOP_BASIC,
+    ['#'] = STOP_VALUE,
+    [','] = STOP_VALUE,
+    [']'] = STOP_VALUE,
+    ['}'] = STOP_VALUE,
+    ['\''] = STOP_LITERAL,
+    ['\\'] = STOP_BASIC,
+    [0x7F] = STOP_CONTROL,
+};
+
+enum lexer_action {
+    ACT_ERROR,
+    ACT_NEWLINE,
+    ACT_CRLF,
+    ACT_COMMENT,
+    ACT_BARE_KEY,
+    ACT_DOT,
+    ACT_EQUAL,
+    ACT_BASIC_STRING,
+    ACT_LITERAL_STRING,
+    ACT_TABLE_OPEN,
+    ACT_TABLE_CLOSE,
+    ACT_ARRAY_OPEN,
+    ACT_ARRAY_CLOSE,
+    ACT_INLINE_TABLE_OPEN,
+    ACT_INLINE_TABLE_CLOSE,
+    ACT_COMMA,
+    ACT_VALUE,
+};
+
+static const uint8_t transitions[][CC_MAX] = {
+    [LEXER_KEY] = {
+        [CC_NEWLINE] = ACT_NEWLINE,
+        [CC_CR] = ACT_CRLF,
+        [CC_COMMENT] = ACT_COMMENT,
+        [CC_BARE] = ACT_BARE_KEY,
+        [CC_DOT] = ACT_DOT,
+        [CC_EQUAL] = ACT_EQUAL,
+        [CC_DQUOTE] = ACT_BASIC_STRING,
+        [CC_SQUOTE] = ACT_LITERAL_STRING,
+        [CC_LBRACKET] = ACT_TABLE_OPEN,
+        [CC_RBRACKET] = ACT_TABLE_CLOSE,
+        [CC_RBRACE] = ACT_INLINE_TABLE_CLOSE,
+        [CC_COMMA] = ACT_COMMA,
+    },
+    [LEXER_VALUE] = {
+        [CC_NEWLINE] = ACT_NEWLINE,
+        [CC_CR] = ACT_CRLF,
+        [CC_COMMENT] = ACT_COMMENT,
+        [CC_BARE] = ACT_VALUE,
+        [CC_DOT] = ACT_VALUE,
+        [CC_DQUOTE] = ACT_BASIC_STRING,
+        [CC_SQUOTE] = ACT_LITERAL_STRING,
+        [CC_LBRACKET] = ACT_ARRAY_OPEN,
+        [CC_RBRACKET] = ACT_ARRAY_CLOSE,
+        [CC_LBRACE] = ACT_INLINE_TABLE_OPEN,
+        [CC_RBRACE] = ACT_INLINE_TABLE_CLOSE,
+        [CC_COMMA] = ACT_COMMA,
+        [CC_OTHER] = ACT_VALUE,
+    },
+};
+
+#define min(a, b) (((a) < (b)) ? (a) : (b))
+
+#define char_class_of(c) (char_class[(uint8_t)(c)])
+#define char_stop_of(c) (char_stop[(uint8_t)(c)])
+#define is_digit(c) ((unsigned int)((uint8_t)(c) - '0') < 10)
+
+/**
+ *  finds the first structural byte at or after @c from, rescanning the
+ *  window when @c from leaves it. Only string and comment bodies use it.
+ */
+static const char *next_structural(struct lexer *lexer, const char *from)
+{
+    const char *end = lexer->end;
+
+    while (from < end) {
+        if ((from < lexer->window) || (from >= (lexer->window + lexer->window_length))) {
+            lexer->window = from;
+            lexer->window_length = min((size_t)(end - from), (size_t)LEXER_WINDOW_BYTES);
+            scan_structurals(lexer->window, lexer->window_length, lexer->bits);
+        }
+
+        size_t offset = from - lexer->window;
+        size_t words = (lexer->window_length + SCAN_BLOCK_BYTES - 1) / SCAN_BLOCK_BYTES;
+        size_t word = offset / SCAN_BLOCK_BYTES;
+        uint64_t mask = lexer->bits[word] & (~(uint64_t)0 << (offset % SCAN_BLOCK_BYTES));
+        while (mask == 0) {
+            if (++word == words) {
+                break;
+            }
+            mask = lexer->bits[word];
+        }
+        if (mask != 0) {
+            return lexer->window + (word * SCAN_BLOCK_BYTES) + __builtin_ctzll(mask);
+        }
+        from = lexer->window + lexer->window_length;
+    }
+
+    return end;
+}
+
+/*
+ *  The scanners below return the closing byte, NULL on a malformed input,
+ *  or @c end when the input runs out first.
+ */
+
+static const char *lex_basic_string(struct lexer *lexer, const char *cur, struct token *token)
+{
+    const char *end = lexer->end;
+
+    while ((cur = next_structural(lexer, cur)) < end) {
+        if ((char_stop_of(*cur) & STOP_BASIC) == 0) {
+            ++cur;
+        } else if (*cur == '\\') {
+            uint32_t codepoint;
+            int n = escape_scan(cur, end, &codepoint);
+            if (n == 0) {
+                return end;
+            }
+            if (n < 0) {
+                LEXER_ERROR(lexer, "invalid escape sequence");
+                return NULL;
+            }
+            token->escaped = true;
+            cur += n;
+        } else if (*cur == '"') {
+            return cur;
+        } else {
+            return NULL;
+        }
+    }
+
+    return end;
+}
+
+/**
+ *  Multi-line strings may hold newlines, and up to two quotes right
+ *  before the closing delimiter belong to the contents. A basic one
+ *  may also end lines with a backslash.
+ */
+static const char *lex_multiline_string(struct lexer *lexer, const char *cur, struct token *token, char quote)
+{
+    const char *end = lexer->end;
+    uint8_t stop = (quote == '"') ? STOP_BASIC : STOP_LITERAL;
+
+    while ((cur = next_structural(lexer, cur)) < end) {
+        if ((char_stop_of(*cur) & stop) == 0) {
+            ++cur;
+        } else if (*cur == quote) {
+            const char *run = cur;
+            while ((cur < end) && (*cur == quote)) {
+                ++cur;
+            }
+            if ((cur == end) && lexer->partial) {
+                return end;
+            }
+            if ((cur - run) > 5) {
+                return NULL;
+            }
+            if ((cur - run) >= 3) {
+                return cur - 3;
+            }
+        } else if (*cur == '\\') {
+            uint32_t codepoint;
+            int n = escape_scan(cur, end, &codepoint);
+            if (n < 0) {
+                n = escape_line_end(cur, end);
+                for (int i = 0; i < n; ++i) {
+                    lexer->line += (cur[i] == '\n');
+                }
+            }
+            if (n == 0) {
+                return end;
+            }
+            if (n < 0) {
+                LEXER_ERROR(lexer, "invalid escape sequence");
+                return NULL;
+            }
+            token->escaped = true;
+            cur += n;
+        } else if (*cur == '\n') {
+            ++lexer->line;
+            ++cur;
+        } else if (*cur == '\r') {
+            if ((cur + 1) == end) {
+                return end;
+            }
+            if (*(cur + 1) != '\n') {
+                return NULL;
+            }
+            ++cur;
+        } else {
+            return NULL;
+        }
+    }
+
+    return end;
+}
+
+static const char *lex_literal_string(struct lexer *lexer, const char *cur)
+{
+    const char *end = lexer->end;
+
+    while ((cur = next_structural(lexer, cur)) < end) {
+        if ((char_stop_of(*cur) & STOP_LITERAL) == 0) {
+            ++cur;
+        } else if (*cur == '\'') {
+            return cur;
+        } else {
+            return NULL;
+        }
+    }
+
+    return end;
+}
+
+/**
+ *  Strings and quoted keys are the only tokens that may hold bytes
+ *  beyond ASCII, so only they are validated as UTF-8.
+ */
+static bool lex_utf8(struct lexer *lexer, const char *head, const char *tail)
+{
+    if (!scan_utf8(head, tail - head)) {
+        LEXER_ERROR(lexer, "invalid UTF-8");
+        return false;
+    }
+    return true;
+}
+
+static const char *lex_comment(struct lexer *lexer, const char *cur)
+{
+    const char *end = lexer->end;
+
+    while (((cur = next_structural(lexer, cur)) < end) && ((char_stop_of(*cur) & STOP_COMMENT) == 0)) {
+        ++cur;
+    }
+    if ((cur < end) && (*cur == '\r')) {
+        if ((cur + 1) == end) {
+            return end;
+        }
+        return (*(cur + 1) == '\n') ? cur : NULL;
+    }
+    if ((cur < end) && (*cur != '\n')) {
+        return NULL;
+    }
+
+    return cur;
+}
+
+void lexer_init(struct lexer *lexer, const char *buf, size_t length)
+{
+    lexer->cur = buf;
+    lexer->end = buf + length;
+    lexer->line = 1;
+    lexer->mode = LEXER_KEY;
+    lexer->partial = false;
+    lexer->quiet = false;
+    lexer->nesting = 0;
+    lexer->window = NULL;
+    lexer->window_length = 0;
+}
+
+void lexer_next(struct lexer *lexer, struct token *token)
+{
+    const char *cur = lexer->cur;
+    const char *end = lexer->end;
+    const char *head;
+    const char *tail;
+
+    while ((cur < end) && (char_class_of(*cur) == CC_SPACE)) {
+        ++cur;
+    }
+
+    token->head = cur;
+    token->length = 0;
+    token->escaped = false;
+    token->opening = 0;
+    token->closing = 0;
+    if (cur == end) {
+        token->type = lexer->partial ? TOKEN_INCOMPLETE : TOKEN_EOF;
+        lexer->cur = cur;
+        return;
+    }
+
+    switch (transitions[lexer->mode][char_class_of(*cur)]) {
+    case ACT_NEWLINE:
+        token->type = TOKEN_NEWLINE;
+        tail = cur + 1;
+        ++lexer->line;
+        lexer->mode = LEXER_KEY;
+        break;
+    case ACT_CRLF:
+        if ((cur + 1) == end) {
+            goto incomplete;
+        }
+        if (*(cur + 1) != '\n') {
+            goto error;
+        }
+        token->type = TOKEN_NEWLINE;
+        tail = cur + 2;
+        ++lexer->line;
+        lexer->mode = LEXER_KEY;
+        break;
+    case ACT_COMMENT:
+        tail = lex_comment(lexer, cur + 1);
+        if (tail == NULL) {
+            goto error;
+        }
+        if ((tail == end) && lexer->partial) {
+            goto incomplete;
+        }
+        token->type = TOKEN_COMMENT;
+        break;
+    case ACT_BARE_KEY:
+        tail = cur + 1;
+        while ((tail < end) && (char_class_of(*tail) == CC_BARE)) {
+            ++tail;
+        }
+        if ((tail == end) && lexer->partial) {
+            goto incomplete;
+        }
+        token->type = TOKEN_BARE_KEY;
+        break;
+    case ACT_DOT:
+        token->type = TOKEN_DOT;
+        tail = cur + 1;
+        break;
+    case ACT_EQUAL:
+        token->type = TOKEN_EQUAL;
+        tail = cur + 1;
+        lexer->mode = LEXER_VALUE;
+        break;
+    case ACT_TABLE_OPEN:
+    case ACT_TABLE_CLOSE:
+        /* a doubled bracket belongs to an array of tables header. */
+        if (((cur + 1) == end) && lexer->partial) {
+            goto incomplete;
+        }
+        tail = cur + 1;
+        if ((tail < end) && (*tail == *cur)) {
+            ++tail;
+            token->type = (*cur == '[') ? TOKEN_ARRAY_TABLE_OPEN : TOKEN_ARRAY_TABLE_CLOSE;
+        } else {
+            token->type = (*cur == '[') ? TOKEN_TABLE_OPEN : TOKEN_TABLE_CLOSE;
+        }
+        break;
+    case ACT_ARRAY_OPEN:
+        token->type = TOKEN_ARRAY_OPEN;
+        tail = cur + 1;
+        ++lexer->nesting;
+        break;
+    case ACT_ARRAY_CLOSE:
+        token->type = TOKEN_ARRAY_CLOSE;
+        tail = cur + 1;
+        lexer->mode = LEXER_KEY;
+        if (lexer->nesting > 0) {
+            --lexer->nesting;
+        }
+        break;
+    case ACT_INLINE_TABLE_OPEN:
+        token->type = TOKEN_INLINE_TABLE_OPEN;
+        tail = cur + 1;
+        lexer->mode = LEXER_KEY;
+        ++lexer->nesting;
+        break;
+    case ACT_INLINE_TABLE_CLOSE:
+        token->type = TOKEN_INLINE_TABLE_CLOSE;
+        tail = cur + 1;
+        lexer->mode = LEXER_KEY;
+        if (lexer->nesting > 0) {
+            --lexer->nesting;
+        }
+        break;
+    case ACT_COMMA:
+        token->type = TOKEN_COMMA;
+        tail = cur + 1;
+        break;
+    case ACT_BASIC_STRING:
+        if (((cur + 3) > end) && lexer->partial) {
+            goto incomplete;
+        }
+        if (((cur + 2) < end) && (*(cur + 1) == '"') && (*(cur + 2) == '"')) {
+            goto multiline;
+        }
+        tail = lex_basic_string(lexer, cur + 1, token);
+        if (tail == end) {
+            goto incomplete;
+        }
+        if ((tail == NULL) || !lex_utf8(lexer, cur + 1, tail)) {
+            goto error;
+        }
+        token->type = TOKEN_BASIC_STRING;
+        token->head = cur + 1;
+        token->length = tail - (cur + 1);
+        token->opening = 1;
+        token->closing = 1;
+        lexer->cur = tail + 1;
+        lexer->mode = LEXER_KEY;
+        return;
+    case ACT_LITERAL_STRING:
+        if (((cur + 3) > end) && lexer->partial) {
+            goto incomplete;
+        }
+        if (((cur + 2) < end) && (*(cur + 1) == '\'') && (*(cur + 2) == '\'')) {
+            goto multiline;
+        }
+        tail = lex_literal_string(lexer, cur + 1);
+        if (tail == end) {
+            goto incomplete;
+        }
+        if ((tail == NULL) || !lex_utf8(lexer, cur + 1, tail)) {
+            goto error;
+        }
+        token->type = TOKEN_LITERAL_STRING;
+        token->head = cur + 1;
+        token->length = tail - (cur + 1);
+        token->opening = 1;
+        token->closing = 1;
+        lexer->cur = tail + 1;
+        lexer->mode = LEXER_KEY;
+        return;
+    case ACT_VALUE:
+        tail = cur + 1;
+        while ((tail < end) && ((char_stop_of(*tail) & STOP_VALUE) == 0)) {
+            ++tail;
+        }
+        /* a date-time may separate its date and time with a space. */
+        if (((tail - cur) == 10) && (cur[4] == '-') && (cur[7] == '-') && (tail < end) && (*tail == ' ')) {
+            if (((tail + 4) > end) && lexer->partial) {
+                goto incomplete;
+            }
+            if (((tail + 4) <= end) && is_digit(tail[1]) && is_digit(tail[2]) && (tail[3] == ':')) {
+                tail += 4;
+                while ((tail < end) && ((char_stop_of(*tail) & STOP_VALUE) == 0)) {
+                    ++tail;
+                }
+            }
+        }
+        if ((tail == end) && lexer->partial) {
+            goto incomplete;
+        }
+        token->type = TOKEN_VALUE;
+        lexer->mode = LEXER_KEY;
+        break;
+    default:
+        goto error;
+    }
+
+    token->length = tail - cur;
+    lexer->cur = tail;
+    return;
+
+multiline:
+    if (lexer->mode == LEXER_KEY) {
+        LEXER_ERROR(lexer, "multi-line strings cannot be keys");
+        goto error;
+    }
+    head = cur + 3;
+    /* a newline right after the opening quotes is trimmed. */
+    if ((head < end) && (*head == '\r')) {
+        if ((head + 1) == end) {
+            goto incomplete;
+        }
+        if (*(head + 1) == '\n') {
+            ++head;
+        }
+    }
+    if ((head < end) && (*head == '\n')) {
+        ++head;
+        ++lexer->line;
+    }
+    tail = lex_multiline_string(lexer, head, token, *cur);
+    if (tail == end) {
+        goto incomplete;
+    }
+    if ((tail == NULL) || !lex_utf8(lexer, head, tail)) {
+        goto error;
+    }
+    token->type = (*cur == '"') ? TOKEN_BASIC_STRING : TOKEN_LITERAL_STRING;
+    token->head = head;
+    token->length = tail - head;
+    token->opening = (uint8_t)(head - cur);
+    token->closing = 3;
+    lexer->cur = tail + 3;
+    lexer->mode = LEXER_KEY;
+    return;
+
+incomplete:
+    if (lexer->partial) {
+        token->type = TOKEN_INCOMPLETE;
+        lexer->cur = cur;
+        return;
+    }
+error:
+    token->type = TOKEN_ERROR;
+    lexer->cur = cur;
+}
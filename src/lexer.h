@@ -0,0 +1,90 @@
+/** @file       lexer.h
+ *  @brief      Tokenizer for TOML documents.
+ *
+ *  @author     t-kenji <protect.2501@gmail.com>
+ *  @date       2018-12-01 create new.
+ *  @copyright  Copyright © 2018 t-kenji
+ *
+ *  This code is licensed under the MIT License.
+ */
+#ifndef __CTOMAT_LEXER_H__
+#define __CTOMAT_LEXER_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "scan.h"
+
+#define LEXER_WINDOW_WORDS (64)
+#define LEXER_WINDOW_BYTES (LEXER_WINDOW_WORDS * SCAN_BLOCK_BYTES)
+
+enum lexer_mode {
+    LEXER_KEY,
+    LEXER_VALUE,
+};
+
+struct lexer {
+    const char *cur;
+    const char *end;
+    size_t line;
+    enum lexer_mode mode;
+    bool partial;               /**< more input may follow @c end. */
+    bool quiet;                 /**< do not report syntax errors. */
+    size_t nesting;             /**< arrays and inline tables left open. */
+    const char *window;         /**< input covered by @c bits. */
+    size_t window_length;
+    uint64_t bits[LEXER_WINDOW_WORDS]; /**< structural positions in the window. */
+};
+
+enum token_type {
+    TOKEN_EOF,
+    TOKEN_NEWLINE,
+    TOKEN_COMMENT,
+    TOKEN_BARE_KEY,
+    TOKEN_DOT,
+    TOKEN_EQUAL,
+    TOKEN_BASIC_STRING,
+    TOKEN_LITERAL_STRING,
+    TOKEN_TABLE_OPEN,         /**< '[' */
+    TOKEN_TABLE_CLOSE,        /**< ']' */
+    TOKEN_ARRAY_TABLE_OPEN,   /**< '[[' */
+    TOKEN_ARRAY_TABLE_CLOSE,  /**< ']]' */
+    TOKEN_ARRAY_OPEN,         /**< '[' of an array value */
+    TOKEN_ARRAY_CLOSE,        /**< ']' of an array value */
+    TOKEN_INLINE_TABLE_OPEN,  /**< '{' */
+    TOKEN_INLINE_TABLE_CLOSE, /**< '}' */
+    TOKEN_COMMA,
+    TOKEN_VALUE,
+    TOKEN_ERROR,
+    TOKEN_INCOMPLETE, /**< reached the end of partial input. */
+};
+
+/**
+ *  A token refers to the input; for strings @c head and @c length
+ *  cover the contents between the quotes, less the newline trimmed
+ *  after the opening quotes of a multi-line string.
+ */
+struct token {
+    enum token_type type;
+    const char *head;
+    size_t length;
+    bool escaped;    /**< basic string contains escape sequences. */
+    uint8_t opening; /**< bytes of the token before @c head. */
+    uint8_t closing; /**< bytes of the token after the contents. */
+};
+
+/**
+ *  Reports a syntax error at the current line, unless the lexer is quiet.
+ */
+#define LEXER_ERROR(lexer, format, ...)                                  \
+    do {                                                                 \
+        if (!(lexer)->quiet) {                                           \
+            ERROR("%zu: " format, (lexer)->line, ##__VA_ARGS__);         \
+        }                                                                \
+    } while (0)
+
+void lexer_init(struct lexer *lexer, const char *buf, size_t length);
+void lexer_next(struct lexer *lexer, struct token *token);
+
+#endif /* __CTOMAT_LEXER_H__ */
@@ -0,0 +1,803 @@
+/** @file       number.c
+ *  @brief      Number decoder and encoder.
+ *
+ *  Decimal digits are converted eight at a time within a 64-bit word
+ *  (SWAR), and range is checked from the digit count instead of at every
+ *  step.
+ *
+ *  Floats are converted with the Clinger fast path when the decimal is
+ *  exact in a double, and otherwise with the Eisel-Lemire algorithm on a
+ *  128-bit approximation of the power of ten. The rare inputs it cannot
+ *  decide are left to strtod() under the "C" locale.
+ *
+ *  Floats are written as the shortest decimal that reads back as the
+ *  same double, found with the Ryu algorithm.
+ *
+ *  @author     t-kenji <protect.2501@gmail.com>
+ *  @date       2018-12-05 create new.
+ *  @copyright  Copyright © 2018 t-kenji
+ *
+ *  This code is licensed under the MIT License.
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <locale.h>
+
+#include "debug.h"
+#include "number.h"
+#include "power5.h"
+#include "power5_split.h"
+
+#define DIGIT_INVALID (0xFF)
+#define DECIMAL_DIGITS_MAX (19) /**< digits of INT64_MIN; fewer always fit in 64 bits. */
+#define EXPONENT_MAX (100000)    /**< beyond any double, whatever the digits. */
+#define FALLBACK_BUFFER_BYTES (128)
+
+#define DOUBLE_MANTISSA_BITS (52)
+#define DOUBLE_INFINITE_POWER (0x7FF)
+#define DOUBLE_MINIMUM_EXPONENT (-1023)
+
+/**
+ *  value of a digit in bases up to 16.
+ */
+static const uint8_t digit_value[256] = {
+    [0x00 ... 0xFF] = DIGIT_INVALID,
+    ['0'] = 0, ['1'] = 1, ['2'] = 2, ['3'] = 3, ['4'] = 4,
+    ['5'] = 5, ['6'] = 6, ['7'] = 7, ['8'] = 8, ['9'] = 9,
+    ['A'] = 10, ['B'] = 11, ['C'] = 12, ['D'] = 13, ['E'] = 14, ['F'] = 15,
+    ['a'] = 10, ['b'] = 11, ['c'] = 12, ['d'] = 13, ['e'] = 14, ['f'] = 15,
+};
+
+#define digit_of(c) (digit_value[(uint8_t)(c)])
+
+/**
+ *  loads eight bytes with the first one in the lowest byte.
+ */
+static inline uint64_t load_eight(const char *str)
+{
+    uint64_t chunk;
+
+    memcpy(&chunk, str, sizeof(chunk));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    chunk = __builtin_bswap64(chunk);
+#endif
+
+    return chunk;
+}
+
+static inline bool is_eight_digits(uint64_t chunk)
+{
+    return ((chunk & 0xF0F0F0F0F0F0F0F0)
+            | (((chunk + 0x0606060606060606) & 0xF0F0F0F0F0F0F0F0) >> 4)) == 0x3333333333333333;
+}
+
+/**
+ *  value of eight decimal digits: pairs, then quadruples, then the whole
+ *  are combined with three multiplications.
+ */
+static inline uint32_t eight_digits_value(uint64_t chunk)
+{
+    const uint64_t mask = 0x000000FF000000FF;
+    const uint64_t mul1 = 100 + (1000000ULL << 32);
+    const uint64_t mul2 = 1 + (10000ULL << 32);
+
+    chunk -= 0x3030303030303030;
+    chunk = (chunk * 10) + (chunk >> 8);
+    chunk = (((chunk & mask) * mul1) + (((chunk >> 16) & mask) * mul2)) >> 32;
+
+    return (uint32_t)chunk;
+}
+
+/**
+ *  an underscore must be between two digits.
+ */
+static inline bool is_separator(const char *first, const char *cur, const char *end, unsigned int base)
+{
+    return (*cur == '_')
+           && (cur > first) && (digit_of(*(cur - 1)) < base)
+           && ((cur + 1) < end) && (digit_of(*(cur + 1)) < base);
+}
+
+static int parse_decimal(const char *cur, const char *end, bool negative, int64_t *value)
+{
+    const char *first = cur;
+    uint64_t acc = 0;
+    size_t digits = 0;
+    uint64_t chunk;
+
+    /* no leading zeros. */
+    if ((cur == end) || ((*cur == '0') && ((cur + 1) != end))) {
+        errno = EINVAL;
+        return -1;
+    }
+    while (cur < end) {
+        if (((end - cur) >= 8) && is_eight_digits(chunk = load_eight(cur))) {
+            digits += 8;
+            if (digits <= DECIMAL_DIGITS_MAX) {
+                acc = (acc * 100000000) + eight_digits_value(chunk);
+            }
+            cur += 8;
+        } else if (digit_of(*cur) < 10) {
+            if (++digits <= DECIMAL_DIGITS_MAX) {
+                acc = (acc * 10) + digit_of(*cur);
+            }
+            ++cur;
+        } else if (is_separator(first, cur, end, 10)) {
+            ++cur;
+        } else {
+            errno = EINVAL;
+            return -1;
+        }
+    }
+
+    uint64_t limit = negative ? ((uint64_t)INT64_MAX + 1) : (uint64_t)INT64_MAX;
+    if ((digits > DECIMAL_DIGITS_MAX) || (acc > limit)) {
+        errno = ERANGE;
+        return -1;
+    }
+    *value = negative ? (-(int64_t)(acc - 1) - 1) : (int64_t)acc;
+
+    return 0;
+}
+
+/**
+ *  @c shift is the bits per digit: 4, 3 or 1.
+ */
+static int parse_prefixed(const char *cur, const char *end, unsigned int shift, int64_t *value)
+{
+    const char *first = cur;
+    unsigned int base = 1u << shift;
+    uint64_t acc = 0;
+    bool overflow = false;
+
+    if (cur == end) {
+        errno = EINVAL;
+        return -1;
+    }
+    for (; cur < end; ++cur) {
+        unsigned int digit = digit_of(*cur);
+        if (digit < base) {
+            if ((acc >> (63 - shift)) != 0) {
+                overflow = true;
+            }
+            acc = (acc << shift) | digit;
+        } else if (!is_separator(first, cur, end, base)) {
+            errno = EINVAL;
+            return -1;
+        }
+    }
+    if (overflow) {
+        errno = ERANGE;
+        return -1;
+    }
+    *value = (int64_t)acc;
+
+    return 0;
+}
+
+int number_parse_integer(const char *str, size_t length, int64_t *value)
+{
+    const char *end = str + length;
+    bool negative = false;
+
+    if ((length > 2) && (str[0] == '0')) {
+        switch (str[1]) {
+        case 'x':
+            return parse_prefixed(str + 2, end, 4, value);
+        case 'o':
+            return parse_prefixed(str + 2, end, 3, value);
+        case 'b':
+            return parse_prefixed(str + 2, end, 1, value);
+        default:
+            break;
+        }
+    }
+    if ((length > 0) && ((*str == '+') || (*str == '-'))) {
+        negative = (*str == '-');
+        ++str;
+    }
+
+    return parse_decimal(str, end, negative, value);
+}
+
+/**
+ *  A decimal significand and exponent, as written.
+ */
+struct decimal {
+    uint64_t mantissa;  /**< the first DECIMAL_DIGITS_MAX significant digits. */
+    size_t digits;      /**< significant digits in @c mantissa. */
+    int64_t exponent;   /**< power of ten applying to @c mantissa. */
+    bool truncated;     /**< non-zero digits were dropped from @c mantissa. */
+};
+
+/**
+ *  @c fraction tells whether the digit is after the decimal point.
+ */
+static inline void decimal_push(struct decimal *decimal, unsigned int digit, bool fraction)
+{
+    if ((decimal->mantissa == 0) && (digit == 0)) {
+        /* leading zeros are not significant. */
+        decimal->exponent -= fraction ? 1 : 0;
+    } else if (decimal->digits < DECIMAL_DIGITS_MAX) {
+        decimal->mantissa = (decimal->mantissa * 10) + digit;
+        ++decimal->digits;
+        decimal->exponent -= fraction ? 1 : 0;
+    } else {
+        decimal->truncated |= (digit != 0);
+        decimal->exponent += fraction ? 0 : 1;
+    }
+}
+
+/**
+ *  Reads digits with '_' between them into @c decimal.
+ *
+ *  @return end of the digits, or NULL if they are malformed.
+ */
+static const char *decimal_digits(struct decimal *decimal, const char *cur, const char *end, bool fraction)
+{
+    const char *first = cur;
+    uint64_t chunk;
+
+    if ((cur == end) || (digit_of(*cur) >= 10)) {
+        return NULL;
+    }
+    while (cur < end) {
+        if ((decimal->mantissa != 0) && ((decimal->digits + 8) <= DECIMAL_DIGITS_MAX)
+            && ((end - cur) >= 8) && is_eight_digits(chunk = load_eight(cur))) {
+
+            decimal->mantissa = (decimal->mantissa * 100000000) + eight_digits_value(chunk);
+            decimal->digits += 8;
+            decimal->exponent -= fraction ? 8 : 0;
+            cur += 8;
+        } else if (digit_of(*cur) < 10) {
+            decimal_push(decimal, digit_of(*cur), fraction);
+            ++cur;
+        } else if (is_separator(first, cur, end, 10)) {
+            ++cur;
+        } else {
+            break;
+        }
+    }
+
+    return cur;
+}
+
+static inline uint64_t multiply_high(uint64_t a, uint64_t b, uint64_t *low)
+{
+    unsigned __int128 product = (unsigned __int128)a * b;
+
+    *low = (uint64_t)product;
+
+    return (uint64_t)(product >> 64);
+}
+
+/**
+ *  Eisel-Lemire: the double nearest to @c w * 10^@c q, from the 128-bit
+ *  approximation of the power in power5.h.
+ *
+ *  @return 0 on success, -1 if the approximation cannot decide the
+ *          rounding.
+ */
+static int eisel_lemire(uint64_t w, int64_t q, uint64_t *bits)
+{
+    if ((w == 0) || (q < POWER5_MIN)) {
+        *bits = 0;
+        return 0;
+    }
+    if (q > POWER5_MAX) {
+        *bits = (uint64_t)DOUBLE_INFINITE_POWER << DOUBLE_MANTISSA_BITS;
+        return 0;
+    }
+
+    const uint64_t *power = power5[q - POWER5_MIN];
+    int lz = __builtin_clzll(w);
+    uint64_t low;
+    uint64_t high;
+
+    w <<= lz;
+    high = multiply_high(w, power[0], &low);
+    /* the low bits decide the rounding: refine with the rest of the power. */
+    if ((high & 0x1FF) == 0x1FF) {
+        uint64_t second_low;
+        uint64_t second_high = multiply_high(w, power[1], &second_low);
+        low += second_high;
+        if (second_high > low) {
+            ++high;
+        }
+        if ((low == UINT64_MAX) && ((q < -27) || (q > 55))) {
+            return -1;
+        }
+    }
+
+    int upper = (int)(high >> 63);
+    int shift = upper + 64 - DOUBLE_MANTISSA_BITS - 3;
+    uint64_t mantissa = high >> shift;
+    int power2 = (int)((((152170 + 65536) * q) >> 16) + 63) + upper - lz - DOUBLE_MINIMUM_EXPONENT;
+
+    if (power2 <= 0) {
+        /* subnormal. */
+        if ((-power2 + 1) >= 64) {
+            *bits = 0;
+            return 0;
+        }
+        mantissa >>= -power2 + 1;
+        mantissa += (mantissa & 1);
+        mantissa >>= 1;
+        power2 = (mantissa < ((uint64_t)1 << DOUBLE_MANTISSA_BITS)) ? 0 : 1;
+        *bits = (mantissa & (((uint64_t)1 << DOUBLE_MANTISSA_BITS) - 1))
+                | ((uint64_t)power2 << DOUBLE_MANTISSA_BITS);
+        return 0;
+    }
+    /* exactly halfway: round to even. */
+    if ((low <= 1) && (q >= -4) && (q <= 23) && ((mantissa & 3) == 1)
+        && ((mantissa << shift) == high)) {
+
+        mantissa &= ~(uint64_t)1;
+    }
+    mantissa += (mantissa & 1);
+    mantissa >>= 1;
+    if (mantissa >= ((uint64_t)2 << DOUBLE_MANTISSA_BITS)) {
+        mantissa = (uint64_t)1 << DOUBLE_MANTISSA_BITS;
+        ++power2;
+    }
+    mantissa &= ~((uint64_t)1 << DOUBLE_MANTISSA_BITS);
+    if (power2 >= DOUBLE_INFINITE_POWER) {
+        power2 = DOUBLE_INFINITE_POWER;
+        mantissa = 0;
+    }
+    *bits = mantissa | ((uint64_t)power2 << DOUBLE_MANTISSA_BITS);
+
+    return 0;
+}
+
+static locale_t c_locale;
+
+__attribute__((constructor))
+static void number_init(void)
+{
+    c_locale = newlocale(LC_NUMERIC_MASK, "C", (locale_t)0);
+}
+
+/**
+ *  Converts with strtod() under the "C" locale, without the underscores.
+ */
+static int parse_float_fallback(const char *str, size_t length, double *value)
+{
+    char small[FALLBACK_BUFFER_BYTES];
+    char *buf = small;
+    size_t copied = 0;
+
+    if (c_locale == (locale_t)0) {
+        errno = ENOMEM;
+        return -1;
+    }
+    if (length >= sizeof(small)) {
+        buf = malloc(length + 1);
+        if (buf == NULL) {
+            return -1;
+        }
+    }
+    for (size_t i = 0; i < length; ++i) {
+        if (str[i] != '_') {
+            buf[copied++] = str[i];
+        }
+    }
+    buf[copied] = '\0';
+
+    locale_t old = uselocale(c_locale);
+    *value = strtod(buf, NULL);
+    uselocale(old);
+
+    if (buf != small) {
+        free(buf);
+    }
+
+    return 0;
+}
+
+static const double exact_powers[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+/**
+ *  @return 0 on success, -1 if the decimal needs the fallback.
+ */
+static int decimal_to_double(const struct decimal *decimal, double *result)
+{
+    uint64_t bits;
+    uint64_t above;
+
+    if ((decimal->mantissa <= ((uint64_t)1 << 53)) && !decimal->truncated
+        && (decimal->exponent >= -22) && (decimal->exponent <= 22)) {
+        /* both are exact, so one rounding gives the nearest double. */
+        *result = (double)decimal->mantissa;
+        if (decimal->exponent < 0) {
+            *result /= exact_powers[-decimal->exponent];
+        } else {
+            *result *= exact_powers[decimal->exponent];
+        }
+        return 0;
+    }
+    if (eisel_lemire(decimal->mantissa, decimal->exponent, &bits) != 0) {
+        return -1;
+    }
+    /* the digits dropped may round either way. */
+    if (decimal->truncated
+        && ((eisel_lemire(decimal->mantissa + 1, decimal->exponent, &above) != 0) || (above != bits))) {
+
+        return -1;
+    }
+    memcpy(result, &bits, sizeof(*result));
+
+    return 0;
+}
+
+int number_parse_float(const char *str, size_t length, double *value)
+{
+    const char *cur = str;
+    const char *end = str + length;
+    struct decimal decimal = {0};
+    bool negative = false;
+    double result;
+
+    if ((cur < end) && ((*cur == '+') || (*cur == '-'))) {
+        negative = (*cur == '-');
+        ++cur;
+    }
+    if (((end - cur) == 3) && ((memcmp(cur, "inf", 3) == 0) || (memcmp(cur, "nan", 3) == 0))) {
+        result = (*cur == 'i') ? INFINITY : NAN;
+        *value = negative ? -result : result;
+        return 0;
+    }
+
+    /* no leading zeros in the integer part. */
+    if (((end - cur) > 1) && (*cur == '0') && ((digit_of(*(cur + 1)) < 10) || (*(cur + 1) == '_'))) {
+        errno = EINVAL;
+        return -1;
+    }
+    cur = decimal_digits(&decimal, cur, end, false);
+    const char *integer_end = cur;
+    if ((cur != NULL) && (cur < end) && (*cur == '.')) {
+        cur = decimal_digits(&decimal, cur + 1, end, true);
+    }
+    if ((cur != NULL) && (cur < end) && ((*cur == 'e') || (*cur == 'E'))) {
+        const char *first;
+        bool negative_exponent = false;
+        int64_t exponent = 0;
+
+        ++cur;
+        if ((cur < end) && ((*cur == '+') || (*cur == '-'))) {
+            negative_exponent = (*cur == '-');
+            ++cur;
+        }
+        first = cur;
+        if ((cur == end) || (digit_of(*cur) >= 10)) {
+            cur = NULL;
+        }
+        for (; (cur != NULL) && (cur < end); ++cur) {
+            if (digit_of(*cur) < 10) {
+                if (exponent < EXPONENT_MAX) {
+                    exponent = (exponent * 10) + digit_of(*cur);
+                }
+            } else if (!is_separator(first, cur, end, 10)) {
+                break;
+            }
+        }
+        decimal.exponent += negative_exponent ? -exponent : exponent;
+    }
+    /* without a fraction or an exponent, it is an integer. */
+    if ((cur == NULL) || (cur != end) || (cur == integer_end)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (decimal_to_double(&decimal, &result) != 0) {
+        if (parse_float_fallback(str, length, &result) != 0) {
+            return -1;
+        }
+        result = fabs(result);
+    }
+    if (isinf(result)) {
+        errno = ERANGE;
+        return -1;
+    }
+    *value = negative ? -result : result;
+
+    return 0;
+}
+
+/*
+ *  Encoders. Digits are written two at a time from a table of "00" to
+ *  "99", from the end of the number.
+ */
+
+static const char digit_pairs[200] = {
+    '0', '0', '0', '1', '0', '2', '0', '3', '0', '4', '0', '5', '0', '6', '0', '7', '0', '8', '0', '9',
+    '1', '0', '1', '1', '1', '2', '1', '3', '1', '4', '1', '5', '1', '6', '1', '7', '1', '8', '1', '9',
+    '2', '0', '2', '1', '2', '2', '2', '3', '2', '4', '2', '5', '2', '6', '2', '7', '2', '8', '2', '9',
+    '3', '0', '3', '1', '3', '2', '3', '3', '3', '4', '3', '5', '3', '6', '3', '7', '3', '8', '3', '9',
+    '4', '0', '4', '1', '4', '2', '4', '3', '4', '4', '4', '5', '4', '6', '4', '7', '4', '8', '4', '9',
+    '5', '0', '5', '1', '5', '2', '5', '3', '5', '4', '5', '5', '5', '6', '5', '7', '5', '8', '5', '9',
+    '6', '0', '6', '1', '6', '2', '6', '3', '6', '4', '6', '5', '6', '6', '6', '7', '6', '8', '6', '9',
+    '7', '0', '7', '1', '7', '2', '7', '3', '7', '4', '7', '5', '7', '6', '7', '7', '7', '8', '7', '9',
+    '8', '0', '8', '1', '8', '2', '8', '3', '8', '4', '8', '5', '8', '6', '8', '7', '8', '8', '8', '9',
+    '9', '0', '9', '1', '9', '2', '9', '3', '9', '4', '9', '5', '9', '6', '9', '7', '9', '8', '9', '9',
+};
+
+static unsigned int decimal_length(uint64_t value)
+{
+    unsigned int length = 1;
+
+    for (; value >= 10000; value /= 10000) {
+        length += 4;
+    }
+    return length + (value >= 10) + (value >= 100) + (value >= 1000);
+}
+
+/**
+ *  Writes the @c length digits of @c value ending at @c end.
+ */
+static void write_digits(char *end, uint64_t value, unsigned int length)
+{
+    for (; length >= 2; length -= 2) {
+        unsigned int pair = (unsigned int)(value % 100) * 2;
+        value /= 100;
+        *--end = digit_pairs[pair + 1];
+        *--end = digit_pairs[pair];
+    }
+    if (length > 0) {
+        *--end = (char)('0' + value);
+    }
+}
+
+size_t number_format_integer(int64_t value, char *buf)
+{
+    /* negated as unsigned, so that INT64_MIN does not overflow. */
+    uint64_t magnitude = (value < 0) ? (0 - (uint64_t)value) : (uint64_t)value;
+    unsigned int length = decimal_length(magnitude);
+    size_t sign = (value < 0);
+
+    buf[0] = '-';
+    write_digits(buf + sign + length, magnitude, length);
+    buf[sign + length] = '\0';
+
+    return sign + length;
+}
+
+/*
+ *  Floats are written with the Ryu algorithm of Ulf Adams: the interval
+ *  of decimals that read back as the double is computed in fixed point,
+ *  and digits are removed while both ends still differ. What is left is
+ *  the shortest decimal in the interval, and the closest one if several
+ *  are as short.
+ */
+
+static inline unsigned int power5_bits(unsigned int e)
+{
+    return ((e * 1217359) >> 19) + 1;
+}
+
+static inline unsigned int log10_power2(unsigned int e)
+{
+    return (e * 78913) >> 18;
+}
+
+static inline unsigned int log10_power5(unsigned int e)
+{
+    return (e * 732923) >> 20;
+}
+
+static inline bool is_multiple_of_power5(uint64_t value, unsigned int p)
+{
+    unsigned int count = 0;
+
+    for (; (value % 5) == 0; value /= 5) {
+        ++count;
+    }
+    return count >= p;
+}
+
+static inline bool is_multiple_of_power2(uint64_t value, unsigned int p)
+{
+    return (value & ((UINT64_C(1) << p) - 1)) == 0;
+}
+
+/**
+ *  (@c m * @c mul) >> @c shift, for a 125-bit @c mul and a @c shift of
+ *  64 or more.
+ */
+static inline uint64_t multiply_shift(uint64_t m, const uint64_t mul[2], unsigned int shift)
+{
+    unsigned __int128 low = (unsigned __int128)m * mul[1];
+    unsigned __int128 high = (unsigned __int128)m * mul[0];
+
+    return (uint64_t)(((low >> 64) + high) >> (shift - 64));
+}
+
+/**
+ *  Shortest decimal @c digits * 10^@c exponent of a finite, positive
+ *  double given by its fields.
+ */
+static void shortest_decimal(uint64_t mantissa, unsigned int power2, uint64_t *digits, int *exponent)
+{
+    int e2;
+    uint64_t m2;
+
+    if (power2 == 0) {
+        e2 = 1 + DOUBLE_MINIMUM_EXPONENT - DOUBLE_MANTISSA_BITS - 2;
+        m2 = mantissa;
+    } else {
+        e2 = (int)power2 + DOUBLE_MINIMUM_EXPONENT - DOUBLE_MANTISSA_BITS - 2;
+        m2 = (UINT64_C(1) << DOUBLE_MANTISSA_BITS) | mantissa;
+    }
+    bool even = (m2 & 1) == 0;
+    uint64_t mv = 4 * m2;
+    /* the interval is narrower below a power of two. */
+    unsigned int mm_shift = (mantissa != 0) || (power2 <= 1);
+
+    uint64_t vr;
+    uint64_t vp;
+    uint64_t vm;
+    int e10;
+    bool vm_zeros = false;
+    bool vr_zeros = false;
+
+    if (e2 >= 0) {
+        unsigned int q = log10_power2(e2) - (e2 > 3);
+        unsigned int k = POWER5_SPLIT_BITS + power5_bits(q) - 1;
+        unsigned int i = -e2 + q + k;
+
+        e10 = (int)q;
+        vr = multiply_shift(4 * m2, power5_inv_split[q], i);
+        vp = multiply_shift((4 * m2) + 2, power5_inv_split[q], i);
+        vm = multiply_shift((4 * m2) - 1 - mm_shift, power5_inv_split[q], i);
+        if (q <= 21) {
+            if ((mv % 5) == 0) {
+                vr_zeros = is_multiple_of_power5(mv, q);
+            } else if (even) {
+                vm_zeros = is_multiple_of_power5(mv - 1 - mm_shift, q);
+            } else {
+                vp -= is_multiple_of_power5(mv + 2, q);
+            }
+        }
+    } else {
+        unsigned int q = log10_power5(-e2) - (-e2 > 1);
+        unsigned int i = -e2 - q;
+        int k = (int)power5_bits(i) - POWER5_SPLIT_BITS;
+        unsigned int j = q - k;
+
+        e10 = (int)q + e2;
+        vr = multiply_shift(4 * m2, power5_split[i], j);
+        vp = multiply_shift((4 * m2) + 2, power5_split[i], j);
+        vm = multiply_shift((4 * m2) - 1 - mm_shift, power5_split[i], j);
+        if (q <= 1) {
+            vr_zeros = true;
+            if (even) {
+                vm_zeros = (mm_shift == 1);
+            } else {
+                --vp;
+            }
+        } else if (q < 63) {
+            vr_zeros = is_multiple_of_power2(mv, q);
+        }
+    }
+
+    int removed = 0;
+    unsigned int last = 0;
+    uint64_t output;
+
+    if (vm_zeros || vr_zeros) {
+        /* exact ends or a tie need the digits removed so far. */
+        for (; (vp / 10) > (vm / 10); vr /= 10, vp /= 10, vm /= 10, ++removed) {
+            vm_zeros &= (vm % 10) == 0;
+            vr_zeros &= (last == 0);
+            last = (unsigned int)(vr % 10);
+        }
+        if (vm_zeros) {
+            for (; (vm % 10) == 0; vr /= 10, vp /= 10, vm /= 10, ++removed) {
+                vr_zeros &= (last == 0);
+                last = (unsigned int)(vr % 10);
+            }
+        }
+        if (vr_zeros && (last == 5) && ((vr % 2) == 0)) {
+            /* round half to even. */
+            last = 4;
+        }
+        output = vr + (((vr == vm) && (!even || !vm_zeros)) || (last >= 5));
+    } else {
+        bool round_up = false;
+
+        if ((vp / 100) > (vm / 100)) {
+            round_up = (vr % 100) >= 50;
+            vr /= 100;
+            vp /= 100;
+            vm /= 100;
+            removed += 2;
+        }
+        for (; (vp / 10) > (vm / 10); vr /= 10, vp /= 10, vm /= 10, ++removed) {
+            round_up = (vr % 10) >= 5;
+        }
+        output = vr + ((vr == vm) || round_up);
+    }
+
+    *digits = output;
+    *exponent = e10 + removed;
+}
+
+size_t number_format_float(double value, char *buf)
+{
+    uint64_t bits;
+    char *cur = buf;
+
+    memcpy(&bits, &value, sizeof(bits));
+    if ((bits >> 63) != 0) {
+        *cur++ = '-';
+    }
+    if (isnan(value)) {
+        /* TOML has no payloads, and the sign of nan is not kept. */
+        memcpy(buf, "nan", 4);
+        return 3;
+    }
+    if (isinf(value)) {
+        memcpy(cur, "inf", 4);
+        return (cur - buf) + 3;
+    }
+    if (value == 0) {
+        memcpy(cur, "0.0", 4);
+        return (cur - buf) + 3;
+    }
+
+    uint64_t digits;
+    int exponent;
+    shortest_decimal(bits & ((UINT64_C(1) << DOUBLE_MANTISSA_BITS) - 1),
+                     (unsigned int)((bits >> DOUBLE_MANTISSA_BITS) & DOUBLE_INFINITE_POWER),
+                     &digits, &exponent);
+
+    int length = (int)decimal_length(digits);
+    int point = length + exponent; /* digits before the decimal point. */
+
+    if ((point > 0) && (point <= 16)) {
+        /* 1.5, 100.0 */
+        if (exponent >= 0) {
+            write_digits(cur + length, digits, length);
+            memset(cur + length, '0', exponent);
+            cur += point;
+            memcpy(cur, ".0", 2);
+            cur += 2;
+        } else {
+            write_digits(cur + length + 1, digits, length);
+            memmove(cur, cur + 1, point);
+            cur[point] = '.';
+            cur += length + 1;
+        }
+    } else if ((point <= 0) && (point > -5)) {
+        /* 0.001 */
+        memcpy(cur, "0.", 2);
+        memset(cur + 2, '0', -point);
+        cur += 2 - point;
+        write_digits(cur + length, digits, length);
+        cur += length;
+    } else {
+        /* 1e300, 1.5e-7 */
+        write_digits(cur + length + 1, digits, length);
+        cur[0] = cur[1];
+        if (length > 1) {
+            cur[1] = '.';
+            cur += length + 1;
+        } else {
+            cur += 1;
+        }
+        *cur++ = 'e';
+        cur += number_format_integer(point - 1, cur);
+    }
+    *cur = '\0';
+
+    return cur - buf;
+}
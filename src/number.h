@@ -0,0 +1,55 @@
+/** @file       number.h
+ *  @brief      Number decoder and encoder.
+ *
+ *  @author     t-kenji <protect.2501@gmail.com>
+ *  @date       2018-12-05 create new.
+ *  @copyright  Copyright © 2018 t-kenji
+ *
+ *  This code is licensed under the MIT License.
+ */
+#ifndef __CTOMAT_NUMBER_H__
+#define __CTOMAT_NUMBER_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define NUMBER_TEXT_BYTES (32) /**< longest text of the encoders, NUL included. */
+
+/**
+ *  Decodes a TOML integer: decimal with an optional sign, or hexadecimal,
+ *  octal or binary with a 0x, 0o or 0b prefix, and '_' between digits.
+ *  @c str need not be NUL-terminated.
+ *
+ *  @return 0 on success, or -1 with errno set to EINVAL if @c str is not
+ *          an integer, or to ERANGE if it does not fit in 64 bits.
+ */
+int number_parse_integer(const char *str, size_t length, int64_t *value);
+
+/**
+ *  Decodes a TOML float: a decimal with a fraction, an exponent or both,
+ *  '_' between digits, or inf and nan with an optional sign. The result
+ *  is correctly rounded and does not depend on the locale.
+ *
+ *  @return 0 on success, or -1 with errno set to EINVAL if @c str is not
+ *          a float, or to ERANGE if it is too large for a double.
+ */
+int number_parse_float(const char *str, size_t length, double *value);
+
+/**
+ *  Writes @c value in decimal into @c buf of at least NUMBER_TEXT_BYTES.
+ *
+ *  @return length of the text.
+ */
+size_t number_format_integer(int64_t value, char *buf);
+
+/**
+ *  Writes @c value as a TOML float into @c buf of at least
+ *  NUMBER_TEXT_BYTES: the shortest decimal that number_parse_float()
+ *  reads back as the same double, with a fraction or an exponent so
+ *  that it is not taken for an integer.
+ *
+ *  @return length of the text.
+ */
+size_t number_format_float(double value, char *buf);
+
+#endif /* __CTOMAT_NUMBER_H__ */
@@ -0,0 +1,349 @@
+/** @file       scan.c
+ *  @brief      Structural character scanner.
+ *
+ *  Classifies 64 bytes at a time into a bitmap of structural positions, in
+ *  the manner of simdjson stage 1. The vector implementation is selected at
+ *  startup from the features of the running CPU.
+ *
+ *  The UTF-8 validator is the lookup algorithm of Keiser and Lemire,
+ *  which classifies every byte pair by three nibble tables.
+ *
+ *  @author     t-kenji <protect.2501@gmail.com>
+ *  @date       2018-12-03 create new.
+ *  @copyright  Copyright © 2018 t-kenji
+ *
+ *  This code is licensed under the MIT License.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SCAN_X86 (1)
+#else
+#define SCAN_X86 (0)
+#endif
+
+#include "debug.h"
+#include "scan.h"
+
+static inline uint64_t scan_block_scalar(const char *buf, size_t length)
+{
+    uint64_t mask = 0;
+
+    for (size_t i = 0; i < length; ++i) {
+        uint8_t c = (uint8_t)buf[i];
+        if (((c < 0x20) && (c != '\t')) || (c == 0x7F)
+            || (c == '=') || (c == '#') || (c == '"') || (c == '\'')
+            || (c == '[') || (c == '\\')) {
+
+            mask |= (uint64_t)1 << i;
+        }
+    }
+
+    return mask;
+}
+
+static void scan_scalar(const char *buf, size_t length, uint64_t *bits)
+{
+    size_t blocks = length / SCAN_BLOCK_BYTES;
+
+    for (size_t i = 0; i < blocks; ++i) {
+        bits[i] = scan_block_scalar(buf + (i * SCAN_BLOCK_BYTES), SCAN_BLOCK_BYTES);
+    }
+    if ((length % SCAN_BLOCK_BYTES) != 0) {
+        bits[blocks] = scan_block_scalar(buf + (blocks * SCAN_BLOCK_BYTES), length % SCAN_BLOCK_BYTES);
+    }
+}
+
+static bool utf8_scalar(const char *buf, size_t length)
+{
+    const uint8_t *s = (const uint8_t *)buf;
+    size_t i = 0;
+
+    while (i < length) {
+        uint64_t word;
+
+        if ((i + sizeof(word)) <= length) {
+            memcpy(&word, s + i, sizeof(word));
+            if ((word & UINT64_C(0x8080808080808080)) == 0) {
+                i += sizeof(word);
+                continue;
+            }
+        }
+        if (s[i] < 0x80) {
+            ++i;
+            continue;
+        }
+
+        size_t n;
+        uint32_t min;
+        if ((s[i] & 0xE0) == 0xC0) {
+            n = 2;
+            min = 0x80;
+        } else if ((s[i] & 0xF0) == 0xE0) {
+            n = 3;
+            min = 0x800;
+        } else if ((s[i] & 0xF8) == 0xF0) {
+            n = 4;
+            min = 0x10000;
+        } else {
+            return false;
+        }
+        if ((i + n) > length) {
+            return false;
+        }
+        uint32_t codepoint = s[i] & (0x7F >> n);
+        for (size_t k = 1; k < n; ++k) {
+            if ((s[i + k] & 0xC0) != 0x80) {
+                return false;
+            }
+            codepoint = (codepoint << 6) | (s[i + k] & 0x3F);
+        }
+        if ((codepoint < min) || (codepoint > 0x10FFFF) || ((codepoint >= 0xD800) && (codepoint <= 0xDFFF))) {
+            return false;
+        }
+        i += n;
+    }
+
+    return true;
+}
+
+#if SCAN_X86
+__attribute__((target("sse2")))
+static inline uint32_t scan_vector_sse2(__m128i v)
+{
+    __m128i control = _mm_cmpeq_epi8(_mm_min_epu8(v, _mm_set1_epi8(0x1F)), v);
+    control = _mm_andnot_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\t')), control);
+    __m128i marks = _mm_or_si128(control, _mm_cmpeq_epi8(v, _mm_set1_epi8(0x7F)));
+    marks = _mm_or_si128(marks, _mm_cmpeq_epi8(v, _mm_set1_epi8('=')));
+    marks = _mm_or_si128(marks, _mm_cmpeq_epi8(v, _mm_set1_epi8('#')));
+    marks = _mm_or_si128(marks, _mm_cmpeq_epi8(v, _mm_set1_epi8('"')));
+    marks = _mm_or_si128(marks, _mm_cmpeq_epi8(v, _mm_set1_epi8('\'')));
+    marks = _mm_or_si128(marks, _mm_cmpeq_epi8(v, _mm_set1_epi8('[')));
+    marks = _mm_or_si128(marks, _mm_cmpeq_epi8(v, _mm_set1_epi8('\\')));
+
+    return (uint32_t)_mm_movemask_epi8(marks);
+}
+
+__attribute__((target("sse2")))
+static void scan_sse2(const char *buf, size_t length, uint64_t *bits)
+{
+    size_t blocks = length / SCAN_BLOCK_BYTES;
+
+    for (size_t i = 0; i < blocks; ++i) {
+        const __m128i *block = (const __m128i *)(buf + (i * SCAN_BLOCK_BYTES));
+        uint64_t m0 = scan_vector_sse2(_mm_loadu_si128(block + 0));
+        uint64_t m1 = scan_vector_sse2(_mm_loadu_si128(block + 1));
+        uint64_t m2 = scan_vector_sse2(_mm_loadu_si128(block + 2));
+        uint64_t m3 = scan_vector_sse2(_mm_loadu_si128(block + 3));
+        bits[i] = m0 | (m1 << 16) | (m2 << 32) | (m3 << 48);
+    }
+    if ((length % SCAN_BLOCK_BYTES) != 0) {
+        bits[blocks] = scan_block_scalar(buf + (blocks * SCAN_BLOCK_BYTES), length % SCAN_BLOCK_BYTES);
+    }
+}
+
+__attribute__((target("avx2")))
+static inline uint32_t scan_vector_avx2(__m256i v)
+{
+    __m256i control = _mm256_cmpeq_epi8(_mm256_min_epu8(v, _mm256_set1_epi8(0x1F)), v);
+    control = _mm256_andnot_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\t')), control);
+    __m256i marks = _mm256_or_si256(control, _mm256_cmpeq_epi8(v, _mm256_set1_epi8(0x7F)));
+    marks = _mm256_or_si256(marks, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('=')));
+    marks = _mm256_or_si256(marks, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('#')));
+    marks = _mm256_or_si256(marks, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('"')));
+    marks = _mm256_or_si256(marks, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\'')));
+    marks = _mm256_or_si256(marks, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('[')));
+    marks = _mm256_or_si256(marks, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\\')));
+
+    return (uint32_t)_mm256_movemask_epi8(marks);
+}
+
+__attribute__((target("avx2")))
+static void scan_avx2(const char *buf, size_t length, uint64_t *bits)
+{
+    size_t blocks = length / SCAN_BLOCK_BYTES;
+
+    for (size_t i = 0; i < blocks; ++i) {
+        const __m256i *block = (const __m256i *)(buf + (i * SCAN_BLOCK_BYTES));
+        uint64_t lo = scan_vector_avx2(_mm256_loadu_si256(block + 0));
+        uint64_t hi = scan_vector_avx2(_mm256_loadu_si256(block + 1));
+        bits[i] = lo | (hi << 32);
+    }
+    if ((length % SCAN_BLOCK_BYTES) != 0) {
+        bits[blocks] = scan_block_scalar(buf + (blocks * SCAN_BLOCK_BYTES), length % SCAN_BLOCK_BYTES);
+    }
+}
+
+/*
+ *  Error bits of the UTF-8 lookup tables; a byte pair is invalid when
+ *  the three tables agree on a bit.
+ */
+#define UTF8_TOO_SHORT  (0x01) /**< lead byte not followed by a continuation. */
+#define UTF8_TOO_LONG   (0x02) /**< continuation after ASCII. */
+#define UTF8_OVERLONG_3 (0x04)
+#define UTF8_TOO_LARGE  (0x08) /**< beyond U+10FFFF. */
+#define UTF8_SURROGATE  (0x10)
+#define UTF8_OVERLONG_2 (0x20)
+#define UTF8_TOO_LARGE_1000 (0x40)
+#define UTF8_OVERLONG_4 (0x40)
+#define UTF8_TWO_CONTS  (0x80) /**< valid only as the 3rd or 4th byte. */
+#define UTF8_CARRY (UTF8_TOO_SHORT | UTF8_TOO_LONG | UTF8_TWO_CONTS)
+
+#define UTF8_TABLE(...) _mm256_setr_epi8(__VA_ARGS__, __VA_ARGS__)
+
+/**
+ *  @c input shifted by @c n bytes, with the last bytes of @c prev in front.
+ */
+#define UTF8_PREV_AVX2(input, prev, n) \
+    _mm256_alignr_epi8((input), _mm256_permute2x128_si256((prev), (input), 0x21), 16 - (n))
+
+__attribute__((target("avx2")))
+static inline __m256i utf8_errors_avx2(__m256i input, __m256i prev)
+{
+    const __m256i byte_1_high = UTF8_TABLE(
+        UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG,
+        UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG,
+        UTF8_TWO_CONTS, UTF8_TWO_CONTS, UTF8_TWO_CONTS, UTF8_TWO_CONTS,
+        UTF8_TOO_SHORT | UTF8_OVERLONG_2,
+        UTF8_TOO_SHORT,
+        UTF8_TOO_SHORT | UTF8_OVERLONG_3 | UTF8_SURROGATE,
+        UTF8_TOO_SHORT | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000 | UTF8_OVERLONG_4);
+    const __m256i byte_1_low = UTF8_TABLE(
+        UTF8_CARRY | UTF8_OVERLONG_3 | UTF8_OVERLONG_2 | UTF8_OVERLONG_4,
+        UTF8_CARRY | UTF8_OVERLONG_2,
+        UTF8_CARRY,
+        UTF8_CARRY,
+        UTF8_CARRY | UTF8_TOO_LARGE,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000 | UTF8_SURROGATE,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+        UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000);
+    const __m256i byte_2_high = UTF8_TABLE(
+        UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT,
+        UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT,
+        UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_OVERLONG_3 | UTF8_TOO_LARGE_1000 | UTF8_OVERLONG_4,
+        UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_OVERLONG_3 | UTF8_TOO_LARGE,
+        UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_SURROGATE | UTF8_TOO_LARGE,
+        UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_SURROGATE | UTF8_TOO_LARGE,
+        UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT);
+    const __m256i nibble = _mm256_set1_epi8(0x0F);
+
+    __m256i prev1 = UTF8_PREV_AVX2(input, prev, 1);
+    __m256i special = _mm256_and_si256(
+        _mm256_and_si256(
+            _mm256_shuffle_epi8(byte_1_high, _mm256_and_si256(_mm256_srli_epi16(prev1, 4), nibble)),
+            _mm256_shuffle_epi8(byte_1_low, _mm256_and_si256(prev1, nibble))),
+        _mm256_shuffle_epi8(byte_2_high, _mm256_and_si256(_mm256_srli_epi16(input, 4), nibble)));
+
+    /* two continuations in a row are fine after a 3 or 4 byte lead. */
+    __m256i third = _mm256_subs_epu8(UTF8_PREV_AVX2(input, prev, 2), _mm256_set1_epi8((char)(0xE0 - 0x80)));
+    __m256i fourth = _mm256_subs_epu8(UTF8_PREV_AVX2(input, prev, 3), _mm256_set1_epi8((char)(0xF0 - 0x80)));
+    __m256i must23 = _mm256_and_si256(_mm256_or_si256(third, fourth), _mm256_set1_epi8((char)0x80));
+
+    return _mm256_xor_si256(must23, special);
+}
+
+/**
+ *  non-zero where a sequence starting in the last bytes of @c input
+ *  continues past it.
+ */
+__attribute__((target("avx2")))
+static inline __m256i utf8_incomplete_avx2(__m256i input)
+{
+    const __m256i max = _mm256_setr_epi8(
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        (char)(0xF0 - 1), (char)(0xE0 - 1), (char)(0xC0 - 1));
+
+    return _mm256_subs_epu8(input, max);
+}
+
+__attribute__((target("avx2")))
+static bool utf8_avx2(const char *buf, size_t length)
+{
+    __m256i error = _mm256_setzero_si256();
+    __m256i prev = _mm256_setzero_si256();
+    __m256i incomplete = _mm256_setzero_si256();
+    size_t i = 0;
+
+    for (;;) {
+        __m256i input;
+
+        if ((i + sizeof(input)) <= length) {
+            input = _mm256_loadu_si256((const __m256i *)(buf + i));
+        } else if (i < length) {
+            /* the padding is ASCII, which ends any sequence left open. */
+            char tail[sizeof(input)] = {0};
+            memcpy(tail, buf + i, length - i);
+            input = _mm256_loadu_si256((const __m256i *)tail);
+        } else {
+            break;
+        }
+        if (_mm256_movemask_epi8(input) == 0) {
+            error = _mm256_or_si256(error, incomplete);
+            incomplete = _mm256_setzero_si256();
+        } else {
+            error = _mm256_or_si256(error, utf8_errors_avx2(input, prev));
+            incomplete = utf8_incomplete_avx2(input);
+        }
+        prev = input;
+        i += sizeof(input);
+    }
+    error = _mm256_or_si256(error, incomplete);
+
+    return _mm256_testz_si256(error, error) != 0;
+}
+#endif
+
+static struct {
+    const char *name;
+    void (*scan)(const char *, size_t, uint64_t *);
+    bool (*utf8)(const char *, size_t);
+} scanner = {
+    .name = "scalar",
+    .scan = scan_scalar,
+    .utf8 = utf8_scalar,
+};
+
+__attribute__((constructor))
+static void scan_select(void)
+{
+#if SCAN_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        scanner.name = "avx2";
+        scanner.scan = scan_avx2;
+        scanner.utf8 = utf8_avx2;
+    } else if (__builtin_cpu_supports("sse2")) {
+        scanner.name = "sse2";
+        scanner.scan = scan_sse2;
+    }
+#endif
+}
+
+void scan_structurals(const char *buf, size_t length, uint64_t *bits)
+{
+    scanner.scan(buf, length, bits);
+}
+
+bool scan_utf8(const char *buf, size_t length)
+{
+    return scanner.utf8(buf, length);
+}
+
+const char *scan_implementation(void)
+{
+    return scanner.name;
+}
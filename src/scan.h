@@ -0,0 +1,40 @@
+/** @file       scan.h
+ *  @brief      Structural character scanner.
+ *
+ *  @author     t-kenji <protect.2501@gmail.com>
+ *  @date       2018-12-03 create new.
+ *  @copyright  Copyright © 2018 t-kenji
+ *
+ *  This code is licensed under the MIT License.
+ */
+#ifndef __CTOMAT_SCAN_H__
+#define __CTOMAT_SCAN_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define SCAN_BLOCK_BYTES (64)
+
+/**
+ *  Marks structural bytes of @c buf in @c bits, one bit per byte and
+ *  64 bytes per word. Structural bytes are '=', '#', '"', '\'', '[', '\\'
+ *  and control characters other than tab (which include LF and CR).
+ *
+ *  @c bits must have room for ((length + 63) / 64) words; bits past
+ *  @c length are cleared.
+ */
+void scan_structurals(const char *buf, size_t length, uint64_t *bits);
+
+/**
+ *  Tells whether @c buf is well-formed UTF-8: no overlong forms,
+ *  surrogates or code points beyond U+10FFFF.
+ */
+bool scan_utf8(const char *buf, size_t length);
+
+/**
+ *  Name of the implementation selected for this CPU.
+ */
+const char *scan_implementation(void);
+
+#endif /* __CTOMAT_SCAN_H__ */
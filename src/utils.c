@@ -74,3 +74,82 @@ bool string_match(const char *pat, const char *str)
 
     return internal_string_match(pat, str, false, false, case_sensitive);
 }
+
+#define XXH_PRIME1 UINT64_C(0x9E3779B185EBCA87)
+#define XXH_PRIME2 UINT64_C(0xC2B2AE3D27D4EB4F)
+#define XXH_PRIME3 UINT64_C(0x165667B19E3779F9)
+#define XXH_PRIME4 UINT64_C(0x85EBCA77C2B2AE63)
+#define XXH_PRIME5 UINT64_C(0x27D4EB2F165667C5)
+
+static inline uint64_t rotl64(uint64_t value, unsigned int count)
+{
+    return (value << count) | (value >> (64 - count));
+}
+
+static inline uint64_t read64(const uint8_t *p)
+{
+    uint64_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static inline uint64_t xxh_round(uint64_t acc, uint64_t input)
+{
+    return rotl64(acc + (input * XXH_PRIME2), 31) * XXH_PRIME1;
+}
+
+static inline uint64_t xxh_merge(uint64_t acc, uint64_t value)
+{
+    return ((acc ^ xxh_round(0, value)) * XXH_PRIME1) + XXH_PRIME4;
+}
+
+uint64_t hash64(const void *buf, size_t length)
+{
+    const uint8_t *p = (const uint8_t *)buf;
+    const uint8_t *end = p + length;
+    uint64_t hash;
+
+    if (length >= 32) {
+        /* four independent lanes over 32-byte stripes. */
+        uint64_t v1 = XXH_PRIME1 + XXH_PRIME2;
+        uint64_t v2 = XXH_PRIME2;
+        uint64_t v3 = 0;
+        uint64_t v4 = -XXH_PRIME1;
+
+        for (; (end - p) >= 32; p += 32) {
+            v1 = xxh_round(v1, read64(p));
+            v2 = xxh_round(v2, read64(p + 8));
+            v3 = xxh_round(v3, read64(p + 16));
+            v4 = xxh_round(v4, read64(p + 24));
+        }
+        hash = rotl64(v1, 1) + rotl64(v2, 7) + rotl64(v3, 12) + rotl64(v4, 18);
+        hash = xxh_merge(hash, v1);
+        hash = xxh_merge(hash, v2);
+        hash = xxh_merge(hash, v3);
+        hash = xxh_merge(hash, v4);
+    } else {
+        hash = XXH_PRIME5;
+    }
+    hash += length;
+
+    for (; (end - p) >= 8; p += 8) {
+        hash = (rotl64(hash ^ xxh_round(0, read64(p)), 27) * XXH_PRIME1) + XXH_PRIME4;
+    }
+    if ((end - p) >= 4) {
+        uint32_t word;
+        memcpy(&word, p, sizeof(word));
+        hash = (rotl64(hash ^ (word * XXH_PRIME1), 23) * XXH_PRIME2) + XXH_PRIME3;
+        p += 4;
+    }
+    for (; p < end; ++p) {
+        hash = rotl64(hash ^ (*p * XXH_PRIME5), 11) * XXH_PRIME1;
+    }
+
+    hash ^= hash >> 33;
+    hash *= XXH_PRIME2;
+    hash ^= hash >> 29;
+    hash *= XXH_PRIME3;
+    hash ^= hash >> 32;
+
+    return hash;
+}
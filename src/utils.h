@@ -11,7 +11,14 @@
 #define __CTOMAT_UTILITIES_H__
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 
 bool string_match(const char *str, const char *pat);
 
+/**
+ *  XXH64 hash of @c length bytes at @c buf, with seed 0.
+ */
+uint64_t hash64(const void *buf, size_t length);
+
 #endif /* __CTOMAT_UTILITIES_H__ */
@@ -447,6 +447,55 @@ SCENARIO("メモリプールをクリアする", "[pool][clear]") {
     }
 }
 
+SCENARIO("メモリプールを拡張する", "[pool][expand]") {
+    GIVEN("容量を使い切ったプールを用意する") {
+        size_t capacity = 2;
+        INFO("プール容量: " + std::to_string(capacity));
+
+        POOL pool = pool_init(sizeof(int), capacity);
+        REQUIRE(pool != NULL);
+        void *ptrs[5];
+        for (size_t i = 0; i < capacity; ++i) {
+            ptrs[i] = pool_alloc(pool);
+        }
+        REQUIRE(pool_alloc(pool) == NULL);
+
+        WHEN("プールを 3 要素分拡張する") {
+            REQUIRE(pool_expand(pool, 3) == 0);
+
+            THEN("容量と空き容量が増えること") {
+                REQUIRE(pool_capacity(pool) == 5);
+                REQUIRE(pool_freeable(pool) == 3);
+            }
+            THEN("拡張した分だけメモリが取得できること") {
+                for (size_t i = capacity; i < 5; ++i) {
+                    ptrs[i] = pool_alloc(pool);
+                    REQUIRE(ptrs[i] != NULL);
+                    REQUIRE(pool_contains(pool, ptrs[i]));
+                }
+                REQUIRE(pool_alloc(pool) == NULL);
+            }
+            THEN("取得済みのメモリが移動しないこと") {
+                REQUIRE(pool_contains(pool, ptrs[0]));
+                REQUIRE(pool_contains(pool, ptrs[1]));
+            }
+            THEN("クリア後も拡張した容量が維持されること") {
+                REQUIRE(pool_clear(pool) == 0);
+                REQUIRE(pool_capacity(pool) == 5);
+                REQUIRE(pool_freeable(pool) == 5);
+            }
+        }
+
+        WHEN("容量 0 で拡張する") {
+            THEN("失敗すること") {
+                REQUIRE(pool_expand(pool, 0) == -1);
+            }
+        }
+
+        pool_release(pool);
+    }
+}
+
 SCENARIO("リストが初期化できること", "[list][init]") {
     GIVEN("特になし") {
         WHEN("リストを初期化する") {
@@ -833,6 +882,188 @@ SCENARIO("ツリーに要素が追加できること", "[ntree][insert]") {
     }
 }
 
+SCENARIO("ツリーの容量を拡張できること", "[ntree][expand]") {
+    GIVEN("容量を使い切ったツリーを用意する") {
+        size_t capacity = 1;
+        INFO("容量: " + std::to_string(capacity));
+
+        NTREE tree = ntree_init(sizeof(int), capacity);
+        int data[3] = {0, 1, 2};
+        NTREE_NODE nodes[3];
+        nodes[0] = ntree_insert(tree, &data[0]);
+        REQUIRE(nodes[0] != NULL);
+        REQUIRE(ntree_insert_at(tree, nodes[0], &data[1]) == NULL);
+
+        WHEN("ツリーを拡張して子要素を追加する") {
+            REQUIRE(ntree_expand(tree, 2) == 0);
+            nodes[1] = ntree_insert_at(tree, nodes[0], &data[1]);
+            nodes[2] = ntree_insert_at(tree, nodes[0], &data[2]);
+
+            THEN("ツリーが [0: [1, 2]] となること") {
+                REQUIRE(ntree_count(tree) == 3);
+
+                ITER iter = ntree_iter(tree);
+                REQUIRE(*(int *)iter_data(iter) == 0);
+                REQUIRE(*(int *)iter_data(iter_next(iter)) == 1);
+                REQUIRE(*(int *)iter_data(iter_next(iter)) == 2);
+                iter_release(iter);
+            }
+        }
+
+        ntree_release(tree);
+    }
+}
+
+SCENARIO("ツリーの親要素と最後の子要素を取得できること", "[ntree][parent]") {
+    GIVEN("[0: [1, 2]] のツリーを用意する") {
+        NTREE tree = ntree_init(sizeof(int), 3);
+        int data[3] = {0, 1, 2};
+        NTREE_NODE nodes[3];
+        nodes[0] = ntree_insert(tree, &data[0]);
+        nodes[1] = ntree_insert_at(tree, nodes[0], &data[1]);
+        nodes[2] = ntree_insert_at(tree, nodes[0], &data[2]);
+
+        WHEN("各要素の親要素を取得する") {
+            THEN("子要素の親要素が 0 であること") {
+                REQUIRE(ntree_parent(nodes[0]) == NULL);
+                REQUIRE(ntree_parent(nodes[1]) == nodes[0]);
+                REQUIRE(ntree_parent(nodes[2]) == nodes[0]);
+            }
+        }
+
+        WHEN("最後の子要素を取得する") {
+            THEN("最後の子要素が 2 であること") {
+                REQUIRE(ntree_last_child(nodes[0]) == nodes[2]);
+                REQUIRE(ntree_last_child(nodes[1]) == NULL);
+            }
+        }
+
+        WHEN("最後の子要素を削除する") {
+            REQUIRE(ntree_remove(tree, nodes[2]) == 0);
+
+            THEN("最後の子要素が 1 となること") {
+                REQUIRE(ntree_last_child(nodes[0]) == nodes[1]);
+            }
+        }
+
+        ntree_release(tree);
+    }
+}
+
+SCENARIO("ツリーの要素を他の親要素の下に移せること", "[ntree][move]") {
+    GIVEN("[0: [1: [2], 3]] と [4: [5]] のツリーを用意する") {
+        NTREE tree = ntree_init(sizeof(int), 4);
+        NTREE other = ntree_init(sizeof(int), 2);
+        int data[6] = {0, 1, 2, 3, 4, 5};
+        NTREE_NODE nodes[6];
+        nodes[0] = ntree_insert(tree, &data[0]);
+        nodes[1] = ntree_insert_at(tree, nodes[0], &data[1]);
+        nodes[2] = ntree_insert_at(tree, nodes[1], &data[2]);
+        nodes[3] = ntree_insert_at(tree, nodes[0], &data[3]);
+        nodes[4] = ntree_insert(other, &data[4]);
+        nodes[5] = ntree_insert_at(other, nodes[4], &data[5]);
+
+        WHEN("1 を 3 の下に移す") {
+            REQUIRE(ntree_move(nodes[3], nodes[1]) == 0);
+
+            THEN("1 が子孫ごと 3 の子要素となること") {
+                REQUIRE(ntree_parent(nodes[1]) == nodes[3]);
+                REQUIRE(ntree_last_child(nodes[0]) == nodes[3]);
+                REQUIRE(ntree_last_child(nodes[3]) == nodes[1]);
+                REQUIRE(ntree_parent(nodes[2]) == nodes[1]);
+                int count = 0;
+                for (ITER iter = ntree_children_iter(nodes[0]); !iter_is_end(iter); iter = iter_next(iter)) {
+                    REQUIRE(*(int *)iter_data(iter) == 3);
+                    ++count;
+                }
+                REQUIRE(count == 1);
+            }
+        }
+
+        WHEN("他のツリーの 5 を 0 の下に移す") {
+            REQUIRE(ntree_move(nodes[0], nodes[5]) == 0);
+
+            THEN("5 が 0 の最後の子要素となること") {
+                REQUIRE(ntree_parent(nodes[5]) == nodes[0]);
+                REQUIRE(ntree_last_child(nodes[0]) == nodes[5]);
+                REQUIRE(ntree_last_child(nodes[4]) == NULL);
+            }
+        }
+
+        WHEN("0 の子要素をすべて他のツリーの 5 の下に移す") {
+            REQUIRE(ntree_move_children(nodes[5], nodes[0]) == 0);
+
+            THEN("1, 3 の順に 5 の子要素となること") {
+                REQUIRE(ntree_last_child(nodes[0]) == NULL);
+                REQUIRE(ntree_parent(nodes[1]) == nodes[5]);
+                REQUIRE(ntree_parent(nodes[3]) == nodes[5]);
+                REQUIRE(ntree_parent(nodes[2]) == nodes[1]);
+                int expected[2] = {1, 3};
+                int i = 0;
+                for (ITER iter = ntree_children_iter(nodes[5]); !iter_is_end(iter); iter = iter_next(iter)) {
+                    REQUIRE(i < 2);
+                    REQUIRE(*(int *)iter_data(iter) == expected[i++]);
+                }
+                REQUIRE(i == 2);
+                REQUIRE(ntree_last_child(nodes[5]) == nodes[3]);
+            }
+        }
+
+        WHEN("1 を自身の子孫の下に移す") {
+            THEN("失敗すること") {
+                REQUIRE(ntree_move(nodes[2], nodes[1]) == -1);
+                REQUIRE(errno == EINVAL);
+                REQUIRE(ntree_move(nodes[1], nodes[1]) == -1);
+                REQUIRE(ntree_move_children(nodes[2], nodes[1]) == -1);
+                REQUIRE(ntree_move_children(nodes[2], nodes[0]) == -1);
+            }
+        }
+
+        ntree_release(other);
+        ntree_release(tree);
+    }
+}
+
+SCENARIO("ツリーの子要素を並べ替えできること", "[ntree][reorder]") {
+    GIVEN("[0: [1, 2, 3]] のツリーを用意する") {
+        NTREE tree = ntree_init(sizeof(int), 4);
+        int data[4] = {0, 1, 2, 3};
+        NTREE_NODE nodes[4];
+        nodes[0] = ntree_insert(tree, &data[0]);
+        for (int i = 1; i < 4; ++i) {
+            nodes[i] = ntree_insert_at(tree, nodes[0], &data[i]);
+        }
+
+        WHEN("子要素を 3, 1, 2 の順に並べ替える") {
+            NTREE_NODE order[3] = {nodes[3], nodes[1], nodes[2]};
+            REQUIRE(ntree_reorder(nodes[0], order, 3) == 0);
+
+            THEN("子要素が 3, 1, 2 の順に走査されること") {
+                int expected[3] = {3, 1, 2};
+                int i = 0;
+                for (ITER iter = ntree_children_iter(nodes[0]); !iter_is_end(iter); iter = iter_next(iter)) {
+                    REQUIRE(i < 3);
+                    REQUIRE(*(int *)iter_data(iter) == expected[i++]);
+                }
+                REQUIRE(i == 3);
+                REQUIRE(ntree_last_child(nodes[0]) == nodes[2]);
+            }
+        }
+
+        WHEN("子要素の一部だけを渡す") {
+            NTREE_NODE order[2] = {nodes[2], nodes[1]};
+
+            THEN("失敗し, 順序が変わらないこと") {
+                REQUIRE(ntree_reorder(nodes[0], order, 2) == -1);
+                REQUIRE(errno == EINVAL);
+                REQUIRE(ntree_last_child(nodes[0]) == nodes[3]);
+            }
+        }
+
+        ntree_release(tree);
+    }
+}
+
 SCENARIO("ツリーを反復子で処理できること", "[ntree][iterator]") {
     GIVEN("ツリーを初期化しておく") {
         size_t capacity = 5;
@@ -1139,6 +1370,50 @@ SCENARIO("ツリーから要素が削除できること", "[ntree][remove]") {
             }
         }
 
+        WHEN("末尾の子要素を削除してから子要素を追加する") {
+            INFO("削除する要素: 6, 追加する要素: 7");
+
+            REQUIRE(ntree_remove(tree, nodes[6]) == 0);
+            int added = 7;
+            REQUIRE(ntree_insert_at(tree, nodes[3], &added) != NULL);
+
+            THEN("ツリーが [0, 1, 2, 3: [5, 7], 4] となること") {
+                REQUIRE(ntree_count(tree) == 7);
+
+                ITER iter = ntree_iter(tree);
+                REQUIRE(*(int *)iter_data(iter) == 0);
+                REQUIRE(*(int *)iter_data(iter_next(iter)) == 1);
+                REQUIRE(*(int *)iter_data(iter_next(iter)) == 2);
+                REQUIRE(*(int *)iter_data(iter_next(iter)) == 3);
+                REQUIRE(*(int *)iter_data(iter_next(iter)) == 5);
+                REQUIRE(*(int *)iter_data(iter_next(iter)) == 7);
+                REQUIRE(*(int *)iter_data(iter_next(iter)) == 4);
+                iter_release(iter);
+            }
+        }
+
+        WHEN("すべての子要素を削除してから子要素を追加する") {
+            INFO("削除する要素: 5, 6, 追加する要素: 7");
+
+            REQUIRE(ntree_remove(tree, nodes[5]) == 0);
+            REQUIRE(ntree_remove(tree, nodes[6]) == 0);
+            int added = 7;
+            REQUIRE(ntree_insert_at(tree, nodes[3], &added) != NULL);
+
+            THEN("ツリーが [0, 1, 2, 3: [7], 4] となること") {
+                REQUIRE(ntree_count(tree) == 6);
+
+                ITER iter = ntree_iter(tree);
+                REQUIRE(*(int *)iter_data(iter) == 0);
+                REQUIRE(*(int *)iter_data(iter_next(iter)) == 1);
+                REQUIRE(*(int *)iter_data(iter_next(iter)) == 2);
+                REQUIRE(*(int *)iter_data(iter_next(iter)) == 3);
+                REQUIRE(*(int *)iter_data(iter_next(iter)) == 7);
+                REQUIRE(*(int *)iter_data(iter_next(iter)) == 4);
+                iter_release(iter);
+            }
+        }
+
         ntree_release(tree);
     }
 }
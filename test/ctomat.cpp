@@ -0,0 +1,2735 @@
+/** @file   ctomat.cpp
+ *  @brief  Test for TOML encoder, decoder.
+ *
+ *  @author t-kenji <protect.2501@gmail.com>
+ *  @date   2018-11-27 create new.
+ */
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <cmath>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include "catch2/catch.hpp"
+
+extern "C" {
+#include "debug.h"
+#include "ctomat.h"
+}
+
+/**
+ *  write @c content to a temporary file.
+ *
+ *  @param  [in]    content file content.
+ *  @return pathname of the temporary file.
+ */
+static std::string write_temp_file(const std::string &content)
+{
+    char pathname[] = "/tmp/ctomat_test_XXXXXX";
+    int fd = mkstemp(pathname);
+    REQUIRE(fd != -1);
+    REQUIRE(write(fd, content.data(), content.size()) == (ssize_t)content.size());
+    close(fd);
+
+    return pathname;
+}
+
+/**
+ *  read the whole content of a file.
+ *
+ *  @param  [in]    pathname    file to read.
+ *  @return content of the file.
+ */
+static std::string read_file(const std::string &pathname)
+{
+    std::string content;
+    char buf[4096];
+    int fd = open(pathname.c_str(), O_RDONLY);
+    REQUIRE(fd != -1);
+    for (ssize_t n; (n = read(fd, buf, sizeof(buf))) > 0;) {
+        content.append(buf, n);
+    }
+    close(fd);
+
+    return content;
+}
+
+/**
+ *  load @c input through the parser, which keeps no source text, so
+ *  that saving regenerates the document.
+ *
+ *  @param  [in]    input   TOML document.
+ *  @return loaded document.
+ */
+static toml_t load_without_source(const std::string &input)
+{
+    toml_parser_t parser = toml_parser_create();
+    REQUIRE(parser != NULL);
+    REQUIRE(toml_parser_feed(parser, input.data(), input.size()) == 0);
+    toml_t doc = toml_parser_finish(parser);
+    REQUIRE(doc != NULL);
+
+    return doc;
+}
+
+SCENARIO("ファイルから TOML が読み込めること", "[ctomat][load]") {
+
+    GIVEN("文字列の key/value を含むファイルを用意する") {
+        std::string pathname = write_temp_file("title = \"TOML Example\"\n"
+                                               "# comment line\n"
+                                               "owner = 'Tom' # trailing comment\n"
+                                               "database.server = \"192.168.1.1\"\n");
+        INFO("ファイル: " + pathname);
+
+        WHEN("ファイルを読み込む") {
+            toml_t doc = toml_load(pathname.c_str());
+            REQUIRE(doc != NULL);
+
+            THEN("値が取得できること") {
+                toml_t title = toml_object_get(doc, "title");
+                REQUIRE(title != NULL);
+                REQUIRE(std::string(toml_string_value(title)) == "TOML Example");
+
+                toml_t owner = toml_object_get(doc, "owner");
+                REQUIRE(owner != NULL);
+                REQUIRE(std::string(toml_string_value(owner)) == "Tom");
+            }
+            THEN("dotted-key の値が取得できること") {
+                toml_t database = toml_object_get(doc, "database");
+                REQUIRE(database != NULL);
+                toml_t server = toml_object_get(database, "server");
+                REQUIRE(server != NULL);
+                REQUIRE(std::string(toml_string_value(server)) == "192.168.1.1");
+            }
+            THEN("存在しない key は取得できないこと") {
+                REQUIRE(toml_object_get(doc, "nothing") == NULL);
+            }
+
+            toml_delete(doc, true);
+        }
+
+        unlink(pathname.c_str());
+    }
+
+    GIVEN("空のファイルを用意する") {
+        std::string pathname = write_temp_file("");
+
+        WHEN("ファイルを読み込む") {
+            toml_t doc = toml_load(pathname.c_str());
+
+            THEN("空のドキュメントが得られること") {
+                REQUIRE(doc != NULL);
+                REQUIRE(toml_object_get(doc, "title") == NULL);
+            }
+
+            toml_delete(doc, true);
+        }
+
+        unlink(pathname.c_str());
+    }
+
+    GIVEN("存在しないファイル名") {
+        WHEN("ファイルを読み込む") {
+            toml_t doc = toml_load("/tmp/ctomat_test_not_exist.toml");
+
+            THEN("読み込みに失敗すること") {
+                REQUIRE(doc == NULL);
+            }
+        }
+    }
+}
+
+SCENARIO("メモリから TOML が読み込めること", "[ctomat][load]") {
+
+    GIVEN("入力バッファを以下とする") {
+        std::string input = "key = \"value\"\n"
+                            "empty = \"\"\n";
+        INFO("入力: '" + input + "'");
+
+        WHEN("長さを指定して読み込む") {
+            toml_t doc = toml_load_from_memory(input.c_str(), input.size());
+            REQUIRE(doc != NULL);
+
+            THEN("値が取得できること") {
+                REQUIRE(std::string(toml_string_value(toml_object_get(doc, "key"))) == "value");
+                REQUIRE(std::string(toml_string_value(toml_object_get(doc, "empty"))) == "");
+            }
+            THEN("値が変更できること") {
+                toml_t key = toml_object_get(doc, "key");
+                REQUIRE(toml_string_set(key, "changed") == 0);
+                REQUIRE(std::string(toml_string_value(key)) == "changed");
+            }
+
+            toml_delete(doc, true);
+        }
+
+        WHEN("長さを途中までにして読み込む") {
+            toml_t doc = toml_load_from_memory(input.c_str(), input.find('\n'));
+            REQUIRE(doc != NULL);
+
+            THEN("指定した長さまでが読み込まれること") {
+                REQUIRE(toml_object_get(doc, "key") != NULL);
+                REQUIRE(toml_object_get(doc, "empty") == NULL);
+            }
+
+            toml_delete(doc, true);
+        }
+    }
+
+    GIVEN("quoted-key とコメント記号を含む文字列の入力を用意する") {
+        std::string input = "\"quoted.key\" = \"# not a comment\" # comment\n"
+                            "site . 'google.com' = 'x'\n";
+        INFO("入力: '" + input + "'");
+
+        WHEN("読み込む") {
+            toml_t doc = toml_load_from_memory(input.c_str(), input.size());
+            REQUIRE(doc != NULL);
+
+            THEN("quoted-key で値が取得できること") {
+                toml_t quoted = toml_object_get(doc, "quoted.key");
+                REQUIRE(quoted != NULL);
+                REQUIRE(std::string(toml_string_value(quoted)) == "# not a comment");
+            }
+            THEN("dotted-key の一部が quoted-key でも値が取得できること") {
+                toml_t site = toml_object_get(doc, "site");
+                REQUIRE(site != NULL);
+                REQUIRE(std::string(toml_string_value(toml_object_get(site, "google.com"))) == "x");
+            }
+
+            toml_delete(doc, true);
+        }
+    }
+
+    GIVEN("エスケープシーケンスと多バイト文字を含む文字列の入力を用意する") {
+        std::string input = "title = \"TOML \\\"Example\\\"\"\n"
+                            "path = 'C:\\Users\\tom'\n"
+                            "lines = \"a\\tb\\nc\"\n"
+                            "unicode = \"\\u00e9\\U0001D11E\"\n"
+                            "raw = \"\xE3\x81\x82\"\n"
+                            "list = [\"\\\"x\\\"\", \"y\"]\n";
+        INFO("入力: '" + input + "'");
+
+        WHEN("読み込む") {
+            toml_t doc = toml_load_from_memory(input.c_str(), input.size());
+            REQUIRE(doc != NULL);
+
+            THEN("エスケープが解かれた値が取得できること") {
+                REQUIRE(std::string(toml_string_value(toml_object_get(doc, "title"))) == "TOML \"Example\"");
+                REQUIRE(std::string(toml_string_value(toml_object_get(doc, "lines"))) == "a\tb\nc");
+                REQUIRE(std::string(toml_string_value(toml_object_get(doc, "unicode"))) == "\xC3\xA9\xF0\x9D\x84\x9E");
+                REQUIRE(std::string(toml_string_value(toml_object_get(doc, "raw"))) == "\xE3\x81\x82");
+            }
+            THEN("literal string のバックスラッシュはそのままであること") {
+                REQUIRE(std::string(toml_string_value(toml_object_get(doc, "path"))) == "C:\\Users\\tom");
+            }
+            THEN("配列の要素もエスケープが解かれていること") {
+                size_t length;
+                const toml_view_t *list = toml_array_string(toml_object_get(doc, "list"), &length);
+                REQUIRE(list != NULL);
+                REQUIRE(length == 2);
+                REQUIRE(std::string(list[0].ptr, list[0].length) == "\"x\"");
+                REQUIRE(std::string(list[1].ptr, list[1].length) == "y");
+            }
+            THEN("書き出すと入力のまま得られること") {
+                char buf[512];
+                REQUIRE(toml_save_to_memory(doc, buf, sizeof(buf)) == (ssize_t)input.size());
+                REQUIRE(std::string(buf) == input);
+            }
+            THEN("元の表記を持たない文書ではエスケープし直されること") {
+                char buf[512];
+                toml_t copy = load_without_source(input);
+                REQUIRE(toml_save_to_memory(copy, buf, sizeof(buf)) > 0);
+                toml_delete(copy, true);
+                REQUIRE(std::string(buf) == "title = \"TOML \\\"Example\\\"\"\n"
+                                            "path = 'C:\\Users\\tom'\n"
+                                            "lines = \"a\\tb\\nc\"\n"
+                                            "unicode = \"\xC3\xA9\xF0\x9D\x84\x9E\"\n"
+                                            "raw = \"\xE3\x81\x82\"\n"
+                                            "list = [\"\\\"x\\\"\", \"y\"]\n");
+            }
+
+            toml_delete(doc, true);
+        }
+
+        WHEN("遅延読み込みする") {
+            toml_t doc = toml_load_from_memory_ex(input.c_str(), input.size(), TOML_LOAD_LAZY);
+            REQUIRE(doc != NULL);
+
+            THEN("参照時にエスケープが解かれること") {
+                REQUIRE(std::string(toml_string_value(toml_object_get(doc, "title"))) == "TOML \"Example\"");
+                REQUIRE(std::string(toml_string_value(toml_object_get(doc, "unicode"))) == "\xC3\xA9\xF0\x9D\x84\x9E");
+            }
+
+            toml_delete(doc, true);
+        }
+    }
+
+    GIVEN("複数行の文字列を含む入力を用意する") {
+        std::string input = "query = \"\"\"\n"
+                            "SELECT name\n"
+                            "  FROM users\n"
+                            " WHERE id = \"1\";\"\"\"\n"
+                            "folded = \"\"\"\\\n"
+                            "    The quick brown \\\n"
+                            "    fox.\\\n"
+                            "    \"\"\"\n"
+                            "cert = '''\n"
+                            "-----BEGIN CERTIFICATE-----\n"
+                            "MIIB\\x'y\n"
+                            "-----END CERTIFICATE-----'''\n"
+                            "quotes = \"\"\"\"a\"\"\"\"\" # comment\n"
+                            "after = 1\n";
+        INFO("入力: '" + input + "'");
+
+        WHEN("読み込む") {
+            toml_t doc = toml_load_from_memory(input.c_str(), input.size());
+            REQUIRE(doc != NULL);
+
+            THEN("改行を含む値が取得できること") {
+                REQUIRE(std::string(toml_string_value(toml_object_get(doc, "query")))
+                        == "SELECT name\n  FROM users\n WHERE id = \"1\";");
+                REQUIRE(std::string(toml_string_value(toml_object_get(doc, "cert")))
+                        == "-----BEGIN CERTIFICATE-----\nMIIB\\x'y\n-----END CERTIFICATE-----");
+            }
+            THEN("行末のバックスラッシュで空白が詰められること") {
+                REQUIRE(std::string(toml_string_value(toml_object_get(doc, "folded"))) == "The quick brown fox.");
+            }
+            THEN("閉じる引用符に隣接する引用符が値に含まれること") {
+                REQUIRE(std::string(toml_string_value(toml_object_get(doc, "quotes"))) == "\"a\"\"");
+            }
+            THEN("後続の key/value が読み込まれること") {
+                int64_t value = 0;
+                REQUIRE(toml_integer_value(toml_object_get(doc, "after"), &value) == 0);
+                REQUIRE(value == 1);
+            }
+            THEN("書き出すと入力のまま得られること") {
+                char buf[512];
+                REQUIRE(toml_save_to_memory(doc, buf, sizeof(buf)) == (ssize_t)input.size());
+                REQUIRE(std::string(buf) == input);
+            }
+            THEN("元の表記を持たない文書では 1 行の文字列として書き出されること") {
+                char buf[512];
+                toml_t copy = load_without_source(input);
+                REQUIRE(toml_save_to_memory(copy, buf, sizeof(buf)) > 0);
+                toml_delete(copy, true);
+                REQUIRE(std::string(buf) == "query = \"SELECT name\\n  FROM users\\n WHERE id = \\\"1\\\";\"\n"
+                                            "folded = \"The quick brown fox.\"\n"
+                                            "cert = \"-----BEGIN CERTIFICATE-----\\nMIIB\\\\x'y\\n-----END CERTIFICATE-----\"\n"
+                                            "quotes = \"\\\"a\\\"\\\"\"\n"
+                                            "after = 1\n");
+            }
+
+            toml_delete(doc, true);
+        }
+
+        WHEN("遅延読み込みする") {
+            toml_t doc = toml_load_from_memory_ex(input.c_str(), input.size(), TOML_LOAD_LAZY);
+            REQUIRE(doc != NULL);
+
+            THEN("参照時に同じ値が取得できること") {
+                REQUIRE(std::string(toml_string_value(toml_object_get(doc, "folded"))) == "The quick brown fox.");
+                REQUIRE(std::string(toml_string_value(toml_object_get(doc, "quotes"))) == "\"a\"\"");
+            }
+
+            toml_delete(doc, true);
+        }
+    }
+
+    GIVEN("256 文字を超える key と値の入力を用意する") {
+        std::string name(300, 'k');
+        std::string value(1000, 'v');
+        std::string input = name + " = \"" + value + "\"\n"
+                            "short = 'abc'\n";
+
+        WHEN("読み込む") {
+            toml_t doc = toml_load_from_memory(input.c_str(), input.size());
+            REQUIRE(doc != NULL);
+
+            THEN("切り詰められずに取得できること") {
+                toml_t key = toml_object_get(doc, name.c_str());
+                REQUIRE(key != NULL);
+                REQUIRE(std::string(toml_string_value(key)) == value);
+            }
+            THEN("短い値と長い値を交互に変更できること") {
+                toml_t key = toml_object_get(doc, "short");
+                for (size_t length = 0; length < 100; length += 7) {
+                    std::string changed(length, 'a' + (length % 26));
+                    REQUIRE(toml_string_set(key, changed.c_str()) == 0);
+                    REQUIRE(std::string(toml_string_value(key)) == changed);
+                }
+                REQUIRE(toml_string_set(key, toml_string_value(key) + 1) == 0);
+                REQUIRE(std::string(toml_string_value(key)) == std::string(97, 'a' + (98 % 26)));
+            }
+
+            toml_delete(doc, true);
+        }
+    }
+
+    GIVEN("多数の key を含む入力を用意する") {
+        std::string input;
+        int count = 1000;
+        for (int i = 0; i < count; ++i) {
+            input += "key" + std::to_string(i) + " = \"value" + std::to_string(i) + "\"\n";
+        }
+
+        WHEN("読み込む") {
+            toml_t doc = toml_load_from_memory(input.c_str(), input.size());
+            REQUIRE(doc != NULL);
+
+            THEN("すべての値が取得できること") {
+                REQUIRE(std::string(toml_string_value(toml_object_get(doc, "key0"))) == "value0");
+                REQUIRE(std::string(toml_string_value(toml_object_get(doc, "key999"))) == "value999");
+                for (int i = 0; i < count; ++i) {
+                    toml_t key = toml_object_get(doc, ("key" + std::to_string(i)).c_str());
+                    REQUIRE(key != NULL);
+                    REQUIRE(std::string(toml_string_value(key)) == "value" + std::to_string(i));
+                }
+            }
+            THEN("存在しない key は取得できないこと") {
+                REQUIRE(toml_object_get(doc, "key0") != NULL);
+                REQUIRE(toml_object_get(doc, "key1000") == NULL);
+                REQUIRE(errno == ENOENT);
+                REQUIRE(toml_object_get(doc, "") == NULL);
+            }
+
+            toml_delete(doc, true);
+        }
+    }
+
+    GIVEN("共通の接頭辞を持つ dotted-key の入力を用意する") {
+        std::string input = "a.b.x = 'x'\n"
+                            "a.b.y = 'y'\n"
+                            "a.c = 'c'\n";
+        for (int i = 0; i < 100; ++i) {
+            input += "a.b.z" + std::to_string(i) + " = 'z'\n";
+        }
+        INFO("入力: '" + input + "'");
+
+        WHEN("読み込む") {
+            toml_t doc = toml_load_from_memory(input.c_str(), input.size());
+            REQUIRE(doc != NULL);
+
+            THEN("同じテーブルにまとめられること") {
+                toml_t a = toml_object_get(doc, "a");
+                REQUIRE(a != NULL);
+                toml_t b = toml_object_get(a, "b");
+                REQUIRE(b != NULL);
+                REQUIRE(std::string(toml_string_value(toml_object_get(b, "x"))) == "x");
+                REQUIRE(std::string(toml_string_value(toml_object_get(b, "y"))) == "y");
+                REQUIRE(std::string(toml_string_value(toml_object_get(b, "z99"))) == "z");
+                REQUIRE(std::string(toml_string_value(toml_object_get(a, "c"))) == "c");
+            }
+
+            toml_delete(doc, true);
+        }
+    }
+
+    GIVEN("整数の値を含む入力を用意する") {
+        std::string input = "port = 8080\n"
+                            "offset = -17 # comment\n"
+                            "mask = 0xFF_FF\n"
+                            "mode = 0o755\n"
+                            "flags = 0b1010\n"
+                            "large = 1_000_000_000_000\n"
+                            "min = -9223372036854775808\n"
+                            "name = 'port'\n";
+        INFO("入力: '" + input + "'");
+
+        WHEN("読み込む") {
+            toml_t doc = toml_load_from_memory(input.c_str(), input.size());
+            REQUIRE(doc != NULL);
+
+            THEN("整数の値が取得できること") {
+                int64_t value = 0;
+                REQUIRE(toml_integer_value(toml_object_get(doc, "port"), &value) == 0);
+                REQUIRE(value == 8080);
+                REQUIRE(toml_integer_value(toml_object_get(doc, "offset"), &value) == 0);
+                REQUIRE(value == -17);
+                REQUIRE(toml_integer_value(toml_object_get(doc, "mask"), &value) == 0);
+                REQUIRE(value == 0xFFFF);
+                REQUIRE(toml_integer_value(toml_object_get(doc, "mode"), &value) == 0);
+                REQUIRE(value == 0755);
+                REQUIRE(toml_integer_value(toml_object_get(doc, "flags"), &value) == 0);
+                REQUIRE(value == 10);
+                REQUIRE(toml_integer_value(toml_object_get(doc, "large"), &value) == 0);
+                REQUIRE(value == 1000000000000);
+                REQUIRE(toml_integer_value(toml_object_get(doc, "min"), &value) == 0);
+                REQUIRE(value == INT64_MIN);
+            }
+            THEN("型の異なる値は取得に失敗すること") {
+                int64_t value = 0;
+                REQUIRE(toml_integer_value(toml_object_get(doc, "name"), &value) == -1);
+                REQUIRE(errno == EINVAL);
+                REQUIRE(toml_string_value(toml_object_get(doc, "port")) == NULL);
+            }
+
+            toml_delete(doc, true);
+        }
+
+        WHEN("遅延読み込みする") {
+            toml_t doc = toml_load_from_memory_ex(input.c_str(), input.size(), TOML_LOAD_LAZY);
+            REQUIRE(doc != NULL);
+
+            THEN("参照時に整数として解釈されること") {
+                int64_t value = 0;
+                REQUIRE(toml_integer_value(toml_object_get(doc, "mask"), &value) == 0);
+                REQUIRE(value == 0xFFFF);
+                REQUIRE(toml_integer_value(toml_object_get(doc, "name"), &value) == -1);
+            }
+
+            toml_delete(doc, true);
+        }
+    }
+
+    GIVEN("浮動小数点数の値を含む入力を用意する") {
+        std::string input = "pi = 3.1415\n"
+                            "weight = -0.000_123\n"
+                            "planck = 6.626e-34 # comment\n"
+                            "large = 5E+22\n"
+                            "positive = +inf\n"
+                            "quiet = nan\n"
+                            "count = 1\n";
+        INFO("入力: '" + input + "'");
+
+        WHEN("読み込む") {
+            toml_t doc = toml_load_from_memory(input.c_str(), input.size());
+            REQUIRE(doc != NULL);
+
+            THEN("浮動小数点数の値が取得できること") {
+                double value = 0;
+                REQUIRE(toml_float_value(toml_object_get(doc, "pi"), &value) == 0);
+                REQUIRE(value == 3.1415);
+                REQUIRE(toml_float_value(toml_object_get(doc, "weight"), &value) == 0);
+                REQUIRE(value == -0.000123);
+                REQUIRE(toml_float_value(toml_object_get(doc, "planck"), &value) == 0);
+                REQUIRE(value == 6.626e-34);
+                REQUIRE(toml_float_value(toml_object_get(doc, "large"), &value) == 0);
+                REQUIRE(value == 5e22);
+                REQUIRE(toml_float_value(toml_object_get(doc, "positive"), &value) == 0);
+                REQUIRE(std::isinf(value));
+                REQUIRE(toml_float_value(toml_object_get(doc, "quiet"), &value) == 0);
+                REQUIRE(std::isnan(value));
+            }
+            THEN("整数は浮動小数点数として取得できないこと") {
+                double value = 0;
+                REQUIRE(toml_float_value(toml_object_get(doc, "count"), &value) == -1);
+                REQUIRE(errno == EINVAL);
+            }
+
+            toml_delete(doc, true);
+        }
+    }
+
+    GIVEN("日時の値を含む入力を用意する") {
+        std::string input = "odt1 = 1979-05-27T07:32:00Z\n"
+                            "odt2 = 1979-05-27 00:32:00.999999-07:00 # comment\n"
+                            "ldt = 1979-05-27T07:32:00\n"
+                            "ld = 1979-05-27\n"
+                            "lt = 00:32:00.5\n"
+                            "count = 1\n";
+        INFO("入力: '" + input + "'");
+
+        WHEN("読み込む") {
+            toml_t doc = toml_load_from_memory(input.c_str(), input.size());
+            REQUIRE(doc != NULL);
+
+            THEN("日時の値が取得できること") {
+                toml_datetime_t value;
+                REQUIRE(toml_datetime_value(toml_object_get(doc, "odt1"), &value) == 0);
+                REQUIRE(value.kind == TOML_OFFSET_DATETIME);
+                REQUIRE(value.seconds == 296638320);
+                REQUIRE(value.offset == 0);
+                REQUIRE(toml_datetime_value(toml_object_get(doc, "odt2"), &value) == 0);
+                REQUIRE(value.kind == TOML_OFFSET_DATETIME);
+                REQUIRE(value.seconds == 296638320);
+                REQUIRE(value.nanoseconds == 999999000);
+                REQUIRE(value.offset == -420);
+                REQUIRE(toml_datetime_value(toml_object_get(doc, "ldt"), &value) == 0);
+                REQUIRE(value.kind == TOML_LOCAL_DATETIME);
+                REQUIRE(value.seconds == 296638320);
+                REQUIRE(toml_datetime_value(toml_object_get(doc, "ld"), &value) == 0);
+                REQUIRE(value.kind == TOML_LOCAL_DATE);
+                REQUIRE(value.seconds == 296611200);
+                REQUIRE(toml_datetime_value(toml_object_get(doc, "lt"), &value) == 0);
+                REQUIRE(value.kind == TOML_LOCAL_TIME);
+                REQUIRE(value.seconds == 1920);
+                REQUIRE(value.nanoseconds == 500000000);
+            }
+            THEN("整数は日時として取得できないこと") {
+                toml_datetime_t value;
+                REQUIRE(toml_datetime_value(toml_object_get(doc, "count"), &value) == -1);
+                REQUIRE(errno == EINVAL);
+            }
+            THEN("書き出すと入力のまま得られること") {
+                char buf[512];
+                REQUIRE(toml_save_to_memory(doc, buf, sizeof(buf)) == (ssize_t)input.size());
+                REQUIRE(std::string(buf) == input);
+            }
+            THEN("元の表記を持たない文書では日時が書き出せること") {
+                char buf[512];
+                toml_t copy = load_without_source(input);
+                REQUIRE(toml_save_to_memory(copy, buf, sizeof(buf)) > 0);
+                toml_delete(copy, true);
+                REQUIRE(std::string(buf) == "odt1 = 1979-05-27T07:32:00Z\n"
+                                            "odt2 = 1979-05-27T00:32:00.999999-07:00\n"
+                                            "ldt = 1979-05-27T07:32:00\n"
+                                            "ld = 1979-05-27\n"
+                                            "lt = 00:32:00.5\n"
+                                            "count = 1\n");
+            }
+
+            toml_delete(doc, true);
+        }
+
+        WHEN("遅延読み込みする") {
+            toml_t doc = toml_load_from_memory_ex(input.c_str(), input.size(), TOML_LOAD_LAZY);
+            REQUIRE(doc != NULL);
+
+            THEN("参照時に日時の値が取得できること") {
+                toml_datetime_t value;
+                REQUIRE(toml_datetime_value(toml_object_get(doc, "odt2"), &value) == 0);
+                REQUIRE(value.seconds == 296638320);
+                REQUIRE(value.offset == -420);
+            }
+
+            toml_delete(doc, true);
+        }
+    }
+
+    GIVEN("真偽値を含む入力を用意する") {
+        std::string input = "enabled = true\n"
+                            "debug = false # comment\n"
+                            "flags = [true, false, true]\n"
+                            "name = 'true'\n";
+        INFO("入力: '" + input + "'");
+
+        WHEN("読み込む") {
+            toml_t doc = toml_load_from_memory(input.c_str(), input.size());
+            REQUIRE(doc != NULL);
+
+            THEN("真偽値が取得できること") {
+                bool value = false;
+                REQUIRE(toml_boolean_value(toml_object_get(doc, "enabled"), &value) == 0);
+                REQUIRE(value);
+                REQUIRE(toml_boolean_value(toml_object_get(doc, "debug"), &value) == 0);
+                REQUIRE_FALSE(value);
+            }
+            THEN("文字列は真偽値として取得できないこと") {
+                bool value;
+                REQUIRE(toml_boolean_value(toml_object_get(doc, "name"), &value) == -1);
+                REQUIRE(errno == EINVAL);
+            }
+            THEN("真偽値の配列がまとめて取得できること") {
+                size_t length;
+                const bool *flags = toml_array_bool(toml_object_get(doc, "flags"), &length);
+                REQUIRE(flags != NULL);
+                REQUIRE(length == 3);
+                REQUIRE(flags[0]);
+                REQUIRE_FALSE(flags[1]);
+                REQUIRE(flags[2]);
+                bool value = true;
+                REQUIRE(toml_boolean_value(toml_array_get(toml_object_get(doc, "flags"), 1), &value) == 0);
+                REQUIRE_FALSE(value);
+            }
+            THEN("書き出すと入力のまま得られること") {
+                char buf[512];
+                REQUIRE(toml_save_to_memory(doc, buf, sizeof(buf)) == (ssize_t)input.size());
+                REQUIRE(std::string(buf) == input);
+            }
+            THEN("元の表記を持たない文書では真偽値が書き出せること") {
+                char buf[512];
+                toml_t copy = load_without_source(input);
+                REQUIRE(toml_save_to_memory(copy, buf, sizeof(buf)) > 0);
+                toml_delete(copy, true);
+                REQUIRE(std::string(buf) == "enabled = true\n"
+                                            "debug = false\n"
+                                            "flags = [true, false, true]\n"
+                                            "name = 'true'\n");
+            }
+
+            toml_delete(doc, true);
+        }
+
+        WHEN("遅延読み込みする") {
+            toml_t doc = toml_load_from_memory_ex(input.c_str(), input.size(), TOML_LOAD_LAZY);
+            REQUIRE(doc != NULL);
+
+            THEN("参照時に真偽値が取得できること") {
+                bool value = true;
+                REQUIRE(toml_boolean_value(toml_object_get(doc, "debug"), &value) == 0);
+                REQUIRE_FALSE(value);
+            }
+
+            toml_delete(doc, true);
+        }
+    }
+
+    GIVEN("配列の値を含む入力を用意する") {
+        std::string input = "ints = [1, 2, 3]\n"
+                            "floats = [1.5, -2.0,]\n"
+                            "strings = [\"a\", \"b c\"]\n"
+                            "quotes = [\"a\", 'b\\c', \"\"\"d\"\"\", '''e''']\n"
+                            "dates = [1979-05-27, 1979-05-28]\n"
+                            "empty = []\n"
+                            "lines = [ # comment\n"
+                            "  10,\n"
+                            "\n"
+                            "  20, # comment\n"
+                            "]\n"
+                            "mixed = [1, 'x', 2.5]\n"
+                            "nested = [[1, 2], ['a']]\n"
+                            "points = [{ x = 1 }, { x = 2, y.z = 3 }]\n";
+        INFO("入力: '" + input + "'");
+
+        WHEN("読み込む") {
+            toml_t doc = toml_load_from_memory(input.c_str(), input.size());
+            REQUIRE(doc != NULL);
+
+            THEN("同じ型の要素が連続した領域で取得できること") {
+                size_t length = 0;
+                const int64_t *ints = toml_array_int64(toml_object_get(doc, "ints"), &length);
+                REQUIRE(ints != NULL);
+                REQUIRE(length == 3);
+                REQUIRE(std::vector<int64_t>(ints, ints + length) == std::vector<int64_t>({1, 2, 3}));
+                const double *floats = toml_array_double(toml_object_get(doc, "floats"), &length);
+                REQUIRE(floats != NULL);
+                REQUIRE(length == 2);
+                REQUIRE(floats[0] == 1.5);
+                REQUIRE(floats[1] == -2.0);
+                const toml_view_t *strings = toml_array_string(toml_object_get(doc, "strings"), &length);
+                REQUIRE(strings != NULL);
+                REQUIRE(length == 2);
+                REQUIRE(std::string(strings[1].ptr, strings[1].length) == "b c");
+                const toml_datetime_t *dates = toml_array_datetime(toml_object_get(doc, "dates"), &length);
+                REQUIRE(dates != NULL);
+                REQUIRE(length == 2);
+                REQUIRE(dates[1].seconds - dates[0].seconds == 86400);
+                const int64_t *lines = toml_array_int64(toml_object_get(doc, "lines"), &length);
+                REQUIRE(lines != NULL);
+                REQUIRE(std::vector<int64_t>(lines, lines + length) == std::vector<int64_t>({10, 20}));
+            }
+            THEN("引用符の異なる文字列も連続した領域で取得できること") {
+                size_t length = 0;
+                toml_t quotes = toml_object_get(doc, "quotes");
+                const toml_view_t *views = toml_array_string(quotes, &length);
+                REQUIRE(views != NULL);
+                REQUIRE(length == 4);
+                REQUIRE(std::string(views[1].ptr, views[1].length) == "b\\c");
+                REQUIRE(std::string(views[2].ptr, views[2].length) == "d");
+                REQUIRE(std::string(views[3].ptr, views[3].length) == "e");
+                REQUIRE(std::string(toml_string_value(toml_array_get(quotes, 1))) == "b\\c");
+            }
+            THEN("空の配列はどの型でも要素数 0 で取得できること") {
+                toml_t empty = toml_object_get(doc, "empty");
+                size_t length = 1;
+                REQUIRE(toml_array_length(empty) == 0);
+                REQUIRE(toml_array_int64(empty, &length) != NULL);
+                REQUIRE(length == 0);
+                REQUIRE(toml_array_string(empty, &length) != NULL);
+            }
+            THEN("型の異なる要素は連続した領域で取得できないこと") {
+                size_t length = 0;
+                REQUIRE(toml_array_int64(toml_object_get(doc, "floats"), &length) == NULL);
+                REQUIRE(errno == EINVAL);
+                REQUIRE(toml_array_int64(toml_object_get(doc, "mixed"), &length) == NULL);
+                REQUIRE(errno == EINVAL);
+                REQUIRE(toml_array_int64(toml_object_get(doc, "nested"), &length) == NULL);
+                REQUIRE(errno == EINVAL);
+            }
+            THEN("要素がインデックスで取得できること") {
+                int64_t integer = 0;
+                double number = 0;
+                toml_t ints = toml_object_get(doc, "ints");
+                REQUIRE(toml_array_length(ints) == 3);
+                REQUIRE(toml_integer_value(toml_array_get(ints, 2), &integer) == 0);
+                REQUIRE(integer == 3);
+                REQUIRE(toml_array_get(ints, 3) == NULL);
+                toml_t mixed = toml_object_get(doc, "mixed");
+                REQUIRE(toml_array_length(mixed) == 3);
+                REQUIRE(toml_integer_value(toml_array_get(mixed, 0), &integer) == 0);
+                REQUIRE(integer == 1);
+                REQUIRE(std::string(toml_string_value(toml_array_get(mixed, 1))) == "x");
+                REQUIRE(toml_float_value(toml_array_get(mixed, 2), &number) == 0);
+                REQUIRE(number == 2.5);
+            }
+            THEN("インデックスで取得した要素の変更が連続した領域にも反映されること") {
+                size_t length = 0;
+                toml_t strings = toml_object_get(doc, "strings");
+                REQUIRE(toml_string_set(toml_array_get(strings, 1), "changed") == 0);
+                const toml_view_t *views = toml_array_string(strings, &length);
+                REQUIRE(views != NULL);
+                REQUIRE(length == 2);
+                REQUIRE(std::string(views[1].ptr, views[1].length) == "changed");
+                REQUIRE(std::string(toml_string_value(toml_array_get(strings, 1))) == "changed");
+            }
+            THEN("入れ子の配列とインラインテーブルの要素が取得できること") {
+                size_t length = 0;
+                toml_t nested = toml_object_get(doc, "nested");
+                REQUIRE(toml_array_length(nested) == 2);
+                const int64_t *first = toml_array_int64(toml_array_get(nested, 0), &length);
+                REQUIRE(first != NULL);
+                REQUIRE(length == 2);
+                REQUIRE(first[1] == 2);
+                REQUIRE(toml_array_string(toml_array_get(nested, 1), &length) != NULL);
+                REQUIRE(length == 1);
+                toml_t points = toml_object_get(doc, "points");
+                REQUIRE(toml_array_length(points) == 2);
+                int64_t value = 0;
+                REQUIRE(toml_integer_value(toml_object_get(toml_array_get(points, 0), "x"), &value) == 0);
+                REQUIRE(value == 1);
+                toml_t y = toml_object_get(toml_array_get(points, 1), "y");
+                REQUIRE(toml_integer_value(toml_object_get(y, "z"), &value) == 0);
+                REQUIRE(value == 3);
+            }
+
+            toml_delete(doc, true);
+        }
+
+        WHEN("遅延読み込みする") {
+            toml_t doc = toml_load_from_memory_ex(input.c_str(), input.size(), TOML_LOAD_LAZY);
+            REQUIRE(doc != NULL);
+
+            THEN("配列の値が取得できること") {
+                size_t length = 0;
+                const int64_t *ints = toml_array_int64(toml_object_get(doc, "ints"), &length);
+                REQUIRE(ints != NULL);
+                REQUIRE(length == 3);
+                REQUIRE(ints[0] == 1);
+                int64_t value = 0;
+                toml_t y = toml_object_get(toml_array_get(toml_object_get(doc, "points"), 1), "y");
+                REQUIRE(toml_integer_value(toml_object_get(y, "z"), &value) == 0);
+                REQUIRE(value == 3);
+            }
+
+            toml_delete(doc, true);
+        }
+    }
+
+    GIVEN("大きな整数の配列を含む入力を用意する") {
+        std::string input = "values = [";
+        int count = 100000;
+        for (int i = 0; i < count; ++i) {
+            input += std::to_string(i * 3) + ((i % 16) == 15 ? ",\n" : ", ");
+        }
+        input += "]\n";
+
+        WHEN("読み込む") {
+            toml_t doc = toml_load_from_memory(input.c_str(), input.size());
+            REQUIRE(doc != NULL);
+
+            THEN("すべての要素が連続した領域で取得できること") {
+                size_t length = 0;
+                const int64_t *values = toml_array_int64(toml_object_get(doc, "values"), &length);
+                REQUIRE(values != NULL);
+                REQUIRE(length == (size_t)count);
+                for (int i = 0; i < count; ++i) {
+                    if (values[i] != i * 3) {
+                        REQUIRE(values[i] == i * 3);
+                    }
+                }
+            }
+
+            toml_delete(doc, true);
+        }
+    }
+
+    GIVEN("インラインテーブルを含む入力を用意する") {
+        std::string input = "point = { x = 1, y = 2 }\n"
+                            "name = { first = \"Tom\", last = 'Preston-Werner' } # comment\n"
+                            "nested = { a = { b = 1 }, c.d = [1] }\n"
+                            "empty = {}\n"
+                            "after = 'x'\n";
+        INFO("入力: '" + input + "'");
+
+        WHEN("読み込む") {
+            toml_t doc = toml_load_from_memory(input.c_str(), input.size());
+            REQUIRE(doc != NULL);
+
+            THEN("子のテーブルとして値が取得できること") {
+                int64_t value = 0;
+                toml_t point = toml_object_get(doc, "point");
+                REQUIRE(toml_integer_value(toml_object_get(point, "x"), &value) == 0);
+                REQUIRE(value == 1);
+                REQUIRE(toml_integer_value(toml_object_get(point, "y"), &value) == 0);
+                REQUIRE(value == 2);
+                toml_t name = toml_object_get(doc, "name");
+                REQUIRE(std::string(toml_string_value(toml_object_get(name, "last"))) == "Preston-Werner");
+                toml_t nested = toml_object_get(doc, "nested");
+                REQUIRE(toml_integer_value(toml_object_get(toml_object_get(nested, "a"), "b"), &value) == 0);
+                REQUIRE(value == 1);
+                REQUIRE(toml_array_length(toml_object_get(toml_object_get(nested, "c"), "d")) == 1);
+                REQUIRE(toml_object_get(doc, "empty") != NULL);
+            }
+            THEN("インラインテーブルの後の key は元のテーブルに追加されること") {
+                REQUIRE(std::string(toml_string_value(toml_object_get(doc, "after"))) == "x");
+                REQUIRE(toml_object_get(toml_object_get(doc, "empty"), "after") == NULL);
+            }
+
+            toml_delete(doc, true);
+        }
+    }
+
+    GIVEN("テーブルヘッダーを含む入力を用意する") {
+        std::string input = "title = 'top'\n"
+                            "[owner]\n"
+                            "name = 'Tom'\n"
+                            "[a.b.c]\n"
+                            "d = 'abcd'\n"
+                            "[ a . \"b\" ]\n"
+                            "e = 'abe'\n"
+                            "x.y = 'abxy'\n"
+                            "[a.b.x.z]\n"
+                            "w = 'abxzw'\n"
+                            "[a]\n"
+                            "f = 'af'\n";
+        INFO("入力: '" + input + "'");
+
+        WHEN("読み込む") {
+            toml_t doc = toml_load_from_memory(input.c_str(), input.size());
+            REQUIRE(doc != NULL);
+
+            THEN("各テーブルの値が取得できること") {
+                REQUIRE(std::string(toml_string_value(toml_object_get(doc, "title"))) == "top");
+                toml_t owner = toml_object_get(doc, "owner");
+                REQUIRE(owner != NULL);
+                REQUIRE(std::string(toml_string_value(toml_object_get(owner, "name"))) == "Tom");
+
+                toml_t a = toml_object_get(doc, "a");
+                REQUIRE(a != NULL);
+                REQUIRE(std::string(toml_string_value(toml_object_get(a, "f"))) == "af");
+                toml_t b = toml_object_get(a, "b");
+                REQUIRE(b != NULL);
+                REQUIRE(std::string(toml_string_value(toml_object_get(b, "e"))) == "abe");
+                toml_t c = toml_object_get(b, "c");
+                REQUIRE(c != NULL);
+                REQUIRE(std::string(toml_string_value(toml_object_get(c, "d"))) == "abcd");
+                toml_t x = toml_object_get(b, "x");
+                REQUIRE(x != NULL);
+                REQUIRE(std::string(toml_string_value(toml_object_get(x, "y"))) == "abxy");
+                toml_t z = toml_object_get(x, "z");
+                REQUIRE(z != NULL);
+                REQUIRE(std::string(toml_string_value(toml_object_get(z, "w"))) == "abxzw");
+            }
+
+            toml_delete(doc, true);
+        }
+    }
+
+    GIVEN("配列テーブルを含む入力を用意する") {
+        std::string input = "[[servers]]\n"
+                            "name = 'alpha'\n"
+                            "[servers.tls]\n"
+                            "cert = 'a.pem'\n"
+                            "[[servers.ports]]\n"
+                            "name = 'http'\n"
+                            "[[servers.ports]]\n"
+                            "name = 'https'\n"
+                            "[[servers]]\n"
+                            "name = 'beta'\n"
+                            "[servers.tls]\n"
+                            "cert = 'b.pem'\n";
+        for (int i = 0; i < 1000; ++i) {
+            input += "[[servers]]\nname = 'gen" + std::to_string(i) + "'\n";
+        }
+        INFO("入力長: " + std::to_string(input.size()));
+
+        WHEN("読み込む") {
+            toml_t doc = toml_load_from_memory(input.c_str(), input.size());
+            REQUIRE(doc != NULL);
+
+            THEN("配列の要素ごとにテーブルが作られること") {
+                toml_t servers = toml_object_get(doc, "servers");
+                REQUIRE(servers != NULL);
+                REQUIRE(toml_array_length(servers) == 1002);
+
+                toml_t alpha = toml_array_get(servers, 0);
+                REQUIRE(alpha != NULL);
+                REQUIRE(std::string(toml_string_value(toml_object_get(alpha, "name"))) == "alpha");
+                REQUIRE(std::string(toml_string_value(toml_object_get(toml_object_get(alpha, "tls"), "cert"))) == "a.pem");
+                toml_t ports = toml_object_get(alpha, "ports");
+                REQUIRE(toml_array_length(ports) == 2);
+                REQUIRE(std::string(toml_string_value(toml_object_get(toml_array_get(ports, 1), "name"))) == "https");
+
+                toml_t beta = toml_array_get(servers, 1);
+                REQUIRE(std::string(toml_string_value(toml_object_get(beta, "name"))) == "beta");
+                REQUIRE(std::string(toml_string_value(toml_object_get(toml_object_get(beta, "tls"), "cert"))) == "b.pem");
+                REQUIRE(toml_object_get(beta, "ports") == NULL);
+
+                toml_t last = toml_array_get(servers, 1001);
+                REQUIRE(std::string(toml_string_value(toml_object_get(last, "name"))) == "gen999");
+                REQUIRE(toml_array_get(servers, 1002) == NULL);
+                REQUIRE(toml_array_length(doc) == 0);
+            }
+
+            toml_delete(doc, true);
+        }
+    }
+
+    GIVEN("多数のテーブルを含む入力を用意する") {
+        std::string input;
+        int count = 2000;
+        for (int i = 0; i < count; ++i) {
+            input += "[group" + std::to_string(i % 50) + ".table" + std::to_string(i) + "]\n"
+                     "key = 'value" + std::to_string(i) + "'\n";
+        }
+        for (int i = 0; i < count; i += 7) {
+            input += "[group" + std::to_string(i % 50) + ".table" + std::to_string(i) + ".sub]\n"
+                     "key = 'sub" + std::to_string(i) + "'\n";
+        }
+        INFO("入力長: " + std::to_string(input.size()));
+
+        WHEN("読み込む") {
+            toml_t doc = toml_load_from_memory(input.c_str(), input.size());
+            REQUIRE(doc != NULL);
+
+            THEN("すべてのテーブルの値が取得できること") {
+                for (int i = 0; i < count; ++i) {
+                    toml_t group = toml_object_get(doc, ("group" + std::to_string(i % 50)).c_str());
+                    REQUIRE(group != NULL);
+                    toml_t table = toml_object_get(group, ("table" + std::to_string(i)).c_str());
+                    REQUIRE(table != NULL);
+                    REQUIRE(std::string(toml_string_value(toml_object_get(table, "key"))) == "value" + std::to_string(i));
+                    toml_t sub = toml_object_get(table, "sub");
+                    REQUIRE((sub != NULL) == ((i % 7) == 0));
+                }
+            }
+
+            toml_delete(doc, true);
+        }
+    }
+
+    GIVEN("テーブルを重複して定義する入力を用意する") {
+        std::vector<std::string> inputs = {
+            "[a]\n[a]\n",
+            "[a.b]\n[a]\n[a]\n",
+            "[a.b]\n[a.b]\n",
+            "a = 'x'\n[a]\n",
+            "a.b = 'x'\n[a]\n",
+            "[a]\nb.c = 'x'\n[a.b]\n",
+            "[a.b.c]\n[a]\nb.d = 'x'\n",
+            "[a]\nb = 'x'\n[a.b]\n",
+            "[a]\nb = 'x'\n[a.b.c]\n",
+            "[a]\n[[a]]\n",
+            "[[a]]\n[a]\n",
+            "[a]\nb = 'x'\n[a]\nc = 'y'\n",
+        };
+
+        WHEN("読み込む") {
+            THEN("読み込みに失敗すること") {
+                for (auto &input : inputs) {
+                    INFO("入力: '" + input + "'");
+                    REQUIRE(toml_load_from_memory(input.c_str(), input.size()) == NULL);
+                }
+            }
+        }
+    }
+
+    GIVEN("key を重複して定義する入力を用意する") {
+        std::vector<std::string> inputs = {
+            "a = 'x'\na = 'y'\n",
+            "a.b = 'x'\na.b = 'y'\n",
+            "a = 'x'\na.b = 'y'\n",
+            "a.b = 'x'\na = 'y'\n",
+            "a.b = 'x'\n'a'.\"b\" = 'y'\n",
+        };
+
+        WHEN("読み込む") {
+            THEN("読み込みに失敗すること") {
+                for (auto &input : inputs) {
+                    INFO("入力: '" + input + "'");
+                    REQUIRE(toml_load_from_memory(input.c_str(), input.size()) == NULL);
+                    REQUIRE(toml_load_from_memory_ex(input.c_str(), input.size(), TOML_LOAD_LAZY) == NULL);
+                }
+            }
+        }
+    }
+
+    GIVEN("不正な入力を用意する") {
+        std::vector<std::string> inputs = {
+            "key = value\n",
+            "key = \"value\" trailing\n",
+            "key \"value\"\n",
+            "a. = \"value\"\n",
+            "[a\n",
+            "[a]]\n",
+            "[[a]\n",
+            "[]\n",
+            "[a] b = 'x'\n",
+            "[ [a] ]\n",
+            "key = 08\n",
+            "key = 1__0\n",
+            "key = 9223372036854775808\n",
+            "key = +0x10\n",
+            "key = 1.\n",
+            "key = .5\n",
+            "key = 1e400\n",
+            "key = 1979-02-29\n",
+            "key = 1979-05-27 07:32\n",
+            "key = 1979-05-27T07:32:00 Z\n",
+            "key = 24:00:00\n",
+            "a = [1, 2\n",
+            "a = [1 2]\n",
+            "a = [,]\n",
+            "a = [1,,2]\n",
+            "a = [1] x\n",
+            "a = [1, value]\n",
+            "a = {b = 1,}\n",
+            "a = {b = 1\n}\n",
+            "a = {b = 1, b = 2}\n",
+            "a = {b = 1} x\n",
+            "a = {b = 1}\na.c = 2\n",
+            "a = {b = 1}\n[a]\n",
+            "a = {}\n[a.b]\n",
+            "a = [1]\n[[a]]\n",
+            "a = " + std::string(33, '[') + std::string(33, ']') + "\n",
+            "key = \"\\x41\"\n",
+            "key = \"\\uDC00\"\n",
+            "key = \"\xC0\xAF\"\n",
+            "key = '\xF4\x90\x80\x80'\n",
+            "\"\xE3\x81\" = 1\n",
+            "key = True\n",
+            "key = tru\n",
+            "key = falsey\n",
+            "key = x1\n",
+        };
+
+        WHEN("読み込む") {
+            THEN("読み込みに失敗すること") {
+                for (auto &input : inputs) {
+                    INFO("入力: '" + input + "'");
+                    REQUIRE(toml_load_from_memory(input.c_str(), input.size()) == NULL);
+                }
+            }
+        }
+    }
+}
+
+/**
+ *  parse @c input by feeding chunks of @c chunk_size bytes.
+ *
+ *  @param  [in]    input       input string.
+ *  @param  [in]    chunk_size  chunk size.
+ *  @return parsed document, or NULL on error.
+ */
+static toml_t feed_in_chunks(const std::string &input, size_t chunk_size)
+{
+    toml_parser_t parser = toml_parser_create();
+    REQUIRE(parser != NULL);
+
+    for (size_t pos = 0; pos < input.size(); pos += chunk_size) {
+        std::string chunk = input.substr(pos, chunk_size);
+        if (toml_parser_feed(parser, chunk.data(), chunk.size()) != 0) {
+            break;
+        }
+    }
+
+    return toml_parser_finish(parser);
+}
+
+SCENARIO("分割された入力から TOML が読み込めること", "[ctomat][parser]") {
+
+    GIVEN("入力を以下とする") {
+        std::string input = "title = \"TOML \\\"Example\\\"\" # comment\r\n"
+                            "\n"
+                            "owner = 'Tom'\n"
+                            "database . \"server\" = \"192.168.1.1\"\n"
+                            "last = ''";
+        INFO("入力: '" + input + "'");
+
+        WHEN("様々な大きさに分割して与える") {
+            THEN("一括で読み込んだ場合と同じ値が取得できること") {
+                for (size_t chunk_size = 1; chunk_size <= input.size(); ++chunk_size) {
+                    INFO("分割サイズ: " + std::to_string(chunk_size));
+                    toml_t doc = feed_in_chunks(input, chunk_size);
+                    REQUIRE(doc != NULL);
+                    REQUIRE(std::string(toml_string_value(toml_object_get(doc, "title"))) == "TOML \"Example\"");
+                    REQUIRE(std::string(toml_string_value(toml_object_get(doc, "owner"))) == "Tom");
+                    toml_t database = toml_object_get(doc, "database");
+                    REQUIRE(database != NULL);
+                    REQUIRE(std::string(toml_string_value(toml_object_get(database, "server"))) == "192.168.1.1");
+                    REQUIRE(std::string(toml_string_value(toml_object_get(doc, "last"))) == "");
+                    toml_delete(doc, true);
+                }
+            }
+        }
+    }
+
+    GIVEN("複数行の文字列を含む入力とする") {
+        std::string input = "query = \"\"\"\n"
+                            "SELECT name\n"
+                            "  FROM users\n"
+                            " WHERE id = \"1\";\"\"\"\n"
+                            "folded = \"\"\"\\\n"
+                            "    The quick brown \\\n"
+                            "    fox.\\\n"
+                            "    \"\"\"\n"
+                            "cert = '''\n"
+                            "-----BEGIN CERTIFICATE-----\n"
+                            "MIIB\\x'y\n"
+                            "-----END CERTIFICATE-----'''\n"
+                            "quotes = \"\"\"\"a\"\"\"\"\" # comment\n"
+                            "after = 1\n";
+        INFO("入力: '" + input + "'");
+
+        WHEN("様々な大きさに分割して与える") {
+            THEN("一括で読み込んだ場合と同じ値が取得できること") {
+                for (size_t chunk_size = 1; chunk_size <= input.size(); ++chunk_size) {
+                    INFO("分割サイズ: " + std::to_string(chunk_size));
+                    toml_t doc = feed_in_chunks(input, chunk_size);
+                    REQUIRE(doc != NULL);
+                    REQUIRE(std::string(toml_string_value(toml_object_get(doc, "folded"))) == "The quick brown fox.");
+                    REQUIRE(std::string(toml_string_value(toml_object_get(doc, "cert")))
+                            == "-----BEGIN CERTIFICATE-----\nMIIB\\x'y\n-----END CERTIFICATE-----");
+                    toml_delete(doc, true);
+                }
+            }
+        }
+    }
+
+    GIVEN("テーブルヘッダーを含む入力とする") {
+        std::string input = "[owner]\n"
+                            "name = 'Tom'\n"
+                            "[[servers]]\n"
+                            "name = 'alpha'\n"
+                            "[[servers]]\n"
+                            "name = 'beta'\n";
+
+        WHEN("様々な大きさに分割して与える") {
+            THEN("分割をまたいで現在のテーブルが引き継がれること") {
+                for (size_t chunk_size = 1; chunk_size <= input.size(); ++chunk_size) {
+                    INFO("分割サイズ: " + std::to_string(chunk_size));
+                    toml_t doc = feed_in_chunks(input, chunk_size);
+                    REQUIRE(doc != NULL);
+                    REQUIRE(std::string(toml_string_value(toml_object_get(toml_object_get(doc, "owner"), "name"))) == "Tom");
+                    toml_t servers = toml_object_get(doc, "servers");
+                    REQUIRE(toml_array_length(servers) == 2);
+                    REQUIRE(std::string(toml_string_value(toml_object_get(toml_array_get(servers, 1), "name"))) == "beta");
+                    toml_delete(doc, true);
+                }
+            }
+        }
+    }
+
+    GIVEN("複数行の配列を含む入力とする") {
+        std::string input = "values = [\n"
+                            "  1, 2, # comment\n"
+                            "  3,\n"
+                            "]\n"
+                            "point = { x = 1, y = [2] }\n";
+
+        WHEN("様々な大きさに分割して与える") {
+            THEN("分割をまたいだ配列が取得できること") {
+                for (size_t chunk_size = 1; chunk_size <= input.size(); ++chunk_size) {
+                    INFO("分割サイズ: " + std::to_string(chunk_size));
+                    toml_t doc = feed_in_chunks(input, chunk_size);
+                    REQUIRE(doc != NULL);
+                    size_t length = 0;
+                    const int64_t *values = toml_array_int64(toml_object_get(doc, "values"), &length);
+                    REQUIRE(values != NULL);
+                    REQUIRE(std::vector<int64_t>(values, values + length) == std::vector<int64_t>({1, 2, 3}));
+                    REQUIRE(toml_array_length(toml_object_get(toml_object_get(doc, "point"), "y")) == 1);
+                    toml_delete(doc, true);
+                }
+            }
+        }
+    }
+
+    GIVEN("長い配列と複数行の文字列を含む入力とする") {
+        const size_t count = 20000;
+        std::string input = "values = [\n";
+        for (size_t i = 0; i < count; ++i) {
+            input += "  [" + std::to_string(i) + ", 'a]'],\n";
+        }
+        input += "]\ntext = \"\"\"\n";
+        for (size_t i = 0; i < count; ++i) {
+            input += "line \"" + std::to_string(i) + "\"\n";
+        }
+        input += "\"\"\"\nafter = 1\n";
+
+        WHEN("行ごとに分割して与える") {
+            toml_parser_t parser = toml_parser_create();
+            REQUIRE(parser != NULL);
+            size_t head = 0;
+            for (size_t tail = input.find('\n'); tail != std::string::npos; tail = input.find('\n', head)) {
+                REQUIRE(toml_parser_feed(parser, input.data() + head, tail + 1 - head) == 0);
+                head = tail + 1;
+            }
+            toml_t doc = toml_parser_finish(parser);
+
+            THEN("一括で読み込んだ場合と同じ値が取得できること") {
+                REQUIRE(doc != NULL);
+                toml_t values = toml_object_get(doc, "values");
+                REQUIRE(toml_array_length(values) == count);
+                int64_t value = 0;
+                REQUIRE(toml_integer_value(toml_array_get(toml_array_get(values, count - 1), 0), &value) == 0);
+                REQUIRE(value == (int64_t)(count - 1));
+                std::string text = toml_string_value(toml_object_get(doc, "text"));
+                REQUIRE(text.size() == input.find("\"\"\"\nafter") - input.find("line \"0\""));
+                REQUIRE(toml_integer_value(toml_object_get(doc, "after"), &value) == 0);
+                REQUIRE(value == 1);
+            }
+
+            toml_delete(doc, true);
+        }
+    }
+
+    GIVEN("空の chunk とする") {
+        WHEN("与える") {
+            toml_parser_t parser = toml_parser_create();
+            REQUIRE(parser != NULL);
+
+            THEN("何もせず成功すること") {
+                REQUIRE(toml_parser_feed(parser, NULL, 0) == 0);
+                REQUIRE(toml_parser_feed(parser, "key = 1\n", 8) == 0);
+                REQUIRE(toml_parser_feed(parser, "", 0) == 0);
+                toml_t doc = toml_parser_finish(parser);
+                REQUIRE(doc != NULL);
+                int64_t value = 0;
+                REQUIRE(toml_integer_value(toml_object_get(doc, "key"), &value) == 0);
+                REQUIRE(value == 1);
+                toml_delete(doc, true);
+            }
+        }
+    }
+
+    GIVEN("途中に不正な行を含む入力とする") {
+        std::string input = "key = \"value\"\n"
+                            "broken = value\n"
+                            "other = \"value\"\n";
+
+        WHEN("分割して与える") {
+            toml_parser_t parser = toml_parser_create();
+            REQUIRE(parser != NULL);
+
+            THEN("不正な行を含む chunk で失敗すること") {
+                REQUIRE(toml_parser_feed(parser, input.data(), 14) == 0);
+                REQUIRE(toml_parser_feed(parser, input.data() + 14, 15) == -1);
+                REQUIRE(toml_parser_feed(parser, input.data() + 29, input.size() - 29) == -1);
+                REQUIRE(toml_parser_finish(parser) == NULL);
+            }
+        }
+    }
+
+    GIVEN("終端していない文字列で終わる入力とする") {
+        std::string input = "key = \"value\"\nother = \"unterminated";
+
+        WHEN("分割して与える") {
+            toml_t doc = feed_in_chunks(input, 4);
+
+            THEN("finish で失敗すること") {
+                REQUIRE(doc == NULL);
+            }
+        }
+    }
+
+    GIVEN("何も与えない") {
+        WHEN("finish する") {
+            toml_parser_t parser = toml_parser_create();
+            REQUIRE(parser != NULL);
+            toml_t doc = toml_parser_finish(parser);
+
+            THEN("空のドキュメントが得られること") {
+                REQUIRE(doc != NULL);
+                REQUIRE(toml_object_get(doc, "key") == NULL);
+            }
+
+            toml_delete(doc, true);
+        }
+    }
+}
+
+/**
+ *  records events as text.
+ */
+struct event_log {
+    std::vector<std::string> events;
+    int stop_after;
+};
+
+static int log_key(void *ctx, const toml_view_t *path, size_t depth)
+{
+    struct event_log *log = (struct event_log *)ctx;
+    std::string event = "key";
+    for (size_t i = 0; i < depth; ++i) {
+        event += " " + std::string(path[i].ptr, path[i].length);
+    }
+    log->events.push_back(event);
+
+    return ((int)log->events.size() == log->stop_after) ? -1 : 0;
+}
+
+static int log_string(void *ctx, toml_view_t value, bool literal)
+{
+    struct event_log *log = (struct event_log *)ctx;
+    log->events.push_back(std::string(literal ? "literal " : "basic ") + std::string(value.ptr, value.length));
+
+    return ((int)log->events.size() == log->stop_after) ? -1 : 0;
+}
+
+static int log_integer(void *ctx, int64_t value)
+{
+    struct event_log *log = (struct event_log *)ctx;
+    log->events.push_back("integer " + std::to_string(value));
+
+    return ((int)log->events.size() == log->stop_after) ? -1 : 0;
+}
+
+static int log_float(void *ctx, double value)
+{
+    struct event_log *log = (struct event_log *)ctx;
+    char text[32];
+    std::snprintf(text, sizeof(text), "float %g", value);
+    log->events.push_back(text);
+
+    return ((int)log->events.size() == log->stop_after) ? -1 : 0;
+}
+
+static int log_boolean(void *ctx, bool value)
+{
+    struct event_log *log = (struct event_log *)ctx;
+    log->events.push_back(value ? "boolean true" : "boolean false");
+
+    return ((int)log->events.size() == log->stop_after) ? -1 : 0;
+}
+
+static int log_datetime(void *ctx, const toml_datetime_t *value)
+{
+    struct event_log *log = (struct event_log *)ctx;
+    log->events.push_back("datetime " + std::to_string(value->seconds) + " " + std::to_string(value->offset));
+
+    return ((int)log->events.size() == log->stop_after) ? -1 : 0;
+}
+
+static int log_event(void *ctx, const char *event)
+{
+    struct event_log *log = (struct event_log *)ctx;
+    log->events.push_back(event);
+
+    return ((int)log->events.size() == log->stop_after) ? -1 : 0;
+}
+
+static int log_array_begin(void *ctx)
+{
+    return log_event(ctx, "array_begin");
+}
+
+static int log_array_end(void *ctx)
+{
+    return log_event(ctx, "array_end");
+}
+
+static int log_inline_table_begin(void *ctx)
+{
+    return log_event(ctx, "inline_table_begin");
+}
+
+static int log_inline_table_end(void *ctx)
+{
+    return log_event(ctx, "inline_table_end");
+}
+
+static int log_header(struct event_log *log, std::string event, const toml_view_t *path, size_t depth)
+{
+    for (size_t i = 0; i < depth; ++i) {
+        event += " " + std::string(path[i].ptr, path[i].length);
+    }
+    log->events.push_back(event);
+
+    return ((int)log->events.size() == log->stop_after) ? -1 : 0;
+}
+
+static int log_table(void *ctx, const toml_view_t *path, size_t depth)
+{
+    return log_header((struct event_log *)ctx, "table", path, depth);
+}
+
+static int log_array_table(void *ctx, const toml_view_t *path, size_t depth)
+{
+    return log_header((struct event_log *)ctx, "array_table", path, depth);
+}
+
+SCENARIO("ツリーを作らずにイベントとして読み込めること", "[ctomat][events]") {
+
+    struct toml_callbacks callbacks = {};
+    callbacks.table = log_table;
+    callbacks.array_table = log_array_table;
+    callbacks.key = log_key;
+    callbacks.string = log_string;
+    callbacks.integer = log_integer;
+    callbacks.floating = log_float;
+    callbacks.boolean = log_boolean;
+    callbacks.datetime = log_datetime;
+    callbacks.array_begin = log_array_begin;
+    callbacks.array_end = log_array_end;
+    callbacks.inline_table_begin = log_inline_table_begin;
+    callbacks.inline_table_end = log_inline_table_end;
+
+    GIVEN("入力を以下とする") {
+        std::string input = "title = \"TOML \\\"Example\\\"\" # comment\n"
+                            "database.\"server\" = '192.168.1.1'\n"
+                            "database.port = 0x1F90\n"
+                            "ratio = 0.5\n"
+                            "since = 1979-05-27T00:32:00-07:00\n"
+                            "enabled = true\n"
+                            "list = [1, { a = 'x' }]\n";
+        INFO("入力: '" + input + "'");
+
+        WHEN("イベントとして読み込む") {
+            struct event_log log = {{}, 0};
+            int ret = toml_parse_events(input.c_str(), input.size(), &callbacks, &log);
+
+            THEN("key と値のイベントが順に得られること") {
+                REQUIRE(ret == 0);
+                std::vector<std::string> expected = {
+                    "key title",
+                    "basic TOML \\\"Example\\\"",
+                    "key database server",
+                    "literal 192.168.1.1",
+                    "key database port",
+                    "integer 8080",
+                    "key ratio",
+                    "float 0.5",
+                    "key since",
+                    "datetime 296638320 -420",
+                    "key enabled",
+                    "boolean true",
+                    "key list",
+                    "array_begin",
+                    "integer 1",
+                    "inline_table_begin",
+                    "key a",
+                    "literal x",
+                    "inline_table_end",
+                    "array_end",
+                };
+                REQUIRE(log.events == expected);
+            }
+        }
+
+        WHEN("コールバックが途中で中断する") {
+            struct event_log log = {{}, 3};
+            int ret = toml_parse_events(input.c_str(), input.size(), &callbacks, &log);
+
+            THEN("以降のイベントが得られず失敗すること") {
+                REQUIRE(ret == -1);
+                REQUIRE(errno == ECANCELED);
+                REQUIRE(log.events.size() == 3);
+            }
+        }
+    }
+
+    GIVEN("テーブルヘッダーを含む入力とする") {
+        std::string input = "[a.'b']\n"
+                            "c = 'x'\n"
+                            "[[d]] # comment\n";
+
+        WHEN("イベントとして読み込む") {
+            struct event_log log = {{}, 0};
+            int ret = toml_parse_events(input.c_str(), input.size(), &callbacks, &log);
+
+            THEN("ヘッダーのイベントが得られること") {
+                REQUIRE(ret == 0);
+                std::vector<std::string> expected = {
+                    "table a b",
+                    "key c",
+                    "literal x",
+                    "array_table d",
+                };
+                REQUIRE(log.events == expected);
+            }
+        }
+    }
+
+    GIVEN("途中に不正な行を含む入力とする") {
+        std::string input = "key = \"value\"\n"
+                            "broken = value\n";
+
+        WHEN("イベントとして読み込む") {
+            struct event_log log = {{}, 0};
+            int ret = toml_parse_events(input.c_str(), input.size(), &callbacks, &log);
+
+            THEN("不正な行の手前までのイベントが得られ失敗すること") {
+                REQUIRE(ret == -1);
+                REQUIRE(errno == EINVAL);
+                REQUIRE(log.events.size() == 2);
+            }
+        }
+    }
+}
+
+static int log_raw(void *ctx, toml_view_t value)
+{
+    struct event_log *log = (struct event_log *)ctx;
+    log->events.push_back("raw " + std::string(value.ptr, value.length));
+
+    return 0;
+}
+
+SCENARIO("値を書かれたままのイベントとして読み込めること", "[ctomat][events]") {
+
+    GIVEN("入力を以下とする") {
+        std::string input = "a = \"x\"\n"
+                            "b = 'y'\n"
+                            "c = 1979-05-27\n"
+                            "d = \"\"\"\nline\n\"\"\"\n"
+                            "e = '''q'''\n";
+
+        WHEN("raw コールバックを指定して読み込む") {
+            struct toml_callbacks callbacks = {};
+            callbacks.key = log_key;
+            callbacks.string = log_string;
+            callbacks.raw = log_raw;
+            struct event_log log = {{}, 0};
+            int ret = toml_parse_events(input.c_str(), input.size(), &callbacks, &log);
+
+            THEN("値が引用符を含めて得られること") {
+                REQUIRE(ret == 0);
+                std::vector<std::string> expected = {
+                    "key a", "raw \"x\"",
+                    "key b", "raw 'y'",
+                    "key c", "raw 1979-05-27",
+                    "key d", "raw \"\"\"\nline\n\"\"\"",
+                    "key e", "raw '''q'''",
+                };
+                REQUIRE(log.events == expected);
+            }
+        }
+    }
+}
+
+SCENARIO("大きな入力を並列に読み込めること", "[ctomat][parallel]") {
+
+    GIVEN("多数の key と長い行を含む入力を用意する") {
+        std::string input;
+        int count = 40000;
+        for (int i = 0; i < count; ++i) {
+            input += "group" + std::to_string(i % 10) + ".key" + std::to_string(i) + " = \"value" + std::to_string(i) + "\"\n";
+            if (i == (count / 3)) {
+                input += "long = '" + std::string(512 * 1024, 'x') + "' # long line\n";
+            }
+        }
+        INFO("入力長: " + std::to_string(input.size()));
+
+        WHEN("4 スレッドで読み込む") {
+            toml_t doc = toml_load_from_memory_parallel(input.c_str(), input.size(), 4);
+            REQUIRE(doc != NULL);
+
+            THEN("すべての値が取得できること") {
+                for (int i = 0; i < count; i += 997) {
+                    toml_t group = toml_object_get(doc, ("group" + std::to_string(i % 10)).c_str());
+                    REQUIRE(group != NULL);
+                    toml_t key = toml_object_get(group, ("key" + std::to_string(i)).c_str());
+                    REQUIRE(key != NULL);
+                    REQUIRE(std::string(toml_string_value(key)) == "value" + std::to_string(i));
+                }
+                REQUIRE(std::string(toml_string_value(toml_object_get(doc, "long"))).size() == 512 * 1024);
+            }
+
+            toml_delete(doc, true);
+        }
+
+        WHEN("末尾に不正な行を加えて読み込む") {
+            input += "broken = value";
+            toml_t doc = toml_load_from_memory_parallel(input.c_str(), input.size(), 4);
+
+            THEN("読み込みに失敗すること") {
+                REQUIRE(doc == NULL);
+            }
+        }
+    }
+
+    GIVEN("多数の配列テーブルを含む入力を用意する") {
+        std::string input = "[config]\nname = 'servers'\n";
+        int count = 30000;
+        for (int i = 0; i < count; ++i) {
+            input += "[[servers]]\nname = \"server" + std::to_string(i) + "\"\nport = " + std::to_string(i) + "\n"
+                     "enabled = " + (((i % 2) == 0) ? "true" : "false") + "\n";
+        }
+        INFO("入力長: " + std::to_string(input.size()));
+
+        WHEN("4 スレッドで読み込む") {
+            toml_t doc = toml_load_from_memory_parallel(input.c_str(), input.size(), 4);
+            REQUIRE(doc != NULL);
+
+            THEN("分割をまたいで配列に追加されること") {
+                toml_t servers = toml_object_get(doc, "servers");
+                REQUIRE(toml_array_length(servers) == (size_t)count);
+                for (int i = 0; i < count; i += 997) {
+                    toml_t server = toml_array_get(servers, i);
+                    REQUIRE(std::string(toml_string_value(toml_object_get(server, "name"))) == "server" + std::to_string(i));
+                    int64_t port = 0;
+                    REQUIRE(toml_integer_value(toml_object_get(server, "port"), &port) == 0);
+                    REQUIRE(port == i);
+                    bool enabled = false;
+                    REQUIRE(toml_boolean_value(toml_object_get(server, "enabled"), &enabled) == 0);
+                    REQUIRE(enabled == ((i % 2) == 0));
+                }
+                REQUIRE(std::string(toml_string_value(toml_object_get(toml_object_get(doc, "config"), "name"))) == "servers");
+            }
+
+            toml_delete(doc, true);
+        }
+    }
+
+    GIVEN("複数行の配列とインラインテーブルを含む入力を用意する") {
+        std::string input;
+        int count = 30000;
+        for (int i = 0; i < count; ++i) {
+            input += "[item" + std::to_string(i) + "]\n"
+                     "point = { x = " + std::to_string(i) + ", tags = ['a', 'b'] }\n"
+                     "values = [\n  " + std::to_string(i) + ",\n  " + std::to_string(i + 1) + ",\n]\n";
+        }
+        INFO("入力長: " + std::to_string(input.size()));
+
+        WHEN("4 スレッドで読み込む") {
+            toml_t doc = toml_load_from_memory_parallel(input.c_str(), input.size(), 4);
+            REQUIRE(doc != NULL);
+
+            THEN("すべての値が取得できること") {
+                for (int i = 0; i < count; i += 997) {
+                    toml_t item = toml_object_get(doc, ("item" + std::to_string(i)).c_str());
+                    REQUIRE(item != NULL);
+                    int64_t x = 0;
+                    REQUIRE(toml_integer_value(toml_object_get(toml_object_get(item, "point"), "x"), &x) == 0);
+                    REQUIRE(x == i);
+                    size_t length = 0;
+                    const int64_t *values = toml_array_int64(toml_object_get(item, "values"), &length);
+                    REQUIRE(values != NULL);
+                    REQUIRE(length == 2);
+                    REQUIRE(values[1] == i + 1);
+                }
+            }
+
+            toml_delete(doc, true);
+        }
+    }
+
+    GIVEN("分割をまたいで同じテーブルを開き直す入力を用意する") {
+        std::string input = "title = 'tables'\n";
+        int count = 20000;
+        for (int i = 0; i < count; ++i) {
+            input += "[[servers]]\nname = \"server" + std::to_string(i) + "\"\n"
+                     "[servers.limits]\nmax = " + std::to_string(i) + "\n"
+                     "[group.g" + std::to_string(i % 7) + ".item" + std::to_string(i) + "]\n"
+                     "value = " + std::to_string(i) + "\n";
+        }
+        input += "[group]\nname = 'groups'\n";
+        INFO("入力長: " + std::to_string(input.size()));
+
+        WHEN("4 スレッドで読み込む") {
+            toml_t doc = toml_load_from_memory_parallel(input.c_str(), input.size(), 4);
+            REQUIRE(doc != NULL);
+
+            THEN("分割をまたいだテーブルがまとめられること") {
+                toml_t servers = toml_object_get(doc, "servers");
+                REQUIRE(toml_array_length(servers) == (size_t)count);
+                toml_t group = toml_object_get(doc, "group");
+                REQUIRE(std::string(toml_string_value(toml_object_get(group, "name"))) == "groups");
+                for (int i = 0; i < count; i += 997) {
+                    int64_t value = 0;
+                    toml_t limits = toml_object_get(toml_array_get(servers, i), "limits");
+                    REQUIRE(toml_integer_value(toml_object_get(limits, "max"), &value) == 0);
+                    REQUIRE(value == i);
+                    toml_t g = toml_object_get(group, ("g" + std::to_string(i % 7)).c_str());
+                    toml_t item = toml_object_get(g, ("item" + std::to_string(i)).c_str());
+                    REQUIRE(toml_integer_value(toml_object_get(item, "value"), &value) == 0);
+                    REQUIRE(value == i);
+                }
+            }
+
+            THEN("直列に読み込んだ場合と同じ順序の木となること") {
+                toml_t serial = toml_load_from_memory(input.c_str(), input.size());
+                REQUIRE(serial != NULL);
+                char dir[] = "/tmp/ctomat_test_XXXXXX";
+                REQUIRE(mkdtemp(dir) != NULL);
+                std::string expected = std::string(dir) + "/serial.ctomatc";
+                std::string actual = std::string(dir) + "/parallel.ctomatc";
+                REQUIRE(toml_compile(serial, expected.c_str()) == 0);
+                REQUIRE(toml_compile(doc, actual.c_str()) == 0);
+                REQUIRE(read_file(actual) == read_file(expected));
+                unlink(expected.c_str());
+                unlink(actual.c_str());
+                rmdir(dir);
+                toml_delete(serial, true);
+            }
+
+            toml_delete(doc, true);
+        }
+
+        WHEN("後ろの分割で同じテーブルを定義し直して読み込む") {
+            input += "[group.g0.item0]\nvalue = 0\n";
+            toml_t doc = toml_load_from_memory_parallel(input.c_str(), input.size(), 4);
+
+            THEN("読み込みに失敗すること") {
+                REQUIRE(doc == NULL);
+            }
+        }
+    }
+
+    GIVEN("小さな入力を用意する") {
+        std::string input = "key = \"value\"";
+
+        WHEN("並列に読み込む") {
+            toml_t doc = toml_load_from_memory_parallel(input.c_str(), input.size(), 0);
+            REQUIRE(doc != NULL);
+
+            THEN("値が取得できること") {
+                REQUIRE(std::string(toml_string_value(toml_object_get(doc, "key"))) == "value");
+            }
+
+            toml_delete(doc, true);
+        }
+    }
+
+    GIVEN("NULL とする") {
+        WHEN("読み込む") {
+            THEN("EINVAL で失敗すること") {
+                REQUIRE(toml_load_from_memory_parallel(NULL, 0, 4) == NULL);
+                REQUIRE(errno == EINVAL);
+                REQUIRE(toml_load_from_memory_ex(NULL, 0, 0) == NULL);
+                REQUIRE(errno == EINVAL);
+            }
+        }
+    }
+}
+
+SCENARIO("値を参照時に解釈する遅延読み込みができること", "[ctomat][lazy]") {
+
+    GIVEN("入力を以下とする") {
+        std::string input = "title = \"TOML Example\"\n"
+                            "owner = 'Tom' # comment\n"
+                            "database.server = \"192.168.1.1\"\n"
+                            "broken = value\n";
+        INFO("入力: '" + input + "'");
+
+        WHEN("遅延読み込みする") {
+            toml_t doc = toml_load_from_memory_ex(input.c_str(), input.size(), TOML_LOAD_LAZY);
+            REQUIRE(doc != NULL);
+
+            THEN("参照した値が取得できること") {
+                REQUIRE(std::string(toml_string_value(toml_object_get(doc, "title"))) == "TOML Example");
+                REQUIRE(std::string(toml_string_value(toml_object_get(doc, "owner"))) == "Tom");
+                toml_t database = toml_object_get(doc, "database");
+                REQUIRE(database != NULL);
+                REQUIRE(std::string(toml_string_value(toml_object_get(database, "server"))) == "192.168.1.1");
+            }
+            THEN("値が変更できること") {
+                toml_t owner = toml_object_get(doc, "owner");
+                REQUIRE(toml_string_set(owner, "Jerry") == 0);
+                REQUIRE(std::string(toml_string_value(owner)) == "Jerry");
+            }
+            THEN("不正な値は参照時に失敗すること") {
+                toml_t broken = toml_object_get(doc, "broken");
+                REQUIRE(broken != NULL);
+                REQUIRE(toml_string_value(broken) == NULL);
+                REQUIRE(errno == EINVAL);
+            }
+
+            toml_delete(doc, true);
+        }
+
+        WHEN("通常の読み込みをする") {
+            toml_t doc = toml_load_from_memory(input.c_str(), input.size());
+
+            THEN("不正な値で失敗すること") {
+                REQUIRE(doc == NULL);
+            }
+        }
+    }
+
+    GIVEN("ファイルを用意する") {
+        std::string pathname = write_temp_file("key = 'value'\n");
+
+        WHEN("遅延読み込みする") {
+            toml_t doc = toml_load_ex(pathname.c_str(), TOML_LOAD_LAZY);
+            REQUIRE(doc != NULL);
+
+            THEN("値が取得できること") {
+                REQUIRE(std::string(toml_string_value(toml_object_get(doc, "key"))) == "value");
+            }
+
+            toml_delete(doc, true);
+        }
+
+        unlink(pathname.c_str());
+    }
+}
+
+SCENARIO("コンパイル済みのパスで値が取得できること", "[ctomat][path]") {
+
+    GIVEN("入れ子の key を含むドキュメントを読み込む") {
+        std::string input = "title = 'TOML'\n"
+                            "server.pool.max_conns = \"64\"\n"
+                            "site.\"google.com\" = 'x'\n";
+        toml_t doc = toml_load_from_memory(input.c_str(), input.size());
+        REQUIRE(doc != NULL);
+
+        WHEN("dotted-key をコンパイルする") {
+            toml_path_t path = toml_path_compile("server . pool.max_conns");
+            REQUIRE(path != NULL);
+
+            THEN("繰り返し値が取得できること") {
+                for (int i = 0; i < 3; ++i) {
+                    toml_t value = toml_path_get(doc, path);
+                    REQUIRE(value != NULL);
+                    REQUIRE(std::string(toml_string_value(value)) == "64");
+                }
+            }
+            THEN("途中のテーブルからの相対パスとしても使えること") {
+                toml_path_t relative = toml_path_compile("pool.max_conns");
+                REQUIRE(relative != NULL);
+                REQUIRE(toml_path_get(toml_object_get(doc, "server"), relative) == toml_path_get(doc, path));
+                toml_path_release(relative);
+            }
+
+            toml_path_release(path);
+        }
+
+        WHEN("quoted-key を含むパスをコンパイルする") {
+            toml_path_t path = toml_path_compile("site.\"google.com\"");
+            REQUIRE(path != NULL);
+
+            THEN("値が取得できること") {
+                REQUIRE(std::string(toml_string_value(toml_path_get(doc, path))) == "x");
+            }
+
+            toml_path_release(path);
+        }
+
+        WHEN("存在しないパスをコンパイルする") {
+            toml_path_t path = toml_path_compile("server.pool.min_conns");
+            REQUIRE(path != NULL);
+
+            THEN("値が取得できないこと") {
+                REQUIRE(toml_path_get(doc, path) == NULL);
+                REQUIRE(errno == ENOENT);
+            }
+
+            toml_path_release(path);
+        }
+
+        WHEN("値を途中に含むパスをコンパイルする") {
+            toml_path_t path = toml_path_compile("title.x");
+            REQUIRE(path != NULL);
+
+            THEN("値が取得できないこと") {
+                REQUIRE(toml_path_get(doc, path) == NULL);
+            }
+
+            toml_path_release(path);
+        }
+
+        toml_delete(doc, true);
+    }
+
+    GIVEN("不正なパスとする") {
+        std::vector<std::string> paths = {
+            "", "a.", ".a", "a..b", "a b", "a = b", "a # comment", "'unterminated",
+        };
+
+        WHEN("コンパイルする") {
+            THEN("失敗すること") {
+                for (auto &path : paths) {
+                    INFO("パス: '" + path + "'");
+                    REQUIRE(toml_path_compile(path.c_str()) == NULL);
+                    REQUIRE(errno == EINVAL);
+                }
+            }
+        }
+    }
+}
+
+SCENARIO("エスケープを含む key が解かれた名前で扱えること", "[ctomat][key]") {
+
+    GIVEN("エスケープを含む key のドキュメントを読み込む") {
+        std::string input = "\"a\\tb\" = 'ab'\n"
+                            "'c\\td' = 'cd'\n"
+                            "site.\"\\u0067oogle.com\" = 'x'\n"
+                            "[\"t\\u0061ble\"]\n"
+                            "key = 'k'\n";
+        toml_t doc = toml_load_from_memory(input.c_str(), input.size());
+        REQUIRE(doc != NULL);
+
+        WHEN("解かれた名前で取得する") {
+            THEN("値が取得できること") {
+                REQUIRE(std::string(toml_string_value(toml_object_get(doc, "a\tb"))) == "ab");
+                REQUIRE(toml_object_get(doc, "a\\tb") == NULL);
+                REQUIRE(std::string(toml_string_value(toml_object_get(toml_object_get(doc, "table"), "key"))) == "k");
+            }
+            THEN("literal string の key はそのままの名前であること") {
+                REQUIRE(std::string(toml_string_value(toml_object_get(doc, "c\\td"))) == "cd");
+            }
+        }
+
+        WHEN("エスケープを含むパスをコンパイルする") {
+            toml_path_t path = toml_path_compile("site.\"\\u0067oogle\\u002ecom\"");
+            REQUIRE(path != NULL);
+
+            THEN("同じ名前の値が取得できること") {
+                REQUIRE(std::string(toml_string_value(toml_path_get(doc, path))) == "x");
+            }
+
+            toml_path_release(path);
+        }
+
+        toml_delete(doc, true);
+    }
+
+    GIVEN("エスケープを解くと重複する key の入力を用意する") {
+        std::vector<std::string> inputs = {
+            "\"\\u0061\" = 1\na = 2\n",
+            "a.b = 1\n\"\\u0061\".\"\\u0062\" = 2\n",
+            "[a]\n[\"\\u0061\"]\n",
+            "[\"\\u0061\".b]\n[a.b]\n",
+            "a = 1\n[\"\\u0061\"]\n",
+        };
+
+        WHEN("読み込む") {
+            THEN("読み込みに失敗すること") {
+                for (auto &input : inputs) {
+                    INFO("入力: '" + input + "'");
+                    REQUIRE(toml_load_from_memory(input.c_str(), input.size()) == NULL);
+                    REQUIRE(toml_load_from_memory_ex(input.c_str(), input.size(), TOML_LOAD_LAZY) == NULL);
+                }
+            }
+        }
+    }
+}
+
+SCENARIO("TOML が書き出せること", "[ctomat][save]") {
+
+    GIVEN("テーブルと配列を含む入力とする") {
+        std::string input = "title = 'example'\n"
+                            "ports = [8001, 8002]\n"
+                            "point = { x = 1, y = 2 }\n"
+                            "empty = {}\n"
+                            "nested = [[1, 2], ['a']]\n"
+                            "\n"
+                            "[owner]\n"
+                            "name = \"Tom\"\n"
+                            "\n"
+                            "[servers.alpha]\n"
+                            "ip = '10.0.0.1'\n"
+                            "\n"
+                            "[[products]]\n"
+                            "name = 'Hammer'\n"
+                            "\n"
+                            "[[products]]\n"
+                            "\n"
+                            "[\"quoted key\"]\n"
+                            "a.b = 1\n";
+        std::string expected = "title = 'example'\n"
+                               "ports = [8001, 8002]\n"
+                               "point = { x = 1, y = 2 }\n"
+                               "empty = {}\n"
+                               "nested = [[1, 2], ['a']]\n"
+                               "\n"
+                               "[owner]\n"
+                               "name = \"Tom\"\n"
+                               "\n"
+                               "[servers.alpha]\n"
+                               "ip = '10.0.0.1'\n"
+                               "\n"
+                               "[[products]]\n"
+                               "name = 'Hammer'\n"
+                               "\n"
+                               "[[products]]\n"
+                               "\n"
+                               "['quoted key']\n"
+                               "\n"
+                               "['quoted key'.a]\n"
+                               "b = 1\n";
+        toml_t doc = load_without_source(input);
+        REQUIRE(doc != NULL);
+
+        WHEN("十分な大きさのバッファに書き出す") {
+            char buf[512];
+            ssize_t length = toml_save_to_memory(doc, buf, sizeof(buf));
+
+            THEN("表の見出しを含めて書き出されること") {
+                REQUIRE(length == (ssize_t)expected.size());
+                REQUIRE(std::string(buf) == expected);
+            }
+            THEN("書き出した文書を読み込み直せること") {
+                toml_t copy = toml_load_from_memory(buf, length);
+                REQUIRE(copy != NULL);
+                char again[512];
+                REQUIRE(toml_save_to_memory(copy, again, sizeof(again)) == length);
+                REQUIRE(std::string(again) == expected);
+                toml_delete(copy, true);
+            }
+        }
+
+        WHEN("バッファなしで書き出す") {
+            THEN("必要な大きさが得られること") {
+                REQUIRE(toml_save_to_memory(doc, NULL, 0) == (ssize_t)expected.size());
+            }
+        }
+
+        WHEN("小さなバッファに書き出す") {
+            char buf[16];
+            memset(buf, 'x', sizeof(buf));
+            ssize_t length = toml_save_to_memory(doc, buf, sizeof(buf));
+
+            THEN("必要な大きさが得られ、収まる分が NUL 終端で書き出されること") {
+                REQUIRE(length == (ssize_t)expected.size());
+                REQUIRE(std::string(buf) == expected.substr(0, sizeof(buf) - 1));
+            }
+        }
+
+        WHEN("ちょうどの大きさのバッファに書き出す") {
+            std::vector<char> buf(expected.size() + 1);
+            ssize_t length = toml_save_to_memory(doc, buf.data(), buf.size());
+
+            THEN("すべて書き出されること") {
+                REQUIRE(length == (ssize_t)expected.size());
+                REQUIRE(std::string(buf.data()) == expected);
+            }
+        }
+
+        WHEN("NULL を書き出す") {
+            THEN("EINVAL で失敗すること") {
+                char buf[16];
+                REQUIRE(toml_save_to_memory(NULL, buf, sizeof(buf)) == -1);
+                REQUIRE(errno == EINVAL);
+            }
+        }
+
+        toml_delete(doc, true);
+    }
+
+    GIVEN("引用符やエスケープを要する key を含む入力とする") {
+        std::string input = "\"e\\\"f\" = 3\n"
+                            "\"g\\\\h\" = 4\n"
+                            "\"i\\tj\" = 5\n"
+                            "\"k'\\\"\" = 6\n"
+                            "\"l\\u0001\" = 7\n"
+                            "[\"m\\\"n\"]\n";
+        std::string expected = "'e\"f' = 3\n"
+                               "'g\\h' = 4\n"
+                               "'i\tj' = 5\n"
+                               "\"k'\\\"\" = 6\n"
+                               "\"l\\u0001\" = 7\n"
+                               "\n"
+                               "['m\"n']\n";
+        toml_t doc = load_without_source(input);
+        REQUIRE(doc != NULL);
+
+        WHEN("書き出す") {
+            char buf[256];
+            ssize_t length = toml_save_to_memory(doc, buf, sizeof(buf));
+
+            THEN("同じ名前を表す key として書き出されること") {
+                REQUIRE(length == (ssize_t)expected.size());
+                REQUIRE(std::string(buf) == expected);
+            }
+            THEN("書き出した文書から同じ key で値が取得できること") {
+                toml_t copy = toml_load_from_memory(buf, length);
+                REQUIRE(copy != NULL);
+                for (const char *key : {"e\"f", "g\\h", "i\tj", "k'\"", "l\x01", "m\"n"}) {
+                    INFO(std::string("key: ") + key);
+                    REQUIRE(toml_object_get(copy, key) != NULL);
+                }
+                toml_delete(copy, true);
+            }
+        }
+
+        toml_delete(doc, true);
+    }
+
+    GIVEN("ファイルに書き出す文書とする") {
+        std::string input = "title = 'example'\n"
+                            "\n"
+                            "[owner]\n"
+                            "name = \"Tom\"\n";
+        toml_t doc = toml_load_from_memory(input.c_str(), input.size());
+        REQUIRE(doc != NULL);
+        char dir[] = "/tmp/ctomat_test_XXXXXX";
+        REQUIRE(mkdtemp(dir) != NULL);
+        std::string pathname = std::string(dir) + "/config.toml";
+
+        WHEN("新しいファイルに書き出す") {
+            REQUIRE(toml_save(doc, pathname.c_str()) == 0);
+
+            THEN("文書が書き出され、一時ファイルが残らないこと") {
+                REQUIRE(read_file(pathname) == input);
+                DIR *entries = opendir(dir);
+                REQUIRE(entries != NULL);
+                int count = 0;
+                for (struct dirent *entry; (entry = readdir(entries)) != NULL;) {
+                    count += (entry->d_name[0] != '.');
+                }
+                closedir(entries);
+                REQUIRE(count == 1);
+            }
+        }
+
+        WHEN("既存のファイルを上書きする") {
+            int fd = open(pathname.c_str(), O_WRONLY | O_CREAT, 0640);
+            REQUIRE(fd != -1);
+            REQUIRE(write(fd, "old = 1\nlonger = 'contents'\n", 28) == 28);
+            close(fd);
+            REQUIRE(chmod(pathname.c_str(), 0640) == 0);
+            REQUIRE(toml_save(doc, pathname.c_str()) == 0);
+
+            THEN("内容が置き換わり、パーミッションが保たれること") {
+                REQUIRE(read_file(pathname) == input);
+                struct stat st;
+                REQUIRE(stat(pathname.c_str(), &st) == 0);
+                REQUIRE((st.st_mode & 0777) == 0640);
+            }
+        }
+
+        WHEN("存在しないディレクトリに書き出す") {
+            std::string missing = std::string(dir) + "/missing/config.toml";
+
+            THEN("失敗すること") {
+                REQUIRE(toml_save(doc, missing.c_str()) == -1);
+                REQUIRE(errno == ENOENT);
+            }
+        }
+
+        unlink(pathname.c_str());
+        rmdir(dir);
+        toml_delete(doc, true);
+    }
+
+    GIVEN("バッファより大きな文書とする") {
+        std::string input;
+        for (int i = 0; i < 20000; ++i) {
+            input += "key" + std::to_string(i) + " = \"value\\t" + std::to_string(i) + "\"\n";
+        }
+        input += "long = \"" + std::string(100 * 1024, 'x') + "\"\n";
+        input += "escaped = \"";
+        for (int i = 0; i < 30000; ++i) {
+            input += "\\\"\\n";
+        }
+        input += "\"\n";
+        toml_t doc = load_without_source(input);
+        REQUIRE(doc != NULL);
+        char dir[] = "/tmp/ctomat_test_XXXXXX";
+        REQUIRE(mkdtemp(dir) != NULL);
+        std::string pathname = std::string(dir) + "/large.toml";
+
+        WHEN("ファイルに書き出す") {
+            REQUIRE(toml_save(doc, pathname.c_str()) == 0);
+
+            THEN("メモリに書き出したものと同じであること") {
+                ssize_t length = toml_save_to_memory(doc, NULL, 0);
+                std::vector<char> buf(length + 1);
+                REQUIRE(toml_save_to_memory(doc, buf.data(), buf.size()) == length);
+                REQUIRE(read_file(pathname) == std::string(buf.data(), length));
+            }
+        }
+
+        unlink(pathname.c_str());
+        rmdir(dir);
+        toml_delete(doc, true);
+    }
+
+    GIVEN("NULL とする") {
+        WHEN("ファイルに書き出す") {
+            THEN("EINVAL で失敗すること") {
+                REQUIRE(toml_save(NULL, "/tmp/ctomat_test_null.toml") == -1);
+                REQUIRE(errno == EINVAL);
+            }
+        }
+    }
+
+    GIVEN("数値を含む入力とする") {
+        std::string input = "pi = 3.14159\n"
+                            "third = 0.3333333333333333\n"
+                            "avogadro = 6.02214076e23\n"
+                            "tiny = 1e-7\n"
+                            "zero = -0.0\n"
+                            "big = 9_223_372_036_854_775_807\n"
+                            "list = [1.5, -2, nan, -inf]\n";
+        toml_t doc = load_without_source(input);
+
+        WHEN("書き出す") {
+            char buf[512];
+            ssize_t length = toml_save_to_memory(doc, buf, sizeof(buf));
+
+            THEN("最短の表記で書き出されること") {
+                REQUIRE(std::string(buf) == "pi = 3.14159\n"
+                                            "third = 0.3333333333333333\n"
+                                            "avogadro = 6.02214076e23\n"
+                                            "tiny = 1e-7\n"
+                                            "zero = -0.0\n"
+                                            "big = 9223372036854775807\n"
+                                            "list = [1.5, -2, nan, -inf]\n");
+            }
+            THEN("読み込み直すと同じ値が得られること") {
+                toml_t copy = toml_load_from_memory(buf, length);
+                REQUIRE(copy != NULL);
+                double value = 0;
+                REQUIRE(toml_float_value(toml_object_get(copy, "third"), &value) == 0);
+                REQUIRE(value == 0.3333333333333333);
+                REQUIRE(toml_float_value(toml_object_get(copy, "avogadro"), &value) == 0);
+                REQUIRE(value == 6.02214076e23);
+                toml_delete(copy, true);
+            }
+        }
+
+        toml_delete(doc, true);
+    }
+
+    GIVEN("多数の key を含む入力とする") {
+        std::string input;
+        int count = 50000;
+        for (int i = 0; i < count; ++i) {
+            input += "key" + std::to_string(i) + " = " + std::to_string(i) + "\n";
+        }
+        toml_t doc = load_without_source(input);
+        REQUIRE(doc != NULL);
+
+        WHEN("大きさを求めてから書き出す") {
+            ssize_t length = toml_save_to_memory(doc, NULL, 0);
+            REQUIRE(length == (ssize_t)input.size());
+            std::vector<char> buf(length + 1);
+
+            THEN("入力と同じ文書が得られること") {
+                REQUIRE(toml_save_to_memory(doc, buf.data(), buf.size()) == length);
+                REQUIRE(std::string(buf.data(), length) == input);
+            }
+        }
+
+        toml_delete(doc, true);
+    }
+}
+
+SCENARIO("変更した値だけを書き直して保存できること", "[ctomat][save]") {
+
+    GIVEN("コメントと書式を含む入力とする") {
+        std::string input = "# config\n"
+                            "title = \"old\"   # keep\n"
+                            "\n"
+                            "[owner]\n"
+                            "name = 'Tom'  # owner name\n"
+                            "tags = [ 'a',  'b' ]  # tags\n"
+                            "point = { x = 'p', y = 2 }\n"
+                            "\"quoted\" = 'q'\n"
+                            "ml = '''\n"
+                            "line\n"
+                            "'''\n";
+        toml_t doc = toml_load_from_memory(input.c_str(), input.size());
+        REQUIRE(doc != NULL);
+        toml_t owner = toml_object_get(doc, "owner");
+        REQUIRE(owner != NULL);
+
+        WHEN("変更せずに書き出す") {
+            char buf[512];
+            ssize_t length = toml_save_to_memory(doc, buf, sizeof(buf));
+
+            THEN("入力のまま得られること") {
+                REQUIRE(length == (ssize_t)input.size());
+                REQUIRE(std::string(buf) == input);
+            }
+        }
+
+        WHEN("1 つの値を変更して書き出す") {
+            REQUIRE(toml_string_set(toml_object_get(doc, "title"), "first") == 0);
+            REQUIRE(toml_string_set(toml_object_get(doc, "title"), "new \"value\"") == 0);
+            char buf[512];
+            REQUIRE(toml_save_to_memory(doc, buf, sizeof(buf)) > 0);
+
+            THEN("その値だけが書き直されること") {
+                std::string expected = input;
+                expected.replace(expected.find("\"old\""), 5, "\"new \\\"value\\\"\"");
+                REQUIRE(std::string(buf) == expected);
+            }
+        }
+
+        WHEN("配列の要素を変更して書き出す") {
+            REQUIRE(toml_string_set(toml_array_get(toml_object_get(owner, "tags"), 1), "c") == 0);
+            char buf[512];
+            REQUIRE(toml_save_to_memory(doc, buf, sizeof(buf)) > 0);
+
+            THEN("配列が書き直され、コメントが残ること") {
+                std::string expected = input;
+                expected.replace(expected.find("[ 'a',  'b' ]"), 13, "['a', 'c']");
+                REQUIRE(std::string(buf) == expected);
+            }
+        }
+
+        WHEN("インラインテーブルと引用符付きの key と複数行の値を変更して書き出す") {
+            REQUIRE(toml_string_set(toml_object_get(toml_object_get(owner, "point"), "x"), "p2") == 0);
+            REQUIRE(toml_string_set(toml_object_get(owner, "quoted"), "r") == 0);
+            REQUIRE(toml_string_set(toml_object_get(owner, "ml"), "two\nlines") == 0);
+            char buf[512];
+            REQUIRE(toml_save_to_memory(doc, buf, sizeof(buf)) > 0);
+
+            THEN("それぞれの値だけが書き直されること") {
+                REQUIRE(std::string(buf) == "# config\n"
+                                            "title = \"old\"   # keep\n"
+                                            "\n"
+                                            "[owner]\n"
+                                            "name = 'Tom'  # owner name\n"
+                                            "tags = [ 'a',  'b' ]  # tags\n"
+                                            "point = { x = 'p2', y = 2 }\n"
+                                            "\"quoted\" = 'r'\n"
+                                            "ml = \"two\\nlines\"\n");
+            }
+            THEN("書き出した文書から変更後の値が読み込めること") {
+                toml_t copy = toml_load_from_memory(buf, strlen(buf));
+                REQUIRE(copy != NULL);
+                REQUIRE(std::string(toml_string_value(toml_object_get(toml_object_get(copy, "owner"), "ml"))) == "two\nlines");
+                toml_delete(copy, true);
+            }
+        }
+
+        WHEN("値を変更してテーブルだけを書き出す") {
+            REQUIRE(toml_string_set(toml_object_get(owner, "name"), "Ann") == 0);
+            char buf[512];
+            REQUIRE(toml_save_to_memory(owner, buf, sizeof(buf)) > 0);
+
+            THEN("テーブルが書き直されること") {
+                REQUIRE(std::string(buf) == "name = 'Ann'\n"
+                                            "tags = ['a', 'b']\n"
+                                            "point = { x = 'p', y = 2 }\n"
+                                            "quoted = 'q'\n"
+                                            "ml = \"line\\n\"\n");
+            }
+        }
+
+        WHEN("値を変更してファイルに書き出す") {
+            REQUIRE(toml_string_set(toml_object_get(owner, "name"), "Ann") == 0);
+            char dir[] = "/tmp/ctomat_test_XXXXXX";
+            REQUIRE(mkdtemp(dir) != NULL);
+            std::string pathname = std::string(dir) + "/config.toml";
+            REQUIRE(toml_save(doc, pathname.c_str()) == 0);
+
+            THEN("その値だけが書き直されること") {
+                std::string expected = input;
+                expected.replace(expected.find("'Tom'"), 5, "'Ann'");
+                REQUIRE(read_file(pathname) == expected);
+            }
+
+            unlink(pathname.c_str());
+            rmdir(dir);
+        }
+
+        toml_delete(doc, true);
+    }
+
+    GIVEN("遅延読み込みした文書とする") {
+        std::string input = "a = 'x' # first\nb = \"y\" # second\n";
+        toml_t doc = toml_load_from_memory_ex(input.c_str(), input.size(), TOML_LOAD_LAZY);
+        REQUIRE(doc != NULL);
+
+        WHEN("値を変更して書き出す") {
+            REQUIRE(toml_string_set(toml_object_get(doc, "b"), "z") == 0);
+            char buf[512];
+            REQUIRE(toml_save_to_memory(doc, buf, sizeof(buf)) > 0);
+
+            THEN("その値だけが書き直されること") {
+                REQUIRE(std::string(buf) == "a = 'x' # first\nb = \"z\" # second\n");
+            }
+        }
+
+        toml_delete(doc, true);
+    }
+}
+
+SCENARIO("コンパイル済みの文書が読み込めること", "[ctomat][compile]") {
+
+    GIVEN("全ての型の値を含む文書とする") {
+        std::string input = "title = 'example'\n"
+                            "escaped = \"tab\\there\"\n"
+                            "integer = -42\n"
+                            "float = 3.5\n"
+                            "boolean = true\n"
+                            "date = 1979-05-27T07:32:00Z\n"
+                            "integers = [1, 2, 3]\n"
+                            "strings = ['a', 'b']\n"
+                            "mixed = [[1, 2], ['x']]\n"
+                            "\n"
+                            "[owner]\n"
+                            "name = \"Tom\"\n"
+                            "point = { x = 1, y = 2 }\n"
+                            "\n"
+                            "[[products]]\n"
+                            "name = 'Hammer'\n"
+                            "\n"
+                            "[[products]]\n"
+                            "name = 'Nail'\n";
+        for (int i = 0; i < 100; ++i) {
+            input += "key" + std::to_string(i) + " = " + std::to_string(i) + "\n";
+        }
+        toml_t doc = load_without_source(input);
+        REQUIRE(doc != NULL);
+        char dir[] = "/tmp/ctomat_test_XXXXXX";
+        REQUIRE(mkdtemp(dir) != NULL);
+        std::string pathname = std::string(dir) + "/config.ctomatc";
+
+        WHEN("コンパイルして読み込む") {
+            REQUIRE(toml_compile(doc, pathname.c_str()) == 0);
+            toml_t compiled = toml_load_compiled(pathname.c_str());
+            REQUIRE(compiled != NULL);
+
+            THEN("同じ値が得られること") {
+                REQUIRE(std::string(toml_string_value(toml_object_get(compiled, "title"))) == "example");
+                REQUIRE(std::string(toml_string_value(toml_object_get(compiled, "escaped"))) == "tab\there");
+                int64_t integer;
+                REQUIRE(toml_integer_value(toml_object_get(compiled, "integer"), &integer) == 0);
+                REQUIRE(integer == -42);
+                double number;
+                REQUIRE(toml_float_value(toml_object_get(compiled, "float"), &number) == 0);
+                REQUIRE(number == 3.5);
+                bool boolean;
+                REQUIRE(toml_boolean_value(toml_object_get(compiled, "boolean"), &boolean) == 0);
+                REQUIRE(boolean);
+                toml_datetime_t date;
+                REQUIRE(toml_datetime_value(toml_object_get(compiled, "date"), &date) == 0);
+                REQUIRE(date.seconds == 296638320);
+
+                size_t length;
+                const int64_t *integers = toml_array_int64(toml_object_get(compiled, "integers"), &length);
+                REQUIRE(integers != NULL);
+                REQUIRE(length == 3);
+                REQUIRE(integers[2] == 3);
+                const toml_view_t *strings = toml_array_string(toml_object_get(compiled, "strings"), &length);
+                REQUIRE(strings != NULL);
+                REQUIRE(length == 2);
+                REQUIRE(std::string(strings[1].ptr, strings[1].length) == "b");
+                toml_t mixed = toml_object_get(compiled, "mixed");
+                REQUIRE(toml_array_length(mixed) == 2);
+                REQUIRE(std::string(toml_string_value(toml_array_get(toml_array_get(mixed, 1), 0))) == "x");
+
+                REQUIRE(std::string(toml_string_value(toml_object_get(toml_object_get(compiled, "owner"), "name"))) == "Tom");
+                toml_t point = toml_object_get(toml_object_get(compiled, "owner"), "point");
+                REQUIRE(toml_integer_value(toml_object_get(point, "y"), &integer) == 0);
+                REQUIRE(integer == 2);
+                toml_t products = toml_object_get(compiled, "products");
+                REQUIRE(toml_array_length(products) == 2);
+                REQUIRE(std::string(toml_string_value(toml_object_get(toml_array_get(products, 1), "name"))) == "Nail");
+                toml_t last = toml_array_get(products, 1);
+                for (int i = 0; i < 100; ++i) {
+                    std::string key = "key" + std::to_string(i);
+                    REQUIRE(toml_integer_value(toml_object_get(last, key.c_str()), &integer) == 0);
+                    REQUIRE(integer == i);
+                }
+                REQUIRE(toml_object_get(last, "missing") == NULL);
+            }
+
+            THEN("同じ TOML が書き出せること") {
+                ssize_t length = toml_save_to_memory(doc, NULL, 0);
+                std::vector<char> expected(length + 1);
+                std::vector<char> actual(length + 1);
+                REQUIRE(toml_save_to_memory(doc, expected.data(), expected.size()) == length);
+                REQUIRE(toml_save_to_memory(compiled, actual.data(), actual.size()) == length);
+                REQUIRE(std::string(actual.data()) == std::string(expected.data()));
+            }
+
+            THEN("後ろの値から参照しても同じ TOML が書き出せること") {
+                toml_t products = toml_object_get(compiled, "products");
+                REQUIRE(toml_object_get(toml_array_get(products, 1), "key99") != NULL);
+                REQUIRE(toml_object_get(toml_object_get(compiled, "owner"), "point") != NULL);
+                REQUIRE(toml_array_get(toml_object_get(compiled, "mixed"), 1) != NULL);
+                REQUIRE(toml_object_get(compiled, "date") != NULL);
+
+                ssize_t length = toml_save_to_memory(doc, NULL, 0);
+                std::vector<char> expected(length + 1);
+                std::vector<char> actual(length + 1);
+                REQUIRE(toml_save_to_memory(doc, expected.data(), expected.size()) == length);
+                REQUIRE(toml_save_to_memory(compiled, actual.data(), actual.size()) == length);
+                REQUIRE(std::string(actual.data()) == std::string(expected.data()));
+
+                std::string again = std::string(dir) + "/again.ctomatc";
+                REQUIRE(toml_compile(compiled, again.c_str()) == 0);
+                toml_t recompiled = toml_load_compiled(again.c_str());
+                REQUIRE(recompiled != NULL);
+                std::vector<char> reloaded(length + 1);
+                REQUIRE(toml_save_to_memory(recompiled, reloaded.data(), reloaded.size()) == length);
+                REQUIRE(std::string(reloaded.data()) == std::string(expected.data()));
+                toml_delete(recompiled, true);
+                unlink(again.c_str());
+            }
+
+            THEN("値が変更できること") {
+                toml_t name = toml_object_get(toml_object_get(compiled, "owner"), "name");
+                REQUIRE(toml_string_set(name, "Ann") == 0);
+                REQUIRE(std::string(toml_string_value(name)) == "Ann");
+            }
+
+            toml_delete(compiled, true);
+        }
+
+        WHEN("途中で切れたファイルを読み込む") {
+            REQUIRE(toml_compile(doc, pathname.c_str()) == 0);
+            struct stat st;
+            REQUIRE(stat(pathname.c_str(), &st) == 0);
+            REQUIRE(truncate(pathname.c_str(), st.st_size - 1) == 0);
+
+            THEN("EINVAL で失敗すること") {
+                REQUIRE(toml_load_compiled(pathname.c_str()) == NULL);
+                REQUIRE(errno == EINVAL);
+            }
+        }
+
+        WHEN("TOML のファイルを読み込む") {
+            REQUIRE(toml_save(doc, pathname.c_str()) == 0);
+
+            THEN("EINVAL で失敗すること") {
+                REQUIRE(toml_load_compiled(pathname.c_str()) == NULL);
+                REQUIRE(errno == EINVAL);
+            }
+        }
+
+        WHEN("存在しないファイルを読み込む") {
+            THEN("ENOENT で失敗すること") {
+                REQUIRE(toml_load_compiled(pathname.c_str()) == NULL);
+                REQUIRE(errno == ENOENT);
+            }
+        }
+
+        unlink(pathname.c_str());
+        rmdir(dir);
+        toml_delete(doc, true);
+    }
+
+    GIVEN("NULL とする") {
+        WHEN("コンパイルする") {
+            THEN("EINVAL で失敗すること") {
+                REQUIRE(toml_compile(NULL, "/tmp/ctomat_test_null.ctomatc") == -1);
+                REQUIRE(errno == EINVAL);
+            }
+        }
+    }
+}
+
+/**
+ *  inode of @c pathname, or 0 if it does not exist.
+ */
+static ino_t inode_of(const std::string &pathname)
+{
+    struct stat st;
+
+    return (stat(pathname.c_str(), &st) == 0) ? st.st_ino : 0;
+}
+
+SCENARIO("コンパイル済みのキャッシュで読み込めること", "[ctomat][cache]") {
+
+    GIVEN("TOML のファイルを用意する") {
+        std::string input = "title = 'example' # comment\n"
+                            "\n"
+                            "[owner]\n"
+                            "name = \"Tom\"\n";
+        char dir[] = "/tmp/ctomat_test_XXXXXX";
+        REQUIRE(mkdtemp(dir) != NULL);
+        std::string pathname = std::string(dir) + "/config.toml";
+        std::string cache = pathname + ".ctomatc";
+        int fd = open(pathname.c_str(), O_WRONLY | O_CREAT, 0644);
+        REQUIRE(fd != -1);
+        REQUIRE(write(fd, input.data(), input.size()) == (ssize_t)input.size());
+        close(fd);
+
+        WHEN("キャッシュを使って読み込む") {
+            toml_t doc = toml_load_ex(pathname.c_str(), TOML_LOAD_CACHE);
+            REQUIRE(doc != NULL);
+
+            THEN("キャッシュが作られ、書かれたまま保存できること") {
+                REQUIRE(inode_of(cache) != 0);
+                char buf[256];
+                REQUIRE(toml_save_to_memory(doc, buf, sizeof(buf)) == (ssize_t)input.size());
+                REQUIRE(std::string(buf) == input);
+            }
+
+            toml_delete(doc, true);
+        }
+
+        WHEN("キャッシュを使って二度読み込む") {
+            toml_t first = toml_load_ex(pathname.c_str(), TOML_LOAD_CACHE);
+            REQUIRE(first != NULL);
+            ino_t inode = inode_of(cache);
+            toml_t second = toml_load_ex(pathname.c_str(), TOML_LOAD_CACHE);
+            REQUIRE(second != NULL);
+
+            THEN("キャッシュから同じ値が得られること") {
+                REQUIRE(inode_of(cache) == inode);
+                REQUIRE(std::string(toml_string_value(toml_object_get(second, "title"))) == "example");
+                toml_t owner = toml_object_get(second, "owner");
+                REQUIRE(std::string(toml_string_value(toml_object_get(owner, "name"))) == "Tom");
+            }
+
+            toml_delete(first, true);
+            toml_delete(second, true);
+        }
+
+        WHEN("大きさと更新時刻を変えずに内容を書き換えて読み込む") {
+            toml_t first = toml_load_ex(pathname.c_str(), TOML_LOAD_CACHE);
+            REQUIRE(first != NULL);
+            toml_delete(first, true);
+            struct stat st;
+            REQUIRE(stat(pathname.c_str(), &st) == 0);
+            std::string changed = input;
+            changed.replace(changed.find("Tom"), 3, "Ann");
+            fd = open(pathname.c_str(), O_WRONLY);
+            REQUIRE(fd != -1);
+            REQUIRE(write(fd, changed.data(), changed.size()) == (ssize_t)changed.size());
+            struct timespec times[2] = {st.st_atim, st.st_mtim};
+            REQUIRE(futimens(fd, times) == 0);
+            close(fd);
+            toml_t second = toml_load_ex(pathname.c_str(), TOML_LOAD_CACHE);
+            REQUIRE(second != NULL);
+
+            THEN("読み直した値が得られること") {
+                toml_t owner = toml_object_get(second, "owner");
+                REQUIRE(std::string(toml_string_value(toml_object_get(owner, "name"))) == "Ann");
+            }
+
+            toml_delete(second, true);
+        }
+
+        WHEN("壊れたキャッシュがある状態で読み込む") {
+            fd = open(cache.c_str(), O_WRONLY | O_CREAT, 0644);
+            REQUIRE(fd != -1);
+            REQUIRE(write(fd, "broken", 6) == 6);
+            close(fd);
+            toml_t doc = toml_load_ex(pathname.c_str(), TOML_LOAD_CACHE);
+            REQUIRE(doc != NULL);
+
+            THEN("読み直してキャッシュが作り直されること") {
+                REQUIRE(std::string(toml_string_value(toml_object_get(doc, "title"))) == "example");
+                toml_t cached = toml_load_compiled(cache.c_str());
+                REQUIRE(cached != NULL);
+                toml_delete(cached, true);
+            }
+
+            toml_delete(doc, true);
+        }
+
+        WHEN("環境変数 CTOMAT_CACHE を設定して toml_load() で読み込む") {
+            REQUIRE(setenv("CTOMAT_CACHE", "1", 1) == 0);
+            toml_t doc = toml_load(pathname.c_str());
+            unsetenv("CTOMAT_CACHE");
+            REQUIRE(doc != NULL);
+
+            THEN("キャッシュが作られること") {
+                REQUIRE(inode_of(cache) != 0);
+            }
+
+            toml_delete(doc, true);
+        }
+
+        WHEN("キャッシュを使わずに読み込む") {
+            toml_t doc = toml_load(pathname.c_str());
+            REQUIRE(doc != NULL);
+
+            THEN("キャッシュが作られないこと") {
+                REQUIRE(inode_of(cache) == 0);
+            }
+
+            toml_delete(doc, true);
+        }
+
+        unlink(cache.c_str());
+        unlink(pathname.c_str());
+        rmdir(dir);
+    }
+}
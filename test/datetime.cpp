@@ -0,0 +1,153 @@
+/** @file   datetime.cpp
+ *  @brief  Test for date-time decoder.
+ *
+ *  @author t-kenji <protect.2501@gmail.com>
+ *  @date   2018-12-07 create new.
+ */
+#include <string>
+#include <vector>
+#include <utility>
+#include <cerrno>
+#include <cstdint>
+
+#include "catch2/catch.hpp"
+
+extern "C" {
+#include "debug.h"
+#include "datetime.h"
+}
+
+struct expected_datetime {
+    std::string input;
+    int64_t seconds;
+    uint32_t nanoseconds;
+    int16_t offset;
+    enum toml_datetime_kind kind;
+};
+
+SCENARIO("日時が解釈できること", "[datetime]") {
+
+    GIVEN("正しい日時の表記とする") {
+        std::vector<struct expected_datetime> inputs = {
+            {"1979-05-27T07:32:00Z", 296638320, 0, 0, TOML_OFFSET_DATETIME},
+            {"1979-05-27t07:32:00z", 296638320, 0, 0, TOML_OFFSET_DATETIME},
+            {"1979-05-27 07:32:00Z", 296638320, 0, 0, TOML_OFFSET_DATETIME},
+            {"1979-05-27T00:32:00-07:00", 296638320, 0, -420, TOML_OFFSET_DATETIME},
+            {"1979-05-27T16:02:00+08:30", 296638320, 0, 510, TOML_OFFSET_DATETIME},
+            {"1979-05-27T00:32:00.999999-07:00", 296638320, 999999000, -420, TOML_OFFSET_DATETIME},
+            {"1970-01-01T00:00:00Z", 0, 0, 0, TOML_OFFSET_DATETIME},
+            {"1969-12-31T23:59:59Z", -1, 0, 0, TOML_OFFSET_DATETIME},
+            {"1979-05-27T07:32:00", 296638320, 0, 0, TOML_LOCAL_DATETIME},
+            {"1979-05-27T00:32:00.5", 296613120, 500000000, 0, TOML_LOCAL_DATETIME},
+            {"1979-05-27", 296611200, 0, 0, TOML_LOCAL_DATE},
+            {"2000-02-29", 951782400, 0, 0, TOML_LOCAL_DATE},
+            {"0001-01-01", -62135596800, 0, 0, TOML_LOCAL_DATE},
+            {"9999-12-31", 253402214400, 0, 0, TOML_LOCAL_DATE},
+            {"07:32:00", 27120, 0, 0, TOML_LOCAL_TIME},
+            {"00:32:00.999999", 1920, 999999000, 0, TOML_LOCAL_TIME},
+            {"00:00:00.1234567891", 0, 123456789, 0, TOML_LOCAL_TIME},
+        };
+
+        WHEN("解釈する") {
+            THEN("値が得られること") {
+                for (auto &input : inputs) {
+                    INFO("入力: '" + input.input + "'");
+                    toml_datetime_t value;
+                    REQUIRE(datetime_parse(input.input.data(), input.input.size(), &value) == 0);
+                    REQUIRE(value.seconds == input.seconds);
+                    REQUIRE(value.nanoseconds == input.nanoseconds);
+                    REQUIRE(value.offset == input.offset);
+                    REQUIRE(value.kind == input.kind);
+                }
+            }
+        }
+    }
+
+    GIVEN("うるう秒の表記とする") {
+        std::string input = "2016-12-31T23:59:60Z";
+
+        WHEN("解釈する") {
+            toml_datetime_t value;
+            REQUIRE(datetime_parse(input.data(), input.size(), &value) == 0);
+
+            THEN("直前の秒として数えられ、うるう秒であることが分かること") {
+                REQUIRE(value.seconds == 1483228799);
+                REQUIRE(value.leap == 1);
+            }
+        }
+    }
+
+    GIVEN("不正な日時の表記とする") {
+        std::vector<std::string> inputs = {
+            "",
+            "1979",
+            "1979-5-27",
+            "+1979-05-27",
+            "1979-13-01",
+            "1979-00-10",
+            "1979-05-00",
+            "1979-04-31",
+            "1979-02-29",
+            "1900-02-29",
+            "1979-05-27X07:32:00",
+            "1979-05-27T",
+            "1979-05-27T07:32",
+            "1979-05-27T24:00:00",
+            "1979-05-27T07:60:00",
+            "1979-05-27T07:32:61",
+            "1979-05-27T07:32:00.",
+            "1979-05-27T07:32:00+07",
+            "1979-05-27T07:32:00+24:00",
+            "1979-05-27T07:32:00+07:60",
+            "1979-05-27T07:32:00Zx",
+            "1979-05-27T07:32:00Z ",
+            "07:32",
+            "7:32:00",
+            "07:32:00Z",
+        };
+
+        WHEN("解釈する") {
+            THEN("EINVAL で失敗すること") {
+                for (auto &input : inputs) {
+                    INFO("入力: '" + input + "'");
+                    toml_datetime_t value;
+                    REQUIRE(datetime_parse(input.data(), input.size(), &value) == -1);
+                    REQUIRE(errno == EINVAL);
+                }
+            }
+        }
+    }
+}
+
+SCENARIO("日時が TOML の表記に戻せること", "[datetime]") {
+
+    GIVEN("日時の表記とする") {
+        std::vector<std::pair<std::string, std::string>> inputs = {
+            {"1979-05-27T07:32:00Z", "1979-05-27T07:32:00Z"},
+            {"1979-05-27 07:32:00z", "1979-05-27T07:32:00Z"},
+            {"1979-05-27T00:32:00.999999-07:00", "1979-05-27T00:32:00.999999-07:00"},
+            {"1969-12-31T23:59:59+09:00", "1969-12-31T23:59:59+09:00"},
+            {"1979-05-27T07:32:00", "1979-05-27T07:32:00"},
+            {"0001-01-01", "0001-01-01"},
+            {"2000-02-29", "2000-02-29"},
+            {"00:32:00.500", "00:32:00.5"},
+            {"23:59:59.123456789", "23:59:59.123456789"},
+            {"23:59:60", "23:59:60"},
+            {"2016-12-31T23:59:60Z", "2016-12-31T23:59:60Z"},
+            {"2017-01-01T08:59:60.5+09:00", "2017-01-01T08:59:60.5+09:00"},
+        };
+
+        WHEN("解釈して書き出す") {
+            THEN("同じ日時を表す表記が得られること") {
+                for (auto &input : inputs) {
+                    INFO("入力: '" + input.first + "'");
+                    toml_datetime_t value;
+                    char text[DATETIME_TEXT_BYTES];
+                    REQUIRE(datetime_parse(input.first.data(), input.first.size(), &value) == 0);
+                    REQUIRE(datetime_format(&value, text) == input.second.size());
+                    REQUIRE(std::string(text) == input.second);
+                }
+            }
+        }
+    }
+}
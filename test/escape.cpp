@@ -0,0 +1,159 @@
+/** @file   escape.cpp
+ *  @brief  Test for escape sequences of basic strings.
+ *
+ *  @author t-kenji <protect.2501@gmail.com>
+ *  @date   2018-12-08 create new.
+ */
+#include <string>
+#include <vector>
+#include <utility>
+#include <cerrno>
+#include <cstdint>
+
+#include "catch2/catch.hpp"
+
+extern "C" {
+#include "debug.h"
+#include "escape.h"
+}
+
+static std::string decode(const std::string &input)
+{
+    std::vector<char> buf(input.size() + 1);
+    size_t length;
+
+    REQUIRE(escape_decode(input.data(), input.size(), buf.data(), &length) == 0);
+    REQUIRE(length <= input.size());
+
+    return std::string(buf.data(), length);
+}
+
+static std::string encode(const std::string &input)
+{
+    size_t length = escape_encode(input.data(), input.size(), NULL, 0);
+    std::vector<char> buf(length);
+
+    REQUIRE(escape_encode(input.data(), input.size(), buf.data(), buf.size()) == length);
+
+    return std::string(buf.data(), length);
+}
+
+SCENARIO("エスケープシーケンスが復号できること", "[escape]") {
+
+    GIVEN("正しいエスケープシーケンスを含む文字列とする") {
+        std::vector<std::pair<std::string, std::string>> inputs = {
+            {"", ""},
+            {"no escapes", "no escapes"},
+            {"TOML \\\"Example\\\"", "TOML \"Example\""},
+            {"\\b\\t\\n\\f\\r\\\"\\\\", "\b\t\n\f\r\"\\"},
+            {"\\u0041\\u00e9\\u20AC", "A\xC3\xA9\xE2\x82\xAC"},
+            {"\\U0001D11E", "\xF0\x9D\x84\x9E"},
+            {"\\U0010FFFF", "\xF4\x8F\xBF\xBF"},
+            {"\\u0000", std::string(1, '\0')},
+            {"a\\\\b\\\\", "a\\b\\"},
+            {"a\\\n  b", "ab"},
+            {"a\\  \t\r\n\n  \t b", "ab"},
+            {"a \\\n", "a "},
+            {std::string(100, 'x') + "\\n" + std::string(100, 'y'),
+             std::string(100, 'x') + "\n" + std::string(100, 'y')},
+        };
+
+        WHEN("復号する") {
+            THEN("エスケープが解かれた文字列が得られること") {
+                for (auto &input : inputs) {
+                    INFO("入力: '" + input.first + "'");
+                    REQUIRE(decode(input.first) == input.second);
+                }
+            }
+        }
+    }
+
+    GIVEN("不正なエスケープシーケンスを含む文字列とする") {
+        std::vector<std::string> inputs = {
+            "\\",
+            "\\a",
+            "\\x41",
+            "\\ ",
+            "\\u004",
+            "\\u00G1",
+            "\\uD800",
+            "\\uDFFF",
+            "\\U00110000",
+            "\\UFFFFFFFF",
+            "ok\\q",
+            "a\\ b",
+            "a\\\rb",
+        };
+
+        WHEN("復号する") {
+            THEN("EINVAL で失敗すること") {
+                for (auto &input : inputs) {
+                    INFO("入力: '" + input + "'");
+                    std::vector<char> buf(input.size() + 1);
+                    size_t length;
+                    REQUIRE(escape_decode(input.data(), input.size(), buf.data(), &length) == -1);
+                    REQUIRE(errno == EINVAL);
+                }
+            }
+        }
+    }
+
+    GIVEN("途中で途切れたエスケープシーケンスとする") {
+        std::string input = "\\U0001D11E";
+
+        WHEN("長さを変えて読み取る") {
+            THEN("途切れていれば 0、揃えば長さが得られること") {
+                uint32_t codepoint;
+                for (size_t length = 0; length < input.size(); ++length) {
+                    INFO("長さ: " + std::to_string(length));
+                    REQUIRE(escape_scan(input.data(), input.data() + length, &codepoint) == 0);
+                }
+                REQUIRE(escape_scan(input.data(), input.data() + input.size(), &codepoint) == 10);
+                REQUIRE(codepoint == 0x1D11E);
+            }
+        }
+    }
+}
+
+SCENARIO("文字列がエスケープできること", "[escape]") {
+
+    GIVEN("エスケープが必要な文字を含む文字列とする") {
+        std::vector<std::pair<std::string, std::string>> inputs = {
+            {"", ""},
+            {"plain", "plain"},
+            {"TOML \"Example\"", "TOML \\\"Example\\\""},
+            {"\b\t\n\f\r\\", "\\b\\t\\n\\f\\r\\\\"},
+            {std::string("\x01\x1F\x7F", 3), "\\u0001\\u001F\\u007F"},
+            {"\xC3\xA9", "\xC3\xA9"},
+        };
+
+        WHEN("エスケープする") {
+            THEN("basic string の内容として書ける文字列が得られること") {
+                for (auto &input : inputs) {
+                    INFO("入力: '" + input.first + "'");
+                    REQUIRE(encode(input.first) == input.second);
+                }
+            }
+            THEN("復号すると元の文字列に戻ること") {
+                for (auto &input : inputs) {
+                    INFO("入力: '" + input.first + "'");
+                    REQUIRE(decode(encode(input.first)) == input.first);
+                }
+            }
+        }
+    }
+
+    GIVEN("出力先が足りない場合とする") {
+        std::string input = "a\"b";
+
+        WHEN("エスケープする") {
+            char buf[2];
+            size_t length = escape_encode(input.data(), input.size(), buf, sizeof(buf));
+
+            THEN("必要な長さが返り、出力先の範囲だけ書かれること") {
+                REQUIRE(length == 4);
+                REQUIRE(std::string(buf, sizeof(buf)) == "a\\");
+            }
+        }
+    }
+}
@@ -0,0 +1,313 @@
+/** @file   lexer.cpp
+ *  @brief  Test for TOML tokenizer.
+ *
+ *  @author t-kenji <protect.2501@gmail.com>
+ *  @date   2018-12-01 create new.
+ */
+#include <string>
+#include <vector>
+
+#include "catch2/catch.hpp"
+
+extern "C" {
+#include "debug.h"
+#include "lexer.h"
+}
+
+/**
+ *  tokenize @c input until EOF or error.
+ *
+ *  @param  [in]    input   input string.
+ *  @return token types.
+ */
+static std::vector<enum token_type> tokenize(const std::string &input, std::vector<std::string> *texts = NULL)
+{
+    struct lexer lexer;
+    struct token token;
+    std::vector<enum token_type> types;
+
+    lexer_init(&lexer, input.data(), input.size());
+    do {
+        lexer_next(&lexer, &token);
+        types.push_back(token.type);
+        if (texts != NULL) {
+            texts->push_back(std::string(token.head, token.length));
+        }
+    } while ((token.type != TOKEN_EOF) && (token.type != TOKEN_ERROR));
+
+    return types;
+}
+
+SCENARIO("key/value が字句解析できること", "[lexer]") {
+
+    GIVEN("入力文字列を以下とする") {
+        std::string input = "key = \"value\" # comment\n";
+        INFO("入力文字列: '" + input + "'");
+
+        WHEN("字句解析する") {
+            std::vector<std::string> texts;
+            std::vector<enum token_type> types = tokenize(input, &texts);
+
+            THEN("key, '=', 文字列, コメント, 改行の順に得られること") {
+                std::vector<enum token_type> expected = {
+                    TOKEN_BARE_KEY, TOKEN_EQUAL, TOKEN_BASIC_STRING,
+                    TOKEN_COMMENT, TOKEN_NEWLINE, TOKEN_EOF,
+                };
+                REQUIRE(types == expected);
+            }
+            THEN("文字列は引用符を含まないこと") {
+                REQUIRE(texts[0] == "key");
+                REQUIRE(texts[2] == "value");
+                REQUIRE(texts[3] == "# comment");
+            }
+        }
+    }
+
+    GIVEN("入力文字列を以下とする") {
+        std::string input = "a . \"b.c\" . 'd' = 'x'\r\n";
+        INFO("入力文字列: '" + input + "'");
+
+        WHEN("字句解析する") {
+            std::vector<std::string> texts;
+            std::vector<enum token_type> types = tokenize(input, &texts);
+
+            THEN("dotted-key と CRLF が得られること") {
+                std::vector<enum token_type> expected = {
+                    TOKEN_BARE_KEY, TOKEN_DOT, TOKEN_BASIC_STRING, TOKEN_DOT, TOKEN_LITERAL_STRING,
+                    TOKEN_EQUAL, TOKEN_LITERAL_STRING, TOKEN_NEWLINE, TOKEN_EOF,
+                };
+                REQUIRE(types == expected);
+                REQUIRE(texts[2] == "b.c");
+            }
+        }
+    }
+
+    GIVEN("入力文字列を以下とする") {
+        std::string input = "key = 1979-05-27T07:32:00Z#comment";
+        INFO("入力文字列: '" + input + "'");
+
+        WHEN("字句解析する") {
+            std::vector<std::string> texts;
+            std::vector<enum token_type> types = tokenize(input, &texts);
+
+            THEN("値がコメントの直前までで区切られること") {
+                REQUIRE(types[2] == TOKEN_VALUE);
+                REQUIRE(texts[2] == "1979-05-27T07:32:00Z");
+                REQUIRE(types[3] == TOKEN_COMMENT);
+            }
+        }
+    }
+
+    GIVEN("テーブルヘッダーとする") {
+        std::string input = "[ a.\"b\" ]\n[[c]] # comment\n";
+        INFO("入力文字列: '" + input + "'");
+
+        WHEN("字句解析する") {
+            std::vector<std::string> texts;
+            std::vector<enum token_type> types = tokenize(input, &texts);
+
+            THEN("角括弧と二重の角括弧が区別されること") {
+                std::vector<enum token_type> expected = {
+                    TOKEN_TABLE_OPEN, TOKEN_BARE_KEY, TOKEN_DOT, TOKEN_BASIC_STRING, TOKEN_TABLE_CLOSE,
+                    TOKEN_NEWLINE,
+                    TOKEN_ARRAY_TABLE_OPEN, TOKEN_BARE_KEY, TOKEN_ARRAY_TABLE_CLOSE, TOKEN_COMMENT,
+                    TOKEN_NEWLINE, TOKEN_EOF,
+                };
+                REQUIRE(types == expected);
+                REQUIRE(texts[6] == "[[");
+                REQUIRE(texts[8] == "]]");
+            }
+        }
+    }
+
+    GIVEN("空白で区切られた日時とする") {
+        std::string input = "a = 1979-05-27 07:32:00Z\nb = 1979-05-27 # comment\n";
+        INFO("入力文字列: '" + input + "'");
+
+        WHEN("字句解析する") {
+            std::vector<std::string> texts;
+            std::vector<enum token_type> types = tokenize(input, &texts);
+
+            THEN("日付と時刻が 1 つの値になること") {
+                std::vector<enum token_type> expected = {
+                    TOKEN_BARE_KEY, TOKEN_EQUAL, TOKEN_VALUE, TOKEN_NEWLINE,
+                    TOKEN_BARE_KEY, TOKEN_EQUAL, TOKEN_VALUE, TOKEN_COMMENT, TOKEN_NEWLINE, TOKEN_EOF,
+                };
+                REQUIRE(types == expected);
+                REQUIRE(texts[2] == "1979-05-27 07:32:00Z");
+                REQUIRE(texts[6] == "1979-05-27");
+            }
+        }
+    }
+
+    GIVEN("配列の値とする") {
+        std::string input = "[1, 'x', # comment\n]";
+        INFO("入力文字列: '" + input + "'");
+
+        WHEN("パーサーと同様に値として字句解析する") {
+            struct lexer lexer;
+            struct token token;
+            std::vector<enum token_type> types;
+
+            lexer_init(&lexer, input.data(), input.size());
+            do {
+                lexer.mode = LEXER_VALUE;
+                lexer_next(&lexer, &token);
+                types.push_back(token.type);
+            } while ((token.type != TOKEN_EOF) && (token.type != TOKEN_ERROR));
+
+            THEN("括弧とカンマが値と区別されること") {
+                std::vector<enum token_type> expected = {
+                    TOKEN_ARRAY_OPEN, TOKEN_VALUE, TOKEN_COMMA, TOKEN_LITERAL_STRING, TOKEN_COMMA,
+                    TOKEN_COMMENT, TOKEN_NEWLINE, TOKEN_ARRAY_CLOSE, TOKEN_EOF,
+                };
+                REQUIRE(types == expected);
+            }
+        }
+    }
+
+    GIVEN("インラインテーブルの値とする") {
+        std::string input = "b = { c = 2, d = 'x' }\n";
+        INFO("入力文字列: '" + input + "'");
+
+        WHEN("字句解析する") {
+            std::vector<std::string> texts;
+            std::vector<enum token_type> types = tokenize(input, &texts);
+
+            THEN("波括弧とカンマが区別されること") {
+                std::vector<enum token_type> expected = {
+                    TOKEN_BARE_KEY, TOKEN_EQUAL, TOKEN_INLINE_TABLE_OPEN,
+                    TOKEN_BARE_KEY, TOKEN_EQUAL, TOKEN_VALUE, TOKEN_COMMA,
+                    TOKEN_BARE_KEY, TOKEN_EQUAL, TOKEN_LITERAL_STRING, TOKEN_INLINE_TABLE_CLOSE,
+                    TOKEN_NEWLINE, TOKEN_EOF,
+                };
+                REQUIRE(types == expected);
+                REQUIRE(texts[5] == "2");
+            }
+        }
+    }
+
+    GIVEN("エスケープを含む文字列とする") {
+        std::string input = "key = \"a\\\"b\"";
+        INFO("入力文字列: '" + input + "'");
+
+        WHEN("字句解析する") {
+            struct lexer lexer;
+            struct token token;
+            lexer_init(&lexer, input.data(), input.size());
+            lexer_next(&lexer, &token);
+            lexer_next(&lexer, &token);
+            lexer_next(&lexer, &token);
+
+            THEN("エスケープされた引用符で終端しないこと") {
+                REQUIRE(token.type == TOKEN_BASIC_STRING);
+                REQUIRE(token.escaped);
+                REQUIRE(std::string(token.head, token.length) == "a\\\"b");
+            }
+        }
+    }
+
+    GIVEN("複数行の文字列とする") {
+        std::string input = "sql = \"\"\"\nSELECT *\r\n  FROM t\"\"\"\"\"\n"
+                            "cert = '''-----BEGIN-----\nMIIB'''\n"
+                            "folded = \"\"\"a \\\n   b\"\"\"\n"
+                            "empty = ''''''\n";
+        INFO("入力文字列: '" + input + "'");
+
+        WHEN("字句解析する") {
+            std::vector<std::string> texts;
+            struct lexer lexer;
+            struct token token;
+            lexer_init(&lexer, input.data(), input.size());
+            do {
+                lexer_next(&lexer, &token);
+                texts.push_back(std::string(token.head, token.length));
+            } while ((token.type != TOKEN_EOF) && (token.type != TOKEN_ERROR));
+
+            THEN("開始直後の改行を除いた内容が文字列になること") {
+                REQUIRE(token.type == TOKEN_EOF);
+                REQUIRE(texts[2] == "SELECT *\r\n  FROM t\"\"");
+                REQUIRE(texts[6] == "-----BEGIN-----\nMIIB");
+                REQUIRE(texts[10] == "a \\\n   b");
+                REQUIRE(texts[14] == "");
+            }
+            THEN("文字列の中の改行も行として数えられること") {
+                REQUIRE(lexer.line == 9);
+            }
+        }
+    }
+
+    GIVEN("途中までの複数行の文字列とする") {
+        std::string input = "key = \"\"\"line\nline\"\"";
+
+        WHEN("続きがあるものとして字句解析する") {
+            struct lexer lexer;
+            struct token token;
+            lexer_init(&lexer, input.data(), input.size());
+            lexer.partial = true;
+            lexer_next(&lexer, &token);
+            lexer_next(&lexer, &token);
+            lexer_next(&lexer, &token);
+
+            THEN("入力の不足が報告されること") {
+                REQUIRE(token.type == TOKEN_INCOMPLETE);
+            }
+        }
+    }
+
+    GIVEN("走査ウィンドウをまたぐ長い文字列とコメントとする") {
+        std::string body(LEXER_WINDOW_BYTES * 2 + 5, 'x');
+        body[LEXER_WINDOW_BYTES - 1] = '#';
+        body[LEXER_WINDOW_BYTES + 1] = '\'';
+        std::string input = "key = \"" + body + "\" #" + body + "\n"
+                            "other = '" + std::string(LEXER_WINDOW_BYTES, 'y') + "'\n";
+
+        WHEN("字句解析する") {
+            std::vector<std::string> texts;
+            std::vector<enum token_type> types = tokenize(input, &texts);
+
+            THEN("ウィンドウ境界で区切られないこと") {
+                std::vector<enum token_type> expected = {
+                    TOKEN_BARE_KEY, TOKEN_EQUAL, TOKEN_BASIC_STRING, TOKEN_COMMENT, TOKEN_NEWLINE,
+                    TOKEN_BARE_KEY, TOKEN_EQUAL, TOKEN_LITERAL_STRING, TOKEN_NEWLINE, TOKEN_EOF,
+                };
+                REQUIRE(types == expected);
+                REQUIRE(texts[2] == body);
+                REQUIRE(texts[3] == "#" + body);
+                REQUIRE(texts[7] == std::string(LEXER_WINDOW_BYTES, 'y'));
+            }
+        }
+    }
+
+    GIVEN("不正な入力とする") {
+        std::vector<std::string> inputs = {
+            "key = \"unterminated\n",
+            "key = 'unterminated",
+            "key = \"a\tb\x01\"",
+            "key\r= 1",
+            "key = \"\\q\"",
+            "key = \"\\u12\"",
+            "key = \"\\uD800\"",
+            "key = \"\\U00110000\"",
+            "key = \"\xC3\"",
+            "key = '\xED\xA0\x80'",
+            "\"\xFF\" = 1",
+            "key = \"\"\"unterminated\n",
+            "key = '''a''''''\n",
+            "key = \"\"\"a\x01\"\"\"",
+            "key = \"\"\"a\rb\"\"\"",
+            "key = \"\"\"a\\ b\"\"\"",
+            "\"\"\"a\"\"\" = 1",
+            "'''a''' = 1",
+        };
+
+        WHEN("字句解析する") {
+            THEN("エラーになること") {
+                for (auto &input : inputs) {
+                    INFO("入力文字列: '" + input + "'");
+                    REQUIRE(tokenize(input).back() == TOKEN_ERROR);
+                }
+            }
+        }
+    }
+}
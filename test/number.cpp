@@ -0,0 +1,421 @@
+/** @file   number.cpp
+ *  @brief  Test for number decoder and encoder.
+ *
+ *  @author t-kenji <protect.2501@gmail.com>
+ *  @date   2018-12-05 create new.
+ */
+#include <string>
+#include <vector>
+#include <utility>
+#include <cerrno>
+#include <cstdint>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <random>
+
+#include "catch2/catch.hpp"
+
+extern "C" {
+#include "debug.h"
+#include "number.h"
+}
+
+SCENARIO("整数が解釈できること", "[number][integer]") {
+
+    GIVEN("正しい整数の表記とする") {
+        std::vector<std::pair<std::string, int64_t>> inputs = {
+            {"0", 0},
+            {"+0", 0},
+            {"-0", 0},
+            {"42", 42},
+            {"+99", 99},
+            {"-17", -17},
+            {"1_000", 1000},
+            {"5_349_221", 5349221},
+            {"1_2_3_4_5", 12345},
+            {"12345678", 12345678},
+            {"123456789012", 123456789012},
+            {"1234_5678_9012", 123456789012},
+            {"9223372036854775807", INT64_MAX},
+            {"-9223372036854775808", INT64_MIN},
+            {"0xDEADBEEF", 0xDEADBEEF},
+            {"0xdead_beef", 0xDEADBEEF},
+            {"0x7FFFFFFFFFFFFFFF", INT64_MAX},
+            {"0x0000000000000000001", 1},
+            {"0o01234567", 01234567},
+            {"0o755", 0755},
+            {"0b11010110", 0xD6},
+            {"0b1_0", 2},
+        };
+
+        WHEN("解釈する") {
+            THEN("値が得られること") {
+                for (auto &input : inputs) {
+                    INFO("入力: '" + input.first + "'");
+                    int64_t value = 0;
+                    REQUIRE(number_parse_integer(input.first.data(), input.first.size(), &value) == 0);
+                    REQUIRE(value == input.second);
+                }
+            }
+        }
+    }
+
+    GIVEN("8 桁単位の境界をまたぐ桁数の整数とする") {
+        WHEN("1 桁から 18 桁まで解釈する") {
+            THEN("値が得られること") {
+                std::string digits;
+                int64_t expected = 0;
+                for (int i = 1; i <= 18; ++i) {
+                    digits += (char)('0' + (i % 9) + 1);
+                    expected = (expected * 10) + (i % 9) + 1;
+                    INFO("入力: '" + digits + "'");
+                    int64_t value = 0;
+                    REQUIRE(number_parse_integer(digits.data(), digits.size(), &value) == 0);
+                    REQUIRE(value == expected);
+                }
+            }
+        }
+    }
+
+    GIVEN("範囲外の整数とする") {
+        std::vector<std::string> inputs = {
+            "9223372036854775808",
+            "-9223372036854775809",
+            "99999999999999999999",
+            "123456789012345678901234567890",
+            "0x8000000000000000",
+            "0xFFFFFFFFFFFFFFFFF",
+            "0o1000000000000000000000",
+            "0b1000000000000000000000000000000000000000000000000000000000000000",
+        };
+
+        WHEN("解釈する") {
+            THEN("ERANGE で失敗すること") {
+                for (auto &input : inputs) {
+                    INFO("入力: '" + input + "'");
+                    int64_t value = 0;
+                    REQUIRE(number_parse_integer(input.data(), input.size(), &value) == -1);
+                    REQUIRE(errno == ERANGE);
+                }
+            }
+        }
+    }
+
+    GIVEN("不正な整数の表記とする") {
+        std::vector<std::string> inputs = {
+            "",
+            "+",
+            "-",
+            "01",
+            "+01",
+            "00",
+            "_1",
+            "1_",
+            "1__2",
+            "1_x",
+            "12345678x",
+            "1.5",
+            "0x",
+            "0X1F",
+            "+0x1F",
+            "0xG",
+            "0x_1",
+            "0x1_",
+            "0o8",
+            "0b2",
+            "abc",
+            "1 2",
+        };
+
+        WHEN("解釈する") {
+            THEN("EINVAL で失敗すること") {
+                for (auto &input : inputs) {
+                    INFO("入力: '" + input + "'");
+                    int64_t value = 0;
+                    REQUIRE(number_parse_integer(input.data(), input.size(), &value) == -1);
+                    REQUIRE(errno == EINVAL);
+                }
+            }
+        }
+    }
+}
+
+SCENARIO("浮動小数点数が解釈できること", "[number][float]") {
+
+    GIVEN("正しい浮動小数点数の表記とする") {
+        std::vector<std::pair<std::string, double>> inputs = {
+            {"+1.0", 1.0},
+            {"3.1415", 3.1415},
+            {"-0.01", -0.01},
+            {"5e+22", 5e+22},
+            {"1e06", 1e06},
+            {"-2E-2", -2E-2},
+            {"6.626e-34", 6.626e-34},
+            {"224_617.445_991_228", 224617.445991228},
+            {"1e1_0", 1e10},
+            {"0.0", 0.0},
+            {"0e0", 0.0},
+            {"0.1234567890123456789012345", 0.1234567890123456789012345},
+            {"1.7976931348623157e308", 1.7976931348623157e308},
+            {"4.9406564584124654e-324", 4.9406564584124654e-324},
+            {"2.2250738585072011e-308", 2.2250738585072011e-308},
+            {"9007199254740993.0", 9007199254740992.0},
+            {"1e-400", 0.0},
+        };
+
+        WHEN("解釈する") {
+            THEN("値が得られること") {
+                for (auto &input : inputs) {
+                    INFO("入力: '" + input.first + "'");
+                    double value = -1;
+                    REQUIRE(number_parse_float(input.first.data(), input.first.size(), &value) == 0);
+                    REQUIRE(std::memcmp(&value, &input.second, sizeof(value)) == 0);
+                }
+            }
+        }
+    }
+
+    GIVEN("特殊な値の表記とする") {
+        WHEN("解釈する") {
+            THEN("無限大と非数が得られること") {
+                double value = 0;
+                REQUIRE(number_parse_float("inf", 3, &value) == 0);
+                REQUIRE(std::isinf(value));
+                REQUIRE(value > 0);
+                REQUIRE(number_parse_float("-inf", 4, &value) == 0);
+                REQUIRE(std::isinf(value));
+                REQUIRE(value < 0);
+                REQUIRE(number_parse_float("+nan", 4, &value) == 0);
+                REQUIRE(std::isnan(value));
+                REQUIRE(number_parse_float("-0.0", 4, &value) == 0);
+                REQUIRE(std::signbit(value));
+            }
+        }
+    }
+
+    GIVEN("ランダムな倍精度浮動小数点数の表記とする") {
+        std::mt19937_64 random(2501);
+
+        WHEN("strtod と比較する") {
+            THEN("すべて同じ値に丸められること") {
+                char buf[64];
+                for (int i = 0; i < 100000; ++i) {
+                    uint64_t bits = random();
+                    double original;
+                    std::memcpy(&original, &bits, sizeof(original));
+                    if (!std::isfinite(original)) {
+                        continue;
+                    }
+                    int length = std::snprintf(buf, sizeof(buf), "%.*e", (int)(random() % 20), original);
+                    double expected = std::strtod(buf, NULL);
+                    if (std::isinf(expected)) {
+                        continue;
+                    }
+                    double value = 0;
+                    INFO(std::string("入力: '") + buf + "'");
+                    REQUIRE(number_parse_float(buf, length, &value) == 0);
+                    REQUIRE(std::memcmp(&value, &expected, sizeof(value)) == 0);
+                }
+            }
+        }
+    }
+
+    GIVEN("範囲外の浮動小数点数とする") {
+        std::vector<std::string> inputs = {
+            "1e309",
+            "-1.8e308",
+            "1e100000000000",
+        };
+
+        WHEN("解釈する") {
+            THEN("ERANGE で失敗すること") {
+                for (auto &input : inputs) {
+                    INFO("入力: '" + input + "'");
+                    double value = 0;
+                    REQUIRE(number_parse_float(input.data(), input.size(), &value) == -1);
+                    REQUIRE(errno == ERANGE);
+                }
+            }
+        }
+    }
+
+    GIVEN("不正な浮動小数点数の表記とする") {
+        std::vector<std::string> inputs = {
+            "",
+            "1",
+            "-1",
+            ".7",
+            "7.",
+            "3.e+20",
+            "01.5",
+            "00.5",
+            "1e",
+            "1e+",
+            "1e_1",
+            "1_.5",
+            "1._5",
+            "1.5_",
+            "1.5e1_",
+            "1__0.5",
+            "1.5.5",
+            "0x1.8p1",
+            "infinity",
+            "NaN",
+            "Inf",
+            "1.0 ",
+        };
+
+        WHEN("解釈する") {
+            THEN("EINVAL で失敗すること") {
+                for (auto &input : inputs) {
+                    INFO("入力: '" + input + "'");
+                    double value = 0;
+                    REQUIRE(number_parse_float(input.data(), input.size(), &value) == -1);
+                    REQUIRE(errno == EINVAL);
+                }
+            }
+        }
+    }
+}
+
+SCENARIO("整数が書き出せること", "[number][integer]") {
+
+    GIVEN("整数とする") {
+        std::vector<std::pair<int64_t, std::string>> inputs = {
+            {0, "0"},
+            {7, "7"},
+            {-7, "-7"},
+            {10, "10"},
+            {99, "99"},
+            {100, "100"},
+            {12345678, "12345678"},
+            {-1000000000000000000, "-1000000000000000000"},
+            {INT64_MAX, "9223372036854775807"},
+            {INT64_MIN, "-9223372036854775808"},
+        };
+
+        WHEN("書き出す") {
+            THEN("10 進の表記が得られること") {
+                for (auto &input : inputs) {
+                    INFO("期待値: '" + input.second + "'");
+                    char buf[NUMBER_TEXT_BYTES];
+                    REQUIRE(number_format_integer(input.first, buf) == input.second.size());
+                    REQUIRE(std::string(buf) == input.second);
+                }
+            }
+        }
+    }
+
+    GIVEN("ランダムな整数とする") {
+        std::mt19937_64 random(2501);
+
+        WHEN("snprintf と比較する") {
+            THEN("すべて同じ表記が得られること") {
+                for (int i = 0; i < 100000; ++i) {
+                    int64_t value = (int64_t)(random() >> (random() % 64));
+                    value = ((i % 2) == 0) ? value : -value;
+                    char expected[NUMBER_TEXT_BYTES];
+                    char buf[NUMBER_TEXT_BYTES];
+                    std::snprintf(expected, sizeof(expected), "%" PRId64, value);
+                    INFO(std::string("期待値: '") + expected + "'");
+                    REQUIRE(number_format_integer(value, buf) == std::strlen(expected));
+                    REQUIRE(std::string(buf) == expected);
+                }
+            }
+        }
+    }
+}
+
+SCENARIO("浮動小数点数が最短の表記で書き出せること", "[number][float]") {
+
+    GIVEN("浮動小数点数とする") {
+        std::vector<std::pair<double, std::string>> inputs = {
+            {0.0, "0.0"},
+            {-0.0, "-0.0"},
+            {1.0, "1.0"},
+            {-2.5, "-2.5"},
+            {0.1, "0.1"},
+            {0.3, "0.3"},
+            {100.0, "100.0"},
+            {123.456, "123.456"},
+            {0.001, "0.001"},
+            {0.00001, "0.00001"},
+            {1e-7, "1e-7"},
+            {1e15, "1000000000000000.0"},
+            {1e16, "1e16"},
+            {9007199254740993.0, "9007199254740992.0"},
+            {1.2345678901234568e17, "1.2345678901234568e17"},
+            {5e-324, "5e-324"},
+            {2.2250738585072014e-308, "2.2250738585072014e-308"},
+            {1.7976931348623157e308, "1.7976931348623157e308"},
+            {INFINITY, "inf"},
+            {-INFINITY, "-inf"},
+            {NAN, "nan"},
+        };
+
+        WHEN("書き出す") {
+            THEN("TOML の浮動小数点数の表記が得られること") {
+                for (auto &input : inputs) {
+                    INFO("期待値: '" + input.second + "'");
+                    char buf[NUMBER_TEXT_BYTES];
+                    REQUIRE(number_format_float(input.first, buf) == input.second.size());
+                    REQUIRE(std::string(buf) == input.second);
+                }
+            }
+        }
+    }
+
+    GIVEN("ランダムな倍精度浮動小数点数とする") {
+        std::mt19937_64 random(2501);
+
+        WHEN("書き出して解釈し直す") {
+            THEN("同じ値に戻り、桁数が最短であること") {
+                for (int i = 0; i < 100000; ++i) {
+                    uint64_t bits = random();
+                    double original;
+                    std::memcpy(&original, &bits, sizeof(original));
+                    if (!std::isfinite(original)) {
+                        continue;
+                    }
+                    char buf[NUMBER_TEXT_BYTES];
+                    size_t length = number_format_float(original, buf);
+                    INFO(std::string("出力: '") + buf + "'");
+                    double value = 0;
+                    REQUIRE(number_parse_float(buf, length, &value) == 0);
+                    REQUIRE(std::memcmp(&value, &original, sizeof(value)) == 0);
+
+                    /* the fewest digits that read back, as printf rounds them. */
+                    char shortest[64];
+                    for (int precision = 0; precision < 17; ++precision) {
+                        std::snprintf(shortest, sizeof(shortest), "%.*e", precision, original);
+                        if (std::strtod(shortest, NULL) == original) {
+                            break;
+                        }
+                    }
+                    std::string digits;
+                    for (char *cur = buf; (*cur != '\0') && (*cur != 'e'); ++cur) {
+                        if ((*cur >= '0') && (*cur <= '9') && (!digits.empty() || (*cur != '0'))) {
+                            digits += *cur;
+                        }
+                    }
+                    std::string expected;
+                    for (char *cur = shortest; (*cur != '\0') && (*cur != 'e'); ++cur) {
+                        if ((*cur >= '0') && (*cur <= '9')) {
+                            expected += *cur;
+                        }
+                    }
+                    while ((digits.size() > 1) && (digits.back() == '0')) {
+                        digits.pop_back();
+                    }
+                    while ((expected.size() > 1) && (expected.back() == '0')) {
+                        expected.pop_back();
+                    }
+                    REQUIRE(digits == expected);
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,179 @@
+/** @file   scan.cpp
+ *  @brief  Test for structural character scanner.
+ *
+ *  @author t-kenji <protect.2501@gmail.com>
+ *  @date   2018-12-03 create new.
+ */
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include "catch2/catch.hpp"
+
+extern "C" {
+#include "debug.h"
+#include "scan.h"
+}
+
+/**
+ *  positions of structural bytes, byte by byte.
+ *
+ *  @param  [in]    input   input string.
+ *  @return positions.
+ */
+static std::vector<size_t> reference(const std::string &input)
+{
+    std::vector<size_t> positions;
+
+    for (size_t i = 0; i < input.size(); ++i) {
+        uint8_t c = input[i];
+        if (((c < 0x20) && (c != '\t')) || (c == 0x7F)
+            || (std::string("=#\"'[\\").find(c) != std::string::npos)) {
+            positions.push_back(i);
+        }
+    }
+
+    return positions;
+}
+
+/**
+ *  positions of structural bytes, from the bitmap.
+ *
+ *  @param  [in]    input   input string.
+ *  @return positions.
+ */
+static std::vector<size_t> scan(const std::string &input)
+{
+    std::vector<uint64_t> bits((input.size() + 63) / 64 + 1, ~(uint64_t)0);
+    std::vector<size_t> positions;
+
+    scan_structurals(input.data(), input.size(), bits.data());
+    for (size_t i = 0; i < input.size(); ++i) {
+        if ((bits[i / 64] >> (i % 64)) & 1) {
+            positions.push_back(i);
+        }
+    }
+    for (size_t i = input.size(); i < ((input.size() + 63) / 64) * 64; ++i) {
+        REQUIRE(((bits[i / 64] >> (i % 64)) & 1) == 0);
+    }
+
+    return positions;
+}
+
+SCENARIO("構造文字の位置がビットマップに記録されること", "[scan]") {
+
+    GIVEN("実行環境で選択された実装") {
+        INFO(std::string("実装: ") + scan_implementation());
+
+        WHEN("TOML の文書を走査する") {
+            std::string input = "title = \"TOML \\\"Example\\\"\" # comment\r\n"
+                                "[owner]\n"
+                                "name = 'Tom'\tdob = 1979-05-27T07:32:00-08:00\n";
+
+            THEN("1 バイトずつ判定した結果と一致すること") {
+                REQUIRE(scan(input) == reference(input));
+            }
+        }
+
+        WHEN("すべてのバイト値を様々な長さで走査する") {
+            std::string input;
+            for (int i = 0; i < 512; ++i) {
+                input += (char)((i * 7) % 256);
+            }
+
+            THEN("1 バイトずつ判定した結果と一致すること") {
+                for (size_t length = 0; length <= input.size(); length += 13) {
+                    INFO("長さ: " + std::to_string(length));
+                    std::string part = input.substr(0, length);
+                    REQUIRE(scan(part) == reference(part));
+                }
+            }
+        }
+
+        WHEN("構造文字を含まない入力を走査する") {
+            std::string input(200, 'a');
+
+            THEN("ビットが立たないこと") {
+                REQUIRE(scan(input).empty());
+            }
+        }
+    }
+}
+
+SCENARIO("UTF-8 として正しいか判定できること", "[scan]") {
+
+    GIVEN("実行環境で選択された実装") {
+        INFO(std::string("実装: ") + scan_implementation());
+        std::vector<std::string> valid = {
+            "",
+            "ascii only",
+            "\xC2\x80",
+            "\xDF\xBF",
+            "\xE0\xA0\x80",
+            "\xED\x9F\xBF",
+            "\xEE\x80\x80",
+            "\xEF\xBF\xBF",
+            "\xF0\x90\x80\x80",
+            "\xF4\x8F\xBF\xBF",
+            "\xE3\x81\x82\xE3\x81\x84\xE3\x81\x86",
+        };
+        std::vector<std::string> invalid = {
+            "\x80",
+            "\xBF",
+            "\xC0\x80",
+            "\xC1\xBF",
+            "\xC2",
+            "\xC2\x41",
+            "\xE0\x80\x80",
+            "\xE0\x9F\xBF",
+            "\xED\xA0\x80",
+            "\xED\xBF\xBF",
+            "\xE3\x81",
+            "\xF0\x80\x80\x80",
+            "\xF0\x8F\xBF\xBF",
+            "\xF4\x90\x80\x80",
+            "\xF5\x80\x80\x80",
+            "\xF0\x90\x80",
+            "\xF0\x90\x80\x80\x80",
+            "\xFE",
+            "\xFF",
+        };
+
+        WHEN("前後に ASCII を置いて様々な位置で判定する") {
+            THEN("正しい列は受け付けられること") {
+                for (auto &input : valid) {
+                    for (size_t offset = 0; offset <= 70; ++offset) {
+                        std::string text = std::string(offset, 'a') + input + std::string(70 - offset, 'b');
+                        INFO("入力: '" + input + "', 位置: " + std::to_string(offset));
+                        REQUIRE(scan_utf8(text.data(), text.size()));
+                        REQUIRE(scan_utf8(text.data(), offset + input.size()));
+                    }
+                }
+            }
+            THEN("不正な列は拒否されること") {
+                for (auto &input : invalid) {
+                    for (size_t offset = 0; offset <= 70; ++offset) {
+                        std::string text = std::string(offset, 'a') + input + std::string(70 - offset, 'b');
+                        INFO("入力: '" + input + "', 位置: " + std::to_string(offset));
+                        REQUIRE_FALSE(scan_utf8(text.data(), text.size()));
+                        REQUIRE_FALSE(scan_utf8(text.data(), offset + input.size()));
+                    }
+                }
+            }
+        }
+
+        WHEN("長い多バイト文字の列を途中で切って判定する") {
+            std::string input;
+            for (int i = 0; i < 40; ++i) {
+                input += "\xE2\x82\xAC";
+            }
+
+            THEN("文字の境界でだけ受け付けられること") {
+                for (size_t length = 0; length <= input.size(); ++length) {
+                    INFO("長さ: " + std::to_string(length));
+                    REQUIRE(scan_utf8(input.data(), length) == ((length % 3) == 0));
+                }
+            }
+        }
+    }
+}
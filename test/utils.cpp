@@ -4,6 +4,11 @@
  *  @author t-kenji <protect.2501@gmail.com>
  *  @date   2018-11-24 create new.
  */
+#include <string>
+#include <vector>
+#include <utility>
+#include <cstdint>
+
 #include "catch2/catch.hpp"
 
 extern "C" {
@@ -351,3 +356,24 @@ SCENARIO("パターンによる文字列の一致が検出出来ること", "[ut
         }
     }
 }
+
+SCENARIO("XXH64 のハッシュ値が得られること", "[utils][hash]") {
+
+    GIVEN("既知のハッシュ値を持つ入力とする") {
+        std::vector<std::pair<std::string, uint64_t>> inputs = {
+            {"", UINT64_C(0xEF46DB3751D8E999)},
+            {"a", UINT64_C(0xD24EC4F1A98C6E5B)},
+            {"abc", UINT64_C(0x44BC2CF5AD770999)},
+            {"Nobody inspects the spammish repetition", UINT64_C(0xFBCEA83C8A378BF1)},
+        };
+
+        WHEN("ハッシュ値を求める") {
+            THEN("既知の値と一致すること") {
+                for (auto &input : inputs) {
+                    INFO("入力: '" + input.first + "'");
+                    REQUIRE(hash64(input.first.data(), input.first.size()) == input.second);
+                }
+            }
+        }
+    }
+}